@@ -9,6 +9,9 @@ data/image.ps \
 data/pgmimage.ps \
 data/ppmimage.ps \
 data/nulldev.ps \
+data/opbench.ps \
+data/compbench.ps \
+data/gcbench.ps \
 data/pdfwrite.ps \
 data/gstate.ps \
 data/matrix.ps \
@@ -47,6 +50,9 @@ data/image.ps \
 data/pgmimage.ps \
 data/ppmimage.ps \
 data/nulldev.ps \
+data/opbench.ps \
+data/compbench.ps \
+data/gcbench.ps \
 data/pdfwrite.ps \
 data/gstate.ps \
 data/matrix.ps \
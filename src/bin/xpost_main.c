@@ -132,13 +132,19 @@ _xpost_main_usage(const char *filename)
 {
     int i;
 
-    printf("Usage: %s [options] [file.ps]\n\n", filename);
+    printf("Usage: %s [options] [file.ps ...]\n\n", filename);
     printf("Postscript level 2 interpreter\n\n");
     printf("Options:\n");
-    printf("  -o, --output=[FILE]                output file\n");
+    printf("  -o, --output=[FILE]                output file, numbered per file with %%d\n");
+    printf("                                     when several files are given\n");
     printf("  -d, --device=[STRING]              device name\n");
     printf("  -Dname=token, --define name=token  add definition to userdict\n");
     printf("  -g, --geometry=WxH{+-}X{+-}Y       geometry specification\n");
+    printf("  -i, --image=[FILE]                 start from an image made by --write-image\n");
+    printf("  -w, --write-image=[FILE]           write the initialized state to an image and exit\n");
+    printf("  -s, --spool=[DIR]                  run the jobs in DIR until interrupted,\n");
+    printf("                                     -o gives the output suffix\n");
+    printf("  -n, --workers=[N]                  number of worker processes for --spool\n");
     printf("  -q, --quiet                        suppress interpreter messages (default)\n");
     printf("  -v, --verbose                      do not go quiet into that good night\n");
     printf("  -t, --trace                        add additional tracing messages, implies -v\n");
@@ -241,6 +247,12 @@ int main(int argc, char *argv[])
     const char *output_file = NULL;
     const char *device = NULL;
     const char *ps_file = NULL;
+    const char **ps_files = NULL;
+    int num_ps_files = 0;
+    const char *image_file = NULL;
+    const char *write_image_file = NULL;
+    const char *spool = NULL;
+    const char *workers = NULL;
     const char *filename = argv[0];
     const char *define = NULL;
     char **defs = NULL;
@@ -254,6 +266,8 @@ int main(int argc, char *argv[])
     int xsign = 1;
     int ysign = 1;
     int have_geometry = 0;
+    int num_workers = 1;
+    int batch;
     int i;
 #ifdef HAVE_SIGACTION
     struct sigaction sa, oldsa;
@@ -356,6 +370,10 @@ int main(int argc, char *argv[])
             else XPOST_MAIN_IF_OPT("-o", "--output=", output_file)
             else XPOST_MAIN_IF_OPT("-d", "--device=", device)
             else XPOST_MAIN_IF_OPT("-g", "--geometry=", geometry)
+            else XPOST_MAIN_IF_OPT("-i", "--image=", image_file)
+            else XPOST_MAIN_IF_OPT("-w", "--write-image=", write_image_file)
+            else XPOST_MAIN_IF_OPT("-s", "--spool=", spool)
+            else XPOST_MAIN_IF_OPT("-n", "--workers=", workers)
             else
             {
                 printf("unknown option\n");
@@ -366,6 +384,8 @@ int main(int argc, char *argv[])
         else
         {
             ps_file = argv[i];
+            ps_files = realloc(ps_files, ++num_ps_files * sizeof *ps_files);
+            ps_files[num_ps_files-1] = ps_file;
         }
     }
 
@@ -418,10 +438,33 @@ int main(int argc, char *argv[])
         goto quit_xpost;
     }
 
+    if (image_file)
+        xpost_image_use(image_file);
+
+    if (workers)
+    {
+        char *endptr;
+        if (!_xpost_atoi((char *)workers, &num_workers, &endptr) ||
+            *endptr || num_workers < 1)
+        {
+            XPOST_LOG_ERR("bad number of workers");
+            goto quit_xpost;
+        }
+    }
+
+    /* several files, or a numbered output, run as one batch */
+    batch = !spool && (num_ps_files > 1 ||
+                       (output_file && strchr(output_file, '%')));
+    if (batch && output_file && !strchr(output_file, '%'))
+    {
+        XPOST_LOG_ERR("several files need a numbered output, like -o out%%04d.png");
+        goto quit_xpost;
+    }
+
     if (!(ctx = xpost_create(device,
                              XPOST_OUTPUT_FILENAME,
-                             output_file,
-                             XPOST_SHOWPAGE_DEFAULT,
+                             (spool || batch) ? NULL : output_file,
+                             (spool || batch) ? XPOST_SHOWPAGE_NOPAUSE : XPOST_SHOWPAGE_DEFAULT,
                              output_msg,
                              have_geometry ? XPOST_USE_SIZE : XPOST_IGNORE_SIZE,
                              width, height)))
@@ -430,6 +473,14 @@ int main(int argc, char *argv[])
         goto quit_xpost;
     }
 
+    if (write_image_file)
+    {
+        int ret = xpost_image_write(ctx, write_image_file);
+        xpost_destroy(ctx);
+        xpost_quit();
+        return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     XPOST_LOG_INFO("defs=%p", (void*)defs);
     if (defs){
         xpost_add_definitions(ctx, num_defs, defs);
@@ -442,6 +493,33 @@ int main(int argc, char *argv[])
         num_defs = 0;
     }
 
+    if (spool)
+    {
+        char suffix[64];
+        int ret;
+
+        if (output_file)
+            snprintf(suffix, sizeof(suffix), "%s", output_file);
+        else
+            snprintf(suffix, sizeof(suffix), ".%.*s",
+                     (int)strcspn(device, ":"), device);
+        ret = xpost_serve(ctx, spool, num_workers, suffix);
+        free(ps_files);
+        xpost_destroy(ctx);
+        xpost_quit();
+        return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (batch)
+    {
+        int ret = xpost_run_batch(ctx, num_ps_files, ps_files, output_file);
+        free(ps_files);
+        xpost_destroy(ctx);
+        xpost_quit();
+        return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    free(ps_files);
+
     xpost_run(ctx, XPOST_INPUT_FILENAME, ps_file, 0);
     xpost_destroy(ctx);
 
@@ -24,6 +24,7 @@ src/lib/xpost_file.c \
 src/lib/xpost_font.c \
 src/lib/xpost_free.c \
 src/lib/xpost_garbage.c \
+src/lib/xpost_image.c \
 src/lib/xpost_interpreter.c \
 src/lib/xpost_log.c \
 src/lib/xpost_main.c \
@@ -32,6 +33,7 @@ src/lib/xpost_memory.c \
 src/lib/xpost_name.c \
 src/lib/xpost_object.c \
 src/lib/xpost_save.c \
+src/lib/xpost_server.c \
 src/lib/xpost_stack.c \
 src/lib/xpost_string.c \
 src/lib/xpost_op_array.c \
@@ -67,6 +69,7 @@ src/lib/xpost_file.h \
 src/lib/xpost_font.h \
 src/lib/xpost_free.h \
 src/lib/xpost_garbage.h \
+src/lib/xpost_image.h \
 src/lib/xpost_log.h \
 src/lib/xpost_main.h \
 src/lib/xpost_matrix.h \
@@ -185,14 +185,15 @@ typedef enum {
  */
 typedef enum {
     XPOST_INPUT_STRING, /**< Treats inputptr as a char * to an
-                             zero-terminated ascii string, writes the
-                             whole string into a temporary file and
-                             falls through to the #XPOST_INPUT_FILEPTR
-                             case. */
+                             zero-terminated ascii string (or a piece
+                             of memory of the given size), wraps it
+                             in place in a read-only file object and
+                             schedules it to execute. The memory must
+                             stay valid until the job completes. */
     XPOST_INPUT_FILENAME, /**< Treats inputptr as a char * to a
-                              zero-terminated OS path string, and
-                              pushes the path string itself,
-                              scheduling a procedure to execute it. */
+                              zero-terminated OS path string, maps
+                              the file into memory and schedules a
+                              procedure to execute it. */
     XPOST_INPUT_FILEPTR, /**< Treats inputptr as a FILE *, creates a
                                postscript file object and pushes it on
                                the execution stack (scheduling it to
@@ -272,6 +273,20 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx,
                                 int cnt,
                                 char *defs[]);
 
+/**
+ * @brief Set the file the device of the next run writes to.
+ *
+ * @param ctx The context to use.
+ * @param filename The zero-terminated OS path of the output file.
+ * @return 1 on success, 0 otherwise.
+ *
+ * This function replaces the output file given to xpost_create()
+ * with #XPOST_OUTPUT_FILENAME. The device is created by xpost_run(),
+ * so the new name applies from the next call to xpost_run().
+ */
+XPAPI int xpost_output_file_set(Xpost_Context *ctx,
+                                const char *filename);
+
 /**
  * @brief Execute ps program.
  *
@@ -297,9 +312,14 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx,
  * string. If @p inputptr is a piece of memory, then pass the size of
  * that memory.
  *
- * For a filename, push a proc to open and execute it.
+ * For a filename, map the file read-only and push a proc to execute
+ * it. If the file cannot be mapped, push the name and let the proc
+ * open it.
  *
- * For a string, write to a temp file and fall-through to FILE * case.
+ * For a string, wrap the memory in a read-only file object without
+ * copying it. A file already mapped for DSC parsing can be executed
+ * this way by passing xpost_dsc_file_base_get() and
+ * xpost_dsc_file_length_get(), so it is mapped only once.
  *
  * For a FILE *, mark executable and push to exec stack.
  *
@@ -322,6 +342,33 @@ XPAPI int xpost_run(Xpost_Context *ctx,
                     const void *inputptr,
                     size_t size);
 
+/**
+ * @brief Run several files as one batch through a context.
+ *
+ * @param ctx The context, as returned by xpost_create().
+ * @param cnt The number of files.
+ * @param files The names of the files to execute.
+ * @param output_template The output file name, or NULL.
+ * @return 1 if every job was started, 0 otherwise.
+ *
+ * This function executes each of @p files like xpost_run(), but the
+ * graphics procedures and the device are created once, before the
+ * first job, and destroyed after the last one. Each job runs inside
+ * its own save and restore, and starts on an erased page, so a job
+ * sees nothing of the one before it.
+ *
+ * If @p output_template is not NULL, it is a printf format with a
+ * single integer conversion, like "out%04d.png", and job @c i (counted
+ * from 1) writes its pages to the file it names. The context should be
+ * created with #XPOST_SHOWPAGE_NOPAUSE.
+ *
+ * @see xpost_run()
+ */
+XPAPI int xpost_run_batch(Xpost_Context *ctx,
+                          int cnt,
+                          const char *files[],
+                          const char *output_template);
+
 /**
  * @brief Destroy the given context.
  *
@@ -335,6 +382,69 @@ XPAPI int xpost_run(Xpost_Context *ctx,
  */
 XPAPI void xpost_destroy(Xpost_Context *ctx);
 
+/**
+ * @brief Write the initialized state of a context to an image file.
+ *
+ * @param ctx The context to save, as returned by xpost_create().
+ * @param filename The image file to write.
+ * @return 1 on success, 0 otherwise.
+ *
+ * This function saves the memory of a context freshly created
+ * by xpost_create(), before xpost_add_definitions() or xpost_run()
+ * change it. Contexts created after xpost_image_use() names the
+ * image start from it instead of running the initialization.
+ * When the device of @p ctx is written in PostScript (pgm, ppm,
+ * null, pdfwrite), the graphics procedures are loaded and the
+ * device made first, so the image holds them too and the jobs
+ * do not load them again.
+ *
+ * @see xpost_image_use()
+ */
+XPAPI int xpost_image_write(Xpost_Context *ctx, const char *filename);
+
+/**
+ * @brief Select an image file for the contexts to start from.
+ *
+ * @param filename The image file, or NULL to always initialize.
+ *
+ * After this call, xpost_create() loads the context from the
+ * image written by xpost_image_write() and applies its own
+ * device, output and message settings to it. An image from another
+ * build or another init.ps, one holding another device, or a damaged
+ * one, is ignored and the context is initialized as usual. @p filename must stay
+ * valid while contexts are created.
+ *
+ * @see xpost_image_write()
+ */
+XPAPI void xpost_image_use(const char *filename);
+
+/**
+ * @brief Run the jobs of a spool directory in a pool of processes.
+ *
+ * @param ctx The context to run the jobs in, as returned by xpost_create().
+ * @param spool The spool directory.
+ * @param workers The number of worker processes.
+ * @param suffix The suffix of the output files, or NULL.
+ * @return 1 when the pool stopped normally, 0 otherwise.
+ *
+ * This function forks @p workers processes from @p ctx, which share
+ * its initialized memory copy-on-write. Each worker claims the files
+ * NAME.ps of @p spool, renaming them to NAME.ps.PID, runs them with
+ * xpost_run() and the output file NAME followed by @p suffix, then
+ * renames them to NAME.done. A job whose worker dies is renamed to
+ * NAME.failed and the worker is replaced.
+ *
+ * The function returns when the process receives SIGTERM or SIGINT,
+ * after the workers finish their current job. The context should
+ * be created with #XPOST_SHOWPAGE_NOPAUSE. It fails when no worker
+ * can be started or waiting for them fails. Worker pools need fork(),
+ * elsewhere this function fails.
+ */
+XPAPI int xpost_serve(Xpost_Context *ctx,
+                      const char *spool,
+                      int workers,
+                      const char *suffix);
+
 /**
  * @brief Set quality value for compression of JPEG files.
  *
@@ -47,6 +47,7 @@
 #include "xpost_free.h"  /* arrays are allocated from the free list */
 
 #include "xpost_save.h"  /* arrays obey save/restore */
+#include "xpost_garbage.h"  /* stores into old arrays are remembered */
 #include "xpost_context.h"
 //#include "xpost_interpreter.h"  /* banked arrays may be in global or local mfiles */
 #include "xpost_error.h"  /* array functions may throw errors */
@@ -95,7 +96,7 @@ Xpost_Object xpost_array_cons_memory(Xpost_Memory_File *mem,
                                     XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
         cnt = xpost_stack_count(mem, vs);
         tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
-                | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
+                | (0 << XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET)
                 | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
                 | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
 
@@ -149,7 +150,7 @@ Xpost_Object xpost_array_cons(Xpost_Context *ctx,
   Put object into array with given memory file.
   (Array must be valid for this memory file)
 
-  Copy if necessary for save/restore,
+  Save the element if necessary for save/restore,
    call memory_put.
 */
 int xpost_array_put_memory(Xpost_Memory_File *mem,
@@ -158,20 +159,22 @@ int xpost_array_put_memory(Xpost_Memory_File *mem,
                            Xpost_Object o)
 {
     int ret;
-    if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(a)))
-        if (!xpost_save_save_ent(mem, arraytype, a.comp_.sz, xpost_object_get_ent(a)))
-            return VMerror;
     if (i > a.comp_.sz)
     {
         XPOST_LOG_ERR("cannot put value in array (rangecheck) %u > [%u]", i, a.comp_.sz);
         /*breakhere((Xpost_Context *)mem);*/
         return rangecheck;
     }
+    if (!xpost_save_save_range(mem, arraytype, a.comp_.sz, xpost_object_get_ent(a),
+                               (unsigned int)(a.comp_.off + i), 1))
+        return VMerror;
     ret = xpost_memory_put(mem, xpost_object_get_ent(a),
                            (unsigned int)(a.comp_.off + i),
                            (unsigned int)sizeof(Xpost_Object), &o);
     if (!ret)
         return VMerror;
+    if (xpost_object_is_composite(o))
+        xpost_garbage_remember(mem, xpost_object_get_ent(a));
     return 0;
 }
 
@@ -267,6 +267,7 @@ int initlocal(Xpost_Context *ctx,
     ctx->es = makestack(ctx->lo);
     ctx->ds = makestack(ctx->lo);
     ctx->hold = makestack(ctx->lo);
+    ctx->cs = makestack(ctx->lo);
     //ctx->lo->roots[1] = DS;
     //ctx->lo->start = HOLD + 1; /* so HOLD is not collected and not scanned. */
     //ctx->lo->start = XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST + 1;
@@ -318,6 +319,8 @@ int xpost_context_init(Xpost_Context *ctx,
     ctx->xpost_interpreter_alloc_local_memory = xpost_interpreter_alloc_local_memory;
     ctx->xpost_interpreter_alloc_global_memory = xpost_interpreter_alloc_global_memory;
     ctx->garbage_collect_function = garbage_collect_function;
+    memset(&ctx->name_cache, 0, sizeof ctx->name_cache);
+    ctx->name_cache.generation = 1;
 
     return 1;
 }
@@ -350,6 +353,69 @@ void xpost_context_dump(Xpost_Context *ctx)
     /*dumpnames(ctx);*/
 }
 
+void xpost_context_name_cache_flush(Xpost_Context *ctx)
+{
+    if (++ctx->name_cache.generation == 0)
+    { /* wrapped: stale slots could look valid again */
+        memset(ctx->name_cache.entries, 0, sizeof ctx->name_cache.entries);
+        ctx->name_cache.generation = 1;
+    }
+}
+
+void xpost_context_name_cache_invalidate(Xpost_Context *ctx,
+                                         Xpost_Object k)
+{
+    Xpost_Name_Cache_Entry *e;
+
+    switch (xpost_object_get_type(k))
+    {
+        case nametype:
+            e = &ctx->name_cache.entries[k.mark_.padw & (XPOST_CONTEXT_NAME_CACHE_SIZE - 1)];
+            if (e->name.mark_.padw == k.mark_.padw)
+                e->generation = 0;
+            break;
+        case stringtype:
+            xpost_context_name_cache_flush(ctx);
+            break;
+        default:
+            break;
+    }
+}
+
+int xpost_context_name_cache_get(Xpost_Context *ctx,
+                                 Xpost_Object name,
+                                 Xpost_Object *value)
+{
+    Xpost_Name_Cache_Entry *e;
+
+    e = &ctx->name_cache.entries[name.mark_.padw & (XPOST_CONTEXT_NAME_CACHE_SIZE - 1)];
+    if (e->generation == ctx->name_cache.generation &&
+        e->name.mark_.padw == name.mark_.padw &&
+        !((e->name.tag ^ name.tag) & XPOST_OBJECT_TAG_DATA_FLAG_BANK))
+    {
+        ++ctx->name_cache.hits;
+        *value = e->value;
+        return 1;
+    }
+    ++ctx->name_cache.misses;
+    return 0;
+}
+
+void xpost_context_name_cache_put(Xpost_Context *ctx,
+                                  Xpost_Object name,
+                                  Xpost_Object value,
+                                  unsigned int generation)
+{
+    Xpost_Name_Cache_Entry *e;
+
+    if (generation != ctx->name_cache.generation)
+        return;
+    e = &ctx->name_cache.entries[name.mark_.padw & (XPOST_CONTEXT_NAME_CACHE_SIZE - 1)];
+    e->name = name;
+    e->value = value;
+    e->generation = generation;
+}
+
 int xpost_context_install_event_handler(Xpost_Context *ctx,
                                         Xpost_Object operator,
                                         Xpost_Object device)
@@ -383,6 +449,7 @@ unsigned int xpost_context_fork1(Xpost_Context *ctx,
     *newctx = *ctx; // struct copy for defaults
     newctx->id = newcid;
     newctx->state = C_IDLE;
+    xpost_context_name_cache_flush(newctx);
     initlocal(newctx, xpost_interpreter_cid_get_context, 
             xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_local_memory, garbage_collect_function);
@@ -417,6 +484,7 @@ unsigned int xpost_context_fork2(Xpost_Context *ctx,
     *newctx = *ctx; // struct copy for defaults
     newctx->id = newcid;
     newctx->state = C_IDLE;
+    xpost_context_name_cache_flush(newctx);
     initlocal(ctx, xpost_interpreter_cid_get_context, 
             xpost_interpreter_get_initializing, xpost_interpreter_set_initializing, 
             xpost_interpreter_alloc_local_memory, garbage_collect_function);
@@ -451,6 +519,7 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
     *newctx = *ctx; // struct copy for defaults
     newctx->id = newcid;
     newctx->state = C_IDLE;
+    xpost_context_name_cache_flush(newctx);
     newctx->lo = ctx->lo;
     xpost_context_append_ctxlist(newctx->lo, newcid);
     newctx->gl = ctx->gl;
@@ -460,6 +529,7 @@ unsigned int xpost_context_fork3(Xpost_Context *ctx,
     newctx->es = makestack(newctx->lo);
     newctx->ds = makestack(newctx->lo);
     newctx->hold = makestack(newctx->lo);
+    newctx->cs = makestack(newctx->lo);
     newctx->lo->start = XPOST_MEMORY_TABLE_SPECIAL_BOGUS_NAME + 1;
 
     xpost_stack_push(newctx->lo, newctx->ds,
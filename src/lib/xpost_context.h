@@ -53,6 +53,24 @@ enum { LOCAL, GLOBAL };
  */
 enum { C_FREE, C_IDLE, C_RUN, C_WAIT, C_IOBLOCK, C_ZOMB };
 
+/**
+ * @brief number of slots in the name-lookup cache (a power of 2)
+ */
+#define XPOST_CONTEXT_NAME_CACHE_SIZE 512
+
+/**
+ * @brief one slot of the name-lookup cache
+ *
+ * A slot is valid only while its generation matches the
+ * generation of the cache.
+ */
+typedef struct
+{
+    Xpost_Object name; /**< executable name */
+    Xpost_Object value; /**< value found for name on the dict stack */
+    unsigned int generation; /**< cache generation when the slot was filled */
+} Xpost_Name_Cache_Entry;
+
 /** @struct Xpost_Context
  * @brief The context structure for a thread of execution of ps code
  */
@@ -61,9 +79,17 @@ struct _Xpost_Context {
     struct
     {
         int contfilenameforall;
+        int contfor;
+        int contrepeat;
+        int contloop;
+        int contforall;
         int cvx;
         int opfor;
         int forall;
+        int opif;
+        int ifelse;
+        int jump;
+        int jumpunless;
         int load;
         int loop;
         int repeat;
@@ -84,6 +110,7 @@ struct _Xpost_Context {
     unsigned int id; /**< cid for this context */
 
     unsigned int os, es, ds, hold; /**< stack addresses in local VM */
+    unsigned int cs; /**< es heights of loop and stopped contexts, for exit and stop */
     unsigned long rand_next; /**< random number seed */
     unsigned int vmmode; /**< allocating in GLOBAL or LOCAL */
     unsigned int state;  /**< process state: running, blocked, iowait */
@@ -99,6 +126,14 @@ struct _Xpost_Context {
     Xpost_Memory_File *(*xpost_interpreter_alloc_local_memory)(void);
     Xpost_Memory_File *(*xpost_interpreter_alloc_global_memory)(void);
     int (*garbage_collect_function)(Xpost_Memory_File *mem, int dosweep, int markall);
+
+    struct
+    {
+        Xpost_Name_Cache_Entry entries[XPOST_CONTEXT_NAME_CACHE_SIZE];
+        unsigned int generation; /**< bumped to invalidate all slots */
+        unsigned long hits;
+        unsigned long misses;
+    } name_cache;  /**< results of executable name lookups on the dict stack */
 };
 
 int xpost_context_init_ctxlist(Xpost_Memory_File *mem);
@@ -133,6 +168,46 @@ Xpost_Memory_File *xpost_context_select_memory(Xpost_Context *ctx, Xpost_Object
  */
 void xpost_context_dump(Xpost_Context *ctx);
 
+/**
+ * @brief invalidate every slot of the name-lookup cache
+ *
+ * Called when the dict stack changes (begin, end, cleardictstack),
+ * when dictionary contents change wholesale (restore), and when
+ * another context sharing the same VM may have run.
+ */
+void xpost_context_name_cache_flush(Xpost_Context *ctx);
+
+/**
+ * @brief invalidate the name-lookup cache slot for key k
+ *
+ * Called by dictionary put and undef, for any dictionary.
+ * String keys flush the whole cache, since they are
+ * converted to names by the dictionary.
+ */
+void xpost_context_name_cache_invalidate(Xpost_Context *ctx,
+                                         Xpost_Object k);
+
+/**
+ * @brief look up an executable name in the name-lookup cache
+ *
+ * Returns 1 and sets *value on a hit, and 0 on a miss.
+ */
+int xpost_context_name_cache_get(Xpost_Context *ctx,
+                                 Xpost_Object name,
+                                 Xpost_Object *value);
+
+/**
+ * @brief record the value of an executable name in the name-lookup cache
+ *
+ * The generation is that of the cache before the lookup
+ * started, so a lookup which itself invalidated the cache
+ * is not recorded.
+ */
+void xpost_context_name_cache_put(Xpost_Context *ctx,
+                                  Xpost_Object name,
+                                  Xpost_Object value,
+                                  unsigned int generation);
+
 /**
  * @brief install a function to be called by eval()
  */
@@ -96,7 +96,7 @@ int xpost_device_set_filename(Xpost_Context *ctx, Xpost_Object devdic, char *fil
     Xpost_Object filenamestr;
     int ret;
 
-    filenamestr = xpost_string_cons(ctx, strlen(filename), filename);
+    filenamestr = xpost_object_cvlit(xpost_string_cons(ctx, strlen(filename), filename));
     if ((ret = xpost_dict_put(ctx, devdic, xpost_name_cons(ctx, "OutputFileName"), filenamestr)))
         return ret;
     return 0;
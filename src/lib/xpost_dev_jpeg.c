@@ -87,7 +87,6 @@ typedef struct
     /*
      * add additional members to private struct
      */
-    FILE *f;
     Xpost_Jpeg_Buffer *buf;
 } PrivateData;
 
@@ -162,7 +161,6 @@ int _create_cont(Xpost_Context *ctx,
 {
     PrivateData private;
     Xpost_Object privatestr;
-    char *filename;
     integer width = w.int_.val;
     integer height = h.int_.val;
     //printf("create_cont\n");
@@ -185,28 +183,13 @@ int _create_cont(Xpost_Context *ctx,
      *
      */
 
-    filename = xpost_device_get_filename(ctx, devdic);
-    if (!filename)
-    {
-        XPOST_LOG_ERR("cannot retrieve JPEG file name");
-        return unregistered;
-    }
-
-    private.f = fopen(filename, "wb");
-    free(filename);
-    if (!private.f)
-    {
-        XPOST_LOG_ERR("cannot retrieve JPEG file name");
-        return unregistered;
-    }
-
     /* allocate buffer header and array */
     private.buf = malloc(sizeof(Xpost_Jpeg_Buffer) +
                          sizeof(Xpost_Jpeg_Pixel) * width * height);
     if (!private.buf)
     {
         XPOST_LOG_ERR("cannot allocate buffer memory");
-        goto close_file;
+        return unregistered;
     }
 
     /* save private data struct in string */
@@ -217,11 +200,6 @@ int _create_cont(Xpost_Context *ctx,
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
     return 0;
-
-  close_file:
-    fclose(private.f);
-
-    return unregistered;
 }
 
 static
@@ -285,11 +263,15 @@ int _putpix(Xpost_Context *ctx,
     return 0;
 }
 
+/* write the page as a complete file named by OutputFileName,
+   so each showpage (or each job of a batch) gets a file of its own */
 static
 int _emit(Xpost_Context *ctx,
           Xpost_Object devdic)
 {
     struct jpeg_compress_struct cinfo;
+    char *filename;
+    FILE *f;
     struct _JPEG_error_mgr jerr;
     Xpost_Object ud;
     Xpost_Object quality_o;
@@ -316,6 +298,22 @@ int _emit(Xpost_Context *ctx,
         quality = quality_o.int_.val;
     XPOST_LOG_INFO("JPEG quality: %d", quality);
 
+    filename = xpost_device_get_filename(ctx, devdic);
+    if (!filename)
+    {
+        XPOST_LOG_ERR("cannot retrieve JPEG file name");
+        return unregistered;
+    }
+
+    f = fopen(filename, "wb");
+    if (!f)
+    {
+        XPOST_LOG_ERR("cannot open JPEG file %s", filename);
+        free(filename);
+        return ioerror;
+    }
+    free(filename);
+
     memset(&cinfo, 0, sizeof(cinfo));
     cinfo.err = jpeg_std_error(&(jerr.pub));
     jerr.pub.error_exit = _JPEGFatalErrorHandler;
@@ -324,10 +322,11 @@ int _emit(Xpost_Context *ctx,
     if (setjmp(jerr.setjmp_buffer))
     {
         jpeg_destroy_compress(&cinfo);
+        fclose(f);
         return undefined;
     }
     jpeg_create_compress(&cinfo);
-    jpeg_stdio_dest(&cinfo, private.f);
+    jpeg_stdio_dest(&cinfo, f);
     cinfo.image_width = private.width;
     cinfo.image_height = private.height;
     cinfo.input_components = 3;
@@ -357,6 +356,7 @@ int _emit(Xpost_Context *ctx,
     }
     jpeg_finish_compress(&cinfo);
     jpeg_destroy_compress(&cinfo);
+    fclose(f);
 
     /* pass data back to client application */
     {
@@ -390,7 +390,6 @@ int _destroy(Xpost_Context *ctx,
                      sizeof(private), &private);
 
     free(private.buf);
-    fclose(private.f);
 
     return 0;
 }
@@ -75,10 +75,8 @@ typedef struct
     /*
      * add additional members to private struct
      */
-    FILE *f;
-    png_structp         png_ptr;
-    png_infop           info_ptr;
     Xpost_Png_Buffer *buf;
+    int compression_level;
     unsigned int interlaced : 1;
 } PrivateData;
 
@@ -131,11 +129,8 @@ int _create_cont(Xpost_Context *ctx,
     Xpost_Object ud;
     Xpost_Object compression_level_o;
     Xpost_Object interlaced_o;
-    char *filename;
-    png_color_8 sig_bit;
     integer width = w.int_.val;
     integer height = h.int_.val;
-    int compression_level;
     //printf("create_cont\n");
 
     /* create a string to contain device data structure */
@@ -156,21 +151,6 @@ int _create_cont(Xpost_Context *ctx,
      *
      */
 
-    filename = xpost_device_get_filename(ctx, devdic);
-    if (!filename)
-    {
-        XPOST_LOG_ERR("cannot retrieve PNG file name");
-        return unregistered;
-    }
-
-    private.f = fopen(filename, "wb");
-    free(filename);
-    if (!private.f)
-    {
-        XPOST_LOG_ERR("cannot retrieve PNG file name");
-        return unregistered;
-    }
-
     ud = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2);
     compression_level_o = xpost_dict_get(ctx, ud,
                                          xpost_name_cons(ctx, "png_compression_level"));
@@ -178,10 +158,10 @@ int _create_cont(Xpost_Context *ctx,
                                   xpost_name_cons(ctx, "png_interlaced"));
 
     if (xpost_object_get_type(compression_level_o) == invalidtype)
-        compression_level = 3;
+        private.compression_level = 3;
     else
-        compression_level = compression_level_o.int_.val;
-    XPOST_LOG_INFO("PNG compresion level: %d", compression_level);
+        private.compression_level = compression_level_o.int_.val;
+    XPOST_LOG_INFO("PNG compresion level: %d", private.compression_level);
 
     if (xpost_object_get_type(interlaced_o) == invalidtype)
         private.interlaced = PNG_INTERLACE_NONE;
@@ -200,45 +180,15 @@ int _create_cont(Xpost_Context *ctx,
     }
     XPOST_LOG_INFO("PNG interlacing: %s",
                    (private.interlaced == PNG_INTERLACE_ADAM7) ? "Adam7" : "none");
-    private.info_ptr = NULL;
-    private.png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
-                                              NULL, NULL, NULL);
-    if (!private.png_ptr)
-        goto close_file;
-
-    private.info_ptr = png_create_info_struct(private.png_ptr);
-    if (!private.info_ptr)
-        goto destroy_png;
-
-    if (setjmp(png_jmpbuf(private.png_ptr)))
-        goto destroy_info;
-
     /* allocate buffer header and array */
     private.buf = malloc(sizeof(Xpost_Png_Buffer) +
                          sizeof(Xpost_Png_Pixel) * width * height);
     if (!private.buf)
     {
         XPOST_LOG_ERR("cannot allocate buffer memory");
-        goto destroy_info;
+        return unregistered;
     }
 
-	png_init_io(private.png_ptr, private.f);
-	png_set_IHDR(private.png_ptr, private.info_ptr,
-                 private.width, private.height, 8,
-                 PNG_COLOR_TYPE_RGB, private.interlaced,
-                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-    sig_bit.red = 8;
-    sig_bit.green = 8;
-    sig_bit.blue = 8;
-    sig_bit.alpha = 8;
-    png_set_sBIT(private.png_ptr, private.info_ptr, &sig_bit);
-
-    png_set_compression_level(private.png_ptr, compression_level);
-    png_write_info(private.png_ptr, private.info_ptr);
-    png_set_shift(private.png_ptr, &sig_bit);
-    png_set_packing(private.png_ptr);
-
     /* save private data struct in string */
     xpost_memory_put(xpost_context_select_memory(ctx, privatestr),
                      xpost_object_get_ent(privatestr), 0,
@@ -247,16 +197,6 @@ int _create_cont(Xpost_Context *ctx,
     /* return device instance dictionary to ps */
     xpost_stack_push(ctx->lo, ctx->os, devdic);
     return 0;
-
-  destroy_info:
-	png_destroy_info_struct(private.png_ptr, (png_infopp) & private.info_ptr);
-  destroy_png:
-	png_destroy_write_struct(&private.png_ptr,
-                             (private.info_ptr) ? (png_infopp)&private.info_ptr : NULL);
-  close_file:
-    fclose(private.f);
-
-    return unregistered;
 }
 
 static
@@ -320,12 +260,19 @@ int _putpix(Xpost_Context *ctx,
     return 0;
 }
 
+/* write the page as a complete file named by OutputFileName,
+   so each showpage (or each job of a batch) gets a file of its own */
 static
 int _emit(Xpost_Context *ctx,
           Xpost_Object devdic)
 {
     Xpost_Object privatestr;
     PrivateData private;
+    char *filename;
+    FILE *f;
+    png_structp png_ptr;
+    png_infop info_ptr;
+    png_color_8 sig_bit;
     unsigned char *data;
     png_bytep row_ptr;
     int num_passes = 1;
@@ -339,8 +286,54 @@ int _emit(Xpost_Context *ctx,
     xpost_memory_get(xpost_context_select_memory(ctx, privatestr),
             xpost_object_get_ent(privatestr), 0, sizeof private, &private);
 
+    filename = xpost_device_get_filename(ctx, devdic);
+    if (!filename)
+    {
+        XPOST_LOG_ERR("cannot retrieve PNG file name");
+        return unregistered;
+    }
+
+    f = fopen(filename, "wb");
+    if (!f)
+    {
+        XPOST_LOG_ERR("cannot open PNG file %s", filename);
+        free(filename);
+        return ioerror;
+    }
+    free(filename);
+
+    info_ptr = NULL;
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                      NULL, NULL, NULL);
+    if (!png_ptr)
+        goto close_file;
+
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr)
+        goto destroy_png;
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+        goto destroy_png;
+
+    png_init_io(png_ptr, f);
+    png_set_IHDR(png_ptr, info_ptr,
+                 private.width, private.height, 8,
+                 PNG_COLOR_TYPE_RGB, private.interlaced,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    sig_bit.red = 8;
+    sig_bit.green = 8;
+    sig_bit.blue = 8;
+    sig_bit.alpha = 8;
+    png_set_sBIT(png_ptr, info_ptr, &sig_bit);
+
+    png_set_compression_level(png_ptr, private.compression_level);
+    png_write_info(png_ptr, info_ptr);
+    png_set_shift(png_ptr, &sig_bit);
+    png_set_packing(png_ptr);
+
 #ifdef PNG_WRITE_INTERLACING_SUPPORTED
-    num_passes = png_set_interlace_handling(private.png_ptr);
+    num_passes = png_set_interlace_handling(png_ptr);
 #endif
 
     for (pass = 0; pass < num_passes; pass++)
@@ -349,11 +342,15 @@ int _emit(Xpost_Context *ctx,
         for (y = 0; y < private.height; y++)
         {
             row_ptr = (png_bytep)data;
-            png_write_rows(private.png_ptr, &row_ptr, 1);
+            png_write_rows(png_ptr, &row_ptr, 1);
             data += 3 * private.width;
         }
     }
 
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(f);
+
     /* pass data back to client application */
     {
         Xpost_Object sd, outbufstr;
@@ -368,6 +365,14 @@ int _emit(Xpost_Context *ctx,
     }
 
     return 0;
+
+  destroy_png:
+    png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr : NULL);
+  close_file:
+    fclose(f);
+    XPOST_LOG_ERR("cannot write PNG file");
+
+    return ioerror;
 }
 
 static
@@ -386,10 +391,6 @@ int _destroy(Xpost_Context *ctx,
                      sizeof(private), &private);
 
     free(private.buf);
-    png_write_end(private.png_ptr, private.info_ptr);
-    png_destroy_write_struct(&private.png_ptr, (png_infopp) & private.info_ptr);
-    png_destroy_info_struct(private.png_ptr, (png_infopp) & private.info_ptr);
-    fclose(private.f);
 
     return 0;
 }
@@ -49,6 +49,7 @@
 #include "xpost_free.h"  /* dicts are allocated from the free list */
 
 #include "xpost_save.h"  /* dicts obey save/restore */
+#include "xpost_garbage.h"  /* stores into old dicts are remembered */
 #include "xpost_context.h"
 #include "xpost_error.h"  /* dict functions may throw errors */
 #include "xpost_string.h"  /* may need string functions (convert to name) */
@@ -188,18 +189,72 @@ cont:
     }
 }
 
-/* more like scrambled eggs */
+/* largest table, in entries:
+   forall walks the table with the 16bit offset field of the dict object */
+#define XPOST_DICT_MAX_TABN (sizeof(word) == 2 ? 0x8000U : 0x40000000U)
+
+/* smallest table */
+#define XPOST_DICT_MIN_TABN 16U
+
+/* lookups by number of table entries examined */
+static
+unsigned long _xpost_dict_probe_hist[XPOST_DICT_PROBE_HIST_SIZE];
+
+const unsigned long *xpost_dict_get_probe_histogram(void)
+{
+    return _xpost_dict_probe_hist;
+}
+
+/* scramble the bits of a 32bit value (the MurmurHash3 finalizer),
+   so the low bits used to index the table depend on all of them */
+static
+unsigned int _xpost_dict_mix(unsigned int h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/* hash a (clean) key.
+   only the fields compared by xpost_dict_compare_objects are used,
+   and the flags are ignored (except BANK!) */
 static
 unsigned int hash(Xpost_Object k)
 {
     unsigned int h;
-    h = ( (xpost_object_get_type(k)
-            | (k.comp_.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK))
-            << 1) /* ignore flags (except BANK!) */
-        + (k.comp_.sz << 3)
-        + (xpost_object_get_ent(k) << 7)
-        + (k.comp_.off << 5);
-    /* h = xpost_object_get_type(k); /\* test collisions. *\/ */
+    unsigned int t;
+
+    t = xpost_object_get_type(k);
+    switch (t)
+    {
+        case nametype: /*@fallthrough@*/
+        case operatortype:
+            h = k.mark_.padw;
+            break;
+        case booleantype:
+            h = (unsigned int)k.int_.val;
+            break;
+        case extendedtype:
+            h = (unsigned int)k.extended_.fraction ^ ((unsigned int)k.extended_.sign_exp << 20);
+            break;
+        case dicttype: /*@fallthrough@*/
+        case arraytype:
+            h = (unsigned int)xpost_object_get_ent(k)
+                ^ ((unsigned int)k.comp_.off << 16)
+                ^ ((unsigned int)k.comp_.sz * 0x9e3779b9U);
+            break;
+        case filetype:
+            h = (unsigned int)xpost_object_get_ent(k);
+            break;
+        default:
+            h = 0;
+            break;
+    }
+    t |= k.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK;
+    h = _xpost_dict_mix(h ^ (t * 0x9e3779b9U));
 #ifdef DEBUGDIC
     printf("\nhash(");
     xpost_object_dump(k);
@@ -208,16 +263,30 @@ unsigned int hash(Xpost_Object k)
     return h;
 }
 
+/* number of table entries for a dict of size sz:
+   the smallest power of 2 keeping the table at most 3/4 full */
+static
+unsigned int _xpost_dict_table_length(unsigned int sz)
+{
+    unsigned int n = XPOST_DICT_MIN_TABN;
+    while (n < XPOST_DICT_MAX_TABN && n / 4 * 3 < sz)
+        n <<= 1;
+    return n;
+}
+
 /*
-   Allocate a dictionary in the specified memory file.
+   Allocate a dictionary with a table of tabn entries
+   in the specified memory file.
 
    allocate an entity with xpost_memory_table_alloc,
    set the save level in the mark,
    extract the "pointer" from the entity,
    Initialize a dichead in memory,
    just after the head, clear a table of pairs. */
-Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
-               unsigned int sz)
+static
+Xpost_Object _xpost_dict_cons_table(Xpost_Memory_File *mem,
+                                    unsigned int sz,
+                                    unsigned int tabn)
 {
     Xpost_Memory_Table *tab;
     Xpost_Object d;
@@ -231,14 +300,11 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     unsigned int ent;
     unsigned int hashnull;
 
-    if (sz < 8) sz = 8;
-    sz = (unsigned int)ceil((double)sz * 1.25);
-
     assert(mem->base);
     d.tag = dicttype | (XPOST_OBJECT_TAG_ACCESS_UNLIMITED << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
     d.comp_.sz = sz;
     d.comp_.off = 0;
-    if (!xpost_memory_table_alloc(mem, sizeof(dichead) + DICTABSZ(sz), dicttype, &ent))
+    if (!xpost_memory_table_alloc(mem, sizeof(dichead) + DICTABSZ(tabn), dicttype, &ent))
     {
         XPOST_LOG_ERR("cannot allocate dictionary");
         return null;
@@ -251,7 +317,7 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
     cnt = xpost_stack_count(mem, vs);
     tab->tab[rent].mark = ( (0 << XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET)
-            | (0 << XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET)
+            | (0 << XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET)
             | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
             | (cnt << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET) );
 
@@ -260,11 +326,11 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     dp->tag = d.tag;
     dp->sz = sz;
     dp->nused = 0;
-    dp->pad = 0;
+    dp->mask = tabn - 1;
 
     tp = (void *)(mem->base + ad + sizeof(dichead)); /* clear table */
     hashnull = hash(null);
-    for (i=0; i < DICTABN(sz); i++){
+    for (i=0; i < tabn; i++){
         tp[i].hash = hashnull;
         tp[i].key = null; /* remember our null object is not all-zero! */
         tp[i].value = null;
@@ -275,6 +341,25 @@ Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
     return d;
 }
 
+/*
+   Allocate a dictionary in the specified memory file.
+
+   size the table for sz, plus some slack,
+   call _xpost_dict_cons_table. */
+Xpost_Object xpost_dict_cons_memory (Xpost_Memory_File *mem,
+               unsigned int sz)
+{
+    unsigned int tabn;
+
+    if (sz < 8) sz = 8;
+    sz = (unsigned int)ceil((double)sz * 1.25);
+    tabn = _xpost_dict_table_length(sz);
+    if (sz > tabn / 4 * 3)
+        sz = tabn / 4 * 3;
+
+    return _xpost_dict_cons_table(mem, sz, tabn);
+}
+
 /*
    Allocate a dictionary in the currently active memory.
 
@@ -319,8 +404,9 @@ unsigned int xpost_dict_max_length_memory (Xpost_Memory_File *mem,
 /*
    grow a dictionary to a larger size.
 
-   allocate a new dictionary,
-   copy over all non-null key/value pairs,
+   save the whole dict if not saved whole at this level,
+   allocate a new dictionary with twice the table,
+   re-insert all non-null key/value pairs with their stored hashes,
    swap adrs in the two table slots. */
 static
 int dicgrow(Xpost_Context *ctx,
@@ -328,20 +414,35 @@ int dicgrow(Xpost_Context *ctx,
 {
     Xpost_Memory_File *mem;
     unsigned int sz;
-    unsigned int newsz;
+    unsigned int tabn;
     unsigned int ad;
     dichead *dp;
     dicrec *tp;
+    dichead *np;
+    dicrec *ntp;
     Xpost_Object n;
     unsigned int i;
+    unsigned int j;
 
     xpost_stack_push(ctx->lo, ctx->hold, d);
     mem = xpost_context_select_memory(ctx, d);
+    if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(d)))
+        if (!xpost_save_save_ent(mem, dicttype, 0, xpost_object_get_ent(d)))
+            return 0;
 #ifdef DEBUGDIC
     printf("DI growing dict\n");
     xpost_dict_dump_memory (mem, d);
 #endif
-    n = xpost_dict_cons_memory (mem, newsz = 2 * xpost_dict_max_length_memory (mem, d));
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
+    dp = (void *)(mem->base + ad);
+    tabn = DICTABN(dp);
+    if (tabn >= XPOST_DICT_MAX_TABN)
+    {
+        XPOST_LOG_ERR("cannot grow dict beyond %u entries", XPOST_DICT_MAX_TABN);
+        return 0;
+    }
+    tabn *= 2;
+    n = _xpost_dict_cons_table(mem, tabn / 4 * 3, tabn);
     if (xpost_object_get_type(n) == nulltype){
         XPOST_LOG_ERR("cannot grow dict");
         return 0;
@@ -351,13 +452,21 @@ int dicgrow(Xpost_Context *ctx,
 
     xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
     dp = (void *)(mem->base + ad);
-    sz = DICTABN(dp->sz);
+    sz = DICTABN(dp);
     tp = (void *)(mem->base + ad + sizeof(dichead)); /* copy data */
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(n), &ad);
+    np = (void *)(mem->base + ad);
+    ntp = (void *)(mem->base + ad + sizeof(dichead));
+    np->tag = dp->tag;
+    np->nused = dp->nused;
     for (i = 0; i < sz; i++)
     {
         if (xpost_object_get_type(tp[i].key) != nulltype)
         {
-            xpost_dict_put_memory(ctx, mem, n, tp[i].key, tp[i].value);
+            j = tp[i].hash & np->mask;
+            while (xpost_object_get_type(ntp[j].key) != nulltype)
+                j = (j + 1) & np->mask;
+            ntp[j] = tp[i];
         }
     }
 #ifdef DEBUGDIC
@@ -382,6 +491,9 @@ int dicgrow(Xpost_Context *ctx,
         hold = tab->tab[dent].sz;
                tab->tab[dent].sz = tab->tab[nent].sz;
                                    tab->tab[nent].sz = hold;
+        hold = tab->tab[dent].used;
+               tab->tab[dent].used = tab->tab[nent].used;
+                                     tab->tab[nent].used = hold;
 
 #if 0
         if (xpost_free_memory_ent(mem, nent) < 0)
@@ -414,7 +526,7 @@ void xpost_dict_dump_memory (Xpost_Memory_File *mem,
     xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
     dp = (void *)(mem->base + ad);
     tp = (void *)(mem->base + ad + sizeof(dichead));
-    sz = DICTABN(dp->sz);
+    sz = DICTABN(dp);
 
     printf("\n");
     for (i = 0; i < sz; i++)
@@ -486,12 +598,8 @@ Xpost_Object clean_key (Xpost_Context *ctx,
     {
         default: break;
         case stringtype:
-        {
-	    char *s = xpost_string_allocate_cstring(ctx, k);
-            k = xpost_name_cons(ctx, s);
-	    free(s);
+            k = xpost_name_cons_bytes(ctx, k.comp_.sz, xpost_string_get_pointer(ctx, k));
             break;
-        }
         case integertype:
             k = consextended(k.int_.val);
             k.tag |= XPOST_OBJECT_TAG_DATA_EXTENDED_INT;
@@ -504,12 +612,9 @@ Xpost_Object clean_key (Xpost_Context *ctx,
     return k;
 }
 
-/* repeated loop body from the lookup function */
-#define RETURN_TAB_I_IF_EQ_K_OR_NULL    \
-    if (xpost_object_get_type(tp[i].key) == nulltype \
-        || (hashval == tp[i].hash \
-            && xpost_dict_compare_objects(ctx, tp[i].key, k) == 0)) \
-        return tp + i
+/* count a lookup which examined n table entries */
+#define XPOST_DICT_COUNT_PROBES(n) \
+    ++_xpost_dict_probe_hist[(n) < XPOST_DICT_PROBE_HIST_SIZE ? (n) - 1 : XPOST_DICT_PROBE_HIST_SIZE - 1]
 
 static dicrec invalidrec[] = {{ 0, {0}, {0}}};
 
@@ -525,41 +630,56 @@ dicrec *diclookup(Xpost_Context *ctx,
     unsigned int ad;
     dichead *dp;
     dicrec *tp;
-    unsigned int sz;
+    unsigned int mask;
     unsigned int hashval;
-    unsigned int h;
     unsigned int i;
+    unsigned int n;
+    int isname;
 
-    k = clean_key(ctx, k);
-    if (xpost_object_get_type(k) == invalidtype)
-        return invalidrec;
+    /* names are already clean */
+    isname = xpost_object_get_type(k) == nametype;
+    if (!isname)
+    {
+        k = clean_key(ctx, k);
+        if (xpost_object_get_type(k) == invalidtype)
+            return invalidrec;
+    }
 
     if (!xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad))
         return invalidrec;
     dp = (void *)(mem->base + ad);
     tp = (void *)(mem->base + ad + sizeof(dichead));
-    sz = (dp->sz + 1);
+    mask = dp->mask;
 
     hashval = hash(k);
-    h = hashval % sz;
-    i = h;
+    i = hashval & mask;
 #ifdef DEBUGDIC
     printf("diclookup(");
     xpost_object_dump(k);
     printf(");");
-    printf("%%%u=%u",sz, h);
+    printf("&%u=%u", mask, i);
 #endif
 
-    RETURN_TAB_I_IF_EQ_K_OR_NULL;
-    for (++i; i < sz; i++)
-    {
-        RETURN_TAB_I_IF_EQ_K_OR_NULL;
-    }
-    for (i = 0; i < h; i++)
+    for (n = 1; n <= mask + 1; n++, i = (i + 1) & mask)
     {
-        RETURN_TAB_I_IF_EQ_K_OR_NULL;
+        if (xpost_object_get_type(tp[i].key) == nulltype)
+            break;
+        if (hashval != tp[i].hash)
+            continue;
+        if (isname)
+        { /* same type, bank and name index */
+            if (tp[i].key.mark_.padw == k.mark_.padw &&
+                !((tp[i].key.tag ^ k.tag) &
+                  (XPOST_OBJECT_TAG_DATA_TYPE_MASK | XPOST_OBJECT_TAG_DATA_FLAG_BANK)))
+                break;
+        }
+        else if (xpost_dict_compare_objects(ctx, tp[i].key, k) == 0)
+            break;
     }
-    return NULL; /* i == h : dict is overfull: no null entry */
+    if (n > mask + 1)
+        return NULL; /* dict is overfull: no null entry */
+    XPOST_DICT_COUNT_PROBES(n);
+    return tp + i;
 }
 
 /* see if lookup returns a non-null pair. */
@@ -602,6 +722,8 @@ Xpost_Object xpost_dict_get_memory (Xpost_Context *ctx,
     else if (xpost_object_get_type(r->value) == magictype)
     {
         Xpost_Object ret;
+        /* computed value: keep it out of the name cache */
+        xpost_context_name_cache_flush(ctx);
         r->value.magic_.pair->get(ctx, d, k, &ret);
         return ret;
     }
@@ -624,9 +746,9 @@ Xpost_Object xpost_dict_get(Xpost_Context *ctx,
    Put key+value in dict with specified memory file.
    (dict must be valid for this memory file)
 
-   save data if not save at this level,
    lookup the key,
    if key is null, check if the dict is full,
+   save the pair and header if not saved at this level,
        increase nused,
        set key,
        update value. */
@@ -639,15 +761,14 @@ int xpost_dict_put_memory(Xpost_Context *ctx,
     dicrec *r;
     dichead *dp;
     unsigned int ad;
+    unsigned int slot;
     int ret;
 
     if (!ctx->gl->interpreter_get_initializing())
         if (!xpost_object_is_writeable(ctx, d))
             return invalidaccess;
 
-    if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(d)))
-        if (!xpost_save_save_ent(mem, dicttype, 0, xpost_object_get_ent(d)))
-            return VMerror;
+    xpost_context_name_cache_invalidate(ctx, k);
 
     r = diclookup(ctx, mem, d, k);
 
@@ -655,9 +776,11 @@ int xpost_dict_put_memory(Xpost_Context *ctx,
         XPOST_LOG_ERR("warning: invalid key\n");
         return VMerror;
     }
-    if (r == NULL)
+    if (r == NULL
+        || (xpost_object_get_type(r->key) == nulltype
+            && xpost_dict_is_full_memory (mem, d)))
     {
-        /* dict overfull:  grow dict! */
+        /* dict full:  grow dict! */
         ret = dicgrow(ctx, d);
         if (!ret)
             return VMerror;
@@ -666,40 +789,38 @@ int xpost_dict_put_memory(Xpost_Context *ctx,
         if (r == NULL)
             return VMerror;
     }
-    else if (xpost_object_get_type(r->key) == invalidtype)
+    else if (xpost_object_get_type(r->key) != invalidtype
+             && xpost_object_get_type(r->key) != nulltype
+             && xpost_object_get_type(r->value) == magictype)
+    {
+        r->value.magic_.pair->put(ctx, d, k, v);
+        return 0;
+    }
+
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
+    slot = (unsigned int)(r - (dicrec *)(mem->base + ad + sizeof(dichead)));
+    if (!xpost_save_save_range(mem, dicttype, 0, xpost_object_get_ent(d), slot, 1))
+        return VMerror;
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad); /* the file may have moved */
+    dp = (void *)(mem->base + ad);
+    r = (dicrec *)(mem->base + ad + sizeof(dichead)) + slot;
+
+    if (xpost_object_get_type(r->key) == invalidtype)
     {
         XPOST_LOG_ERR("warning: invalidtype key in dict\n");
         r->key = null;
     }
     else if (xpost_object_get_type(r->key) == nulltype)
     {
-        if (xpost_dict_is_full_memory (mem, d))
-        {
-            /* dict full:  grow dict! */
-            ret = dicgrow(ctx, d);
-            if (!ret)
-                return VMerror;
-
-            r = diclookup(ctx, mem, d, k);
-
-            if (r == NULL)
-                return VMerror;
-        }
-
-        xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
-        dp = (void *)(mem->base + ad);
         ++ dp->nused;
         r->key = clean_key(ctx, k);
         r->hash = hash(r->key);
         if (xpost_object_get_type(r->key) == invalidtype)
             return VMerror;
     }
-    else if (xpost_object_get_type(r->value) == magictype)
-    {
-        r->value.magic_.pair->put(ctx, d, k, v);
-        return 0;
-    }
     r->value = v;
+    if (xpost_object_is_composite(k) || xpost_object_is_composite(v))
+        xpost_garbage_remember(mem, xpost_object_get_ent(d));
     return 0;
 }
 
@@ -739,7 +860,11 @@ int xpost_dict_put(Xpost_Context *ctx,
     return xpost_dict_put_memory(ctx, xpost_context_select_memory(ctx, d), d, k, v);
 }
 
-/* undefine key from dict */
+/* undefine key from dict
+
+   find the pair, then close the gap in the probe sequence:
+   move each following pair back into the hole
+   unless its home slot lies between the hole and itself. */
 int xpost_dict_undef_memory(Xpost_Context *ctx,
         Xpost_Memory_File *mem,
         Xpost_Object d,
@@ -749,90 +874,58 @@ int xpost_dict_undef_memory(Xpost_Context *ctx,
     unsigned int ad;
     dichead *dp;
     dicrec *tp;
-    unsigned int sz;
-    unsigned int hashval;
-    unsigned int h;
+    unsigned int mask;
+    unsigned int home;
     unsigned int i;
-    unsigned int last = 0;
-    int lastisset = 0;
-    int found = 0;
+    unsigned int j;
 
-    if (!xpost_save_ent_is_saved(mem, xpost_object_get_ent(d)))
-        if (!xpost_save_save_ent(mem, dicttype, 0, xpost_object_get_ent(d)))
-            return VMerror;
-
-    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
-    dp = (void *)(mem->base + ad);
-    tp = (void *)(mem->base + ad + sizeof(dichead));
+    xpost_context_name_cache_invalidate(ctx, k);
 
     k = clean_key(ctx, k);
     if (xpost_object_get_type(k) == invalidtype)
         return VMerror;
 
     e = diclookup(ctx, mem, d, k); /*find slot for key */
-    if (e == NULL || e == invalidrec || xpost_dict_compare_objects(ctx,e->key,null) == 0)
+    if (e == NULL || e == invalidrec || xpost_object_get_type(e->key) == nulltype)
     {
         return undefined;
     }
 
-    /*find last chained key and value with same hash */
-    /*FIXME: need to repeat this process with this 'last chained key with same hash'
-      until the key we're clearing is the actual last key in the chain, recursively. */
-    sz = DICTABN(dp->sz);
-    hashval = hash(k);
-    h = hashval % sz;
-
-    for (i = h; i < sz; i++)
-    {
-        if (h == hash(tp[i].key) % sz)
-        {
-            last = i;
-            lastisset = 1;
-        }
-        else if (xpost_dict_compare_objects(ctx, tp[i].key, null) == 0)
-        {
-            if (lastisset)
-            {
-                found = 1;
-                break;
-            }
-        }
-    }
-
-    if (!found)
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad);
+    dp = (void *)(mem->base + ad);
+    tp = (void *)(mem->base + ad + sizeof(dichead));
+    mask = dp->mask;
+    j = (unsigned int)(e - tp);
+
+    /* the pairs that may move run from the hole to the next empty slot */
+    for (i = (j + 1) & mask;
+         xpost_object_get_type(tp[i].key) != nulltype;
+         i = (i + 1) & mask)
+        ;
+    if (!xpost_save_save_range(mem, dicttype, 0, xpost_object_get_ent(d),
+                               j, i > j ? i - j : mask + 1 - j)
+        || (i < j && !xpost_save_save_range(mem, dicttype, 0, xpost_object_get_ent(d),
+                                            0, i)))
+        return VMerror;
+    xpost_memory_table_get_addr(mem, xpost_object_get_ent(d), &ad); /* the file may have moved */
+    dp = (void *)(mem->base + ad);
+    tp = (void *)(mem->base + ad + sizeof(dichead));
+    --dp->nused;
+    for (i = (j + 1) & mask;
+         xpost_object_get_type(tp[i].key) != nulltype;
+         i = (i + 1) & mask)
     {
-        for (i = 0; i < h; i++)
+        home = tp[i].hash & mask;
+        if (j < i ? (home <= j || home > i)
+                  : (home <= j && home > i))
         {
-            if (h == hash(tp[i].key) % sz)
-            {
-                last = i;
-                lastisset = 1;
-            }
-            else if (xpost_dict_compare_objects(ctx, tp[i].key, null) == 0)
-            {
-                if (lastisset)
-                {
-                    found = 1;
-                    break;
-                }
-            }
+            tp[j] = tp[i];
+            j = i;
         }
     }
-
-    if (found) /* f found: move last key and value to slot */
-    {
-        e->key = tp[last].key;
-        e->value = tp[last].value;
-        tp[last].key = null;
-        tp[last].hash = hash(tp[last].key);
-        tp[last].value = null;
-    }
-    else /* ot found: write null over key and value */
-    {
-        e->key = null;
-        tp[last].hash = hash(tp[last].key);
-        e->value = null;
-    }
+    tp[j].key = null;
+    tp[j].hash = hash(null);
+    tp[j].value = null;
 
     return 0;
 }
@@ -845,6 +938,39 @@ void xpost_dict_undef(Xpost_Context *ctx,
     xpost_dict_undef_memory(ctx, xpost_context_select_memory(ctx, d), d, k);
 }
 
+/* find the next pair in dict d for forall,
+   starting at table slot d->comp_.off, and advance d past it.
+   returns 0 when no pairs remain. */
+int xpost_dict_next_pair(Xpost_Context *ctx,
+        Xpost_Object *d,
+        Xpost_Object *k,
+        Xpost_Object *v)
+{
+    Xpost_Memory_File *mem = xpost_context_select_memory(ctx, *d);
+    unsigned int ad;
+    dichead *dp;
+    dicrec *tp;
+    unsigned int tabn;
+
+    if (!xpost_memory_table_get_addr(mem, xpost_object_get_ent(*d), &ad))
+        return 0;
+    dp = (void *)(mem->base + ad);
+    tabn = DICTABN(dp);
+    tp = (void *)(mem->base + ad + sizeof(dichead));
+    for ( ; d->comp_.off < tabn; ++d->comp_.off)
+    {
+        if (xpost_object_get_type(tp[d->comp_.off].key) != nulltype)
+        {
+            *k = tp[d->comp_.off].key;
+            if (xpost_object_get_type(*k) == extendedtype)
+                *k = xpost_dict_convert_extended_to_number(*k);
+            *v = tp[d->comp_.off].value;
+            ++d->comp_.off;
+            return 1;
+        }
+    }
+    return 0;
+}
 
 #ifdef TESTMODULE_DI
 #include <stdio.h>
@@ -44,11 +44,12 @@
  *   off, offset into allocation
 
  * The entity data is a header structure
- * followed by header->sz+1 key/value pairs of objects in a linear array.
+ * followed by header->mask+1 key/value pairs of objects in a linear array.
  * Null keys denote empty slots in the hash table.
 
- * Dicts are implicitly 1 entry larger than declared
- * in order to simplify searching (terminate on null)
+ * The table size is a power of 2, at least 4/3 of the declared size,
+ * so the table is never more than 3/4 full. This keeps the linear
+ * probe sequences short, and searches always terminate on a null key.
  */
 
 /** @typedef typedef struct {} dichead
@@ -58,7 +59,7 @@ typedef struct
     word tag;
     word sz;
     word nused;
-    word pad;
+    word mask; /* number of table slots - 1 */
 } dichead;
 
 typedef struct
@@ -75,14 +76,29 @@ typedef struct Xpost_Magic_Pair
 } Xpost_Magic_Pair;
 
 /**
- * @brief yields the number of real entries in the table for a dict of size n
+ * @brief yields the number of real entries in the table for the dict with header dp
  */
-#define DICTABN(n) ((n)+1)
+#define DICTABN(dp) ((unsigned int)(dp)->mask + 1)
 
 /**
- * @brief yields the size in bytes of the table for a dict of size n
+ * @brief yields the size in bytes of a table of n entries
  */
-#define DICTABSZ(n) (DICTABN(n) * sizeof(dicrec))
+#define DICTABSZ(n) ((n) * sizeof(dicrec))
+
+/**
+ * @brief number of buckets in the probe-length histogram
+ *
+ * Bucket i counts the lookups which examined i+1 table entries,
+ * the last bucket counts all longer lookups.
+ */
+#define XPOST_DICT_PROBE_HIST_SIZE 16
+
+/**
+ * @brief yield the probe-length histogram of all dict lookups
+ *
+ * The result points to XPOST_DICT_PROBE_HIST_SIZE counters.
+ */
+const unsigned long *xpost_dict_get_probe_histogram(void);
 
 /**
  * @brief yield the access field from the dichead in vm
@@ -180,4 +196,10 @@ int xpost_dict_undef_memory(Xpost_Context *ctx, Xpost_Memory_File *mem, Xpost_Ob
 */
 void xpost_dict_undef(Xpost_Context *ctx, Xpost_Object d, Xpost_Object k);
 
+/**
+   find the next pair from table slot d->comp_.off, for forall,
+   and advance d past it. returns 0 at the end of the dict.
+*/
+int xpost_dict_next_pair(Xpost_Context *ctx, Xpost_Object *d, Xpost_Object *k, Xpost_Object *v);
+
 #endif
@@ -46,6 +46,22 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h> /* mmap munmap */
+#endif
+
+#ifndef _WIN32
+# include <fcntl.h> /* open */
+#endif
+
+#ifndef S_ISREG
+# define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
+#endif
+
 #include "xpost.h"
 #include "xpost_log.h"
 #include "xpost_compat.h"
@@ -98,11 +114,76 @@ f_tmpfile(void)
 # define f_tmpfile tmpfile
 #endif
 
+/* read up to n bytes from a non-interactive DiskFile into buf,
+   bypassing the read-ahead buffer.
+   returns the number of bytes read, 0 at end of file. */
+static size_t
+disk_rawread(Xpost_DiskFile *df, unsigned char *buf, size_t n)
+{
+#ifdef HAVE_UNISTD_H
+    if (df->kind == XPOST_DISKFILE_STREAM)
+    {
+        ssize_t r;
+
+        /* read returns as soon as some bytes are available,
+           so a slow producer on a pipe does not stall the
+           interpreter until the whole buffer is full */
+        do
+            r = read(fileno(df->file), buf, n);
+        while (r < 0 && errno == EINTR);
+        return r < 0 ? 0 : (size_t)r;
+    }
+#endif
+    return fread(buf, 1, n, df->file);
+}
+
+/* refill the read-ahead buffer of a non-interactive DiskFile.
+   returns the number of bytes now in the window, 0 at end of file. */
+static size_t
+disk_fill(Xpost_DiskFile *df)
+{
+    size_t n;
+
+    if (!df->buf)
+    {
+        df->buf = malloc(XPOST_DISKFILE_BUFFER_SIZE);
+        if (!df->buf)
+            return 0;
+    }
+
+    n = disk_rawread(df, df->buf, XPOST_DISKFILE_BUFFER_SIZE);
+
+    df->methods.read_base = df->buf;
+    df->methods.read_next = df->buf;
+    df->methods.read_limit = df->buf + n;
+    return n;
+}
+
+/* drop any buffered input */
+static void
+disk_discard(Xpost_DiskFile *df)
+{
+    df->methods.read_base =
+        df->methods.read_next =
+        df->methods.read_limit = NULL;
+}
+
+/* called by xpost_file_getc only when the buffer is empty */
 static int
 disk_readch(Xpost_File *file)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
 
+    if (!df->file)
+        return EOF;
+
+    if (df->kind != XPOST_DISKFILE_INTERACTIVE)
+    {
+        if (!disk_fill(df))
+            return EOF;
+        return *df->methods.read_next++;
+    }
+
     /*
      * FIXME: check if this work on Windows
      * indeed, on Windows, select() needs a socket, not a fd, and fileno() returns a fd
@@ -143,14 +224,81 @@ disk_readch(Xpost_File *file)
     return fgetc(df->file);
 }
 
+/* reposition the stream over any read-ahead before writing */
+static void
+disk_unread_ahead(Xpost_DiskFile *df)
+{
+    if (df->methods.read_next != df->methods.read_limit &&
+        df->kind == XPOST_DISKFILE_REGULAR)
+    {
+        long pos = ftell(df->file) - (df->methods.read_limit - df->methods.read_next);
+        disk_discard(df);
+        fseek(df->file, pos, SEEK_SET);
+    }
+}
+
 static int
 disk_writech(Xpost_File *file, int c)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
 
+    disk_unread_ahead(df);
     return fputc(c, df->file);
 }
 
+/* called by xpost_file_read only when the buffer is empty.
+   requests of a whole buffer or more are read straight
+   into the caller's memory. */
+static size_t
+disk_read(Xpost_File *file, unsigned char *buf, size_t n)
+{
+    Xpost_DiskFile *df = (Xpost_DiskFile*) file;
+    size_t got = 0;
+    size_t r;
+    int c;
+
+    if (!df->file)
+        return 0;
+
+    if (df->kind == XPOST_DISKFILE_INTERACTIVE)
+    {
+        while (got < n && (c = disk_readch(file)) != EOF)
+            buf[got++] = c;
+        return got;
+    }
+
+    while (got < n)
+    {
+        if (n - got >= XPOST_DISKFILE_BUFFER_SIZE)
+        {
+            disk_discard(df);
+            r = disk_rawread(df, buf + got, n - got);
+        }
+        else
+        {
+            r = disk_fill(df);
+            if (r > n - got)
+                r = n - got;
+            memcpy(buf + got, df->methods.read_next, r);
+            df->methods.read_next += r;
+        }
+        if (!r)
+            break;
+        got += r;
+    }
+
+    return got;
+}
+
+static size_t
+disk_write(Xpost_File *file, const unsigned char *buf, size_t n)
+{
+    Xpost_DiskFile *df = (Xpost_DiskFile*) file;
+
+    disk_unread_ahead(df);
+    return fwrite(buf, 1, n, df->file);
+}
+
 static int
 disk_close(Xpost_File *file)
 {
@@ -158,6 +306,9 @@ disk_close(Xpost_File *file)
     FILE *fp = df->file;
     int ret;
 
+    disk_discard(df);
+    free(df->buf);
+    df->buf = NULL;
     if (fp == stdin || fp == stdout || fp == stderr) /* do NOT close standard files */
         return 0;
     ret = fclose(df->file);
@@ -178,25 +329,52 @@ static void
 disk_purge(Xpost_File *file)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
+
+    disk_discard(df);
 #ifndef _WIN32
     __fpurge(df->file);
 #endif
 }
 
+/* called by xpost_file_ungetc when c cannot simply be backed over */
 static int
 disk_unreadch(Xpost_File *file, int c)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
 
-    return ungetc(c, df->file);
+    if (c == EOF)
+        return EOF;
+
+    if (df->kind == XPOST_DISKFILE_INTERACTIVE)
+        return ungetc(c, df->file);
+
+    if (df->methods.read_next > df->methods.read_base)
+    {
+        *--df->methods.read_next = c;
+        return c;
+    }
+    if (df->methods.read_next == df->methods.read_limit && df->buf)
+    {
+        df->buf[0] = c;
+        df->methods.read_base = df->methods.read_next = df->buf;
+        df->methods.read_limit = df->buf + 1;
+        return c;
+    }
+
+    return EOF;
 }
 
 static long
 disk_tell(Xpost_File *file)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
+    long pos;
+
+    pos = ftell(df->file);
+    if (pos < 0)
+        return pos;
 
-    return ftell(df->file);
+    return pos - (df->methods.read_limit - df->methods.read_next);
 }
 
 static int
@@ -204,9 +382,35 @@ disk_seek(Xpost_File *file, long offset)
 {
     Xpost_DiskFile *df = (Xpost_DiskFile*) file;
 
+    disk_discard(df);
     return fseek(df->file, offset, SEEK_SET);
 }
 
+/* the size of the file less the read position */
+static long
+disk_bytesavailable(Xpost_File *file)
+{
+    Xpost_DiskFile *df = (Xpost_DiskFile*) file;
+    struct stat sb;
+    long pos;
+
+    if (!df->file)
+        return -1;
+    if (fstat(fileno(df->file), &sb) != 0)
+    {
+        XPOST_LOG_ERR("fstat did not return 0");
+        return -1;
+    }
+    if (sb.st_size > LONG_MAX)
+        return -1;
+
+    pos = disk_tell(file);
+    if (pos < 0)
+        return -1;
+
+    return (long)sb.st_size - pos;
+}
+
 struct Xpost_File_Methods disk_methods =
 {
     disk_readch,
@@ -216,7 +420,10 @@ struct Xpost_File_Methods disk_methods =
     disk_purge,
     disk_unreadch,
     disk_tell,
-    disk_seek
+    disk_seek,
+    disk_read,
+    disk_write,
+    disk_bytesavailable
 };
 
 static Xpost_File *
@@ -228,23 +435,53 @@ xpost_diskfile_open(const FILE *fp)
     {
         df->methods.methods = &disk_methods;
         df->file = (FILE*)fp;
+        df->buf = NULL;
+        disk_discard(df);
+        df->kind = XPOST_DISKFILE_INTERACTIVE;
+        if (fp && !xpost_isatty(fileno(df->file)))
+        {
+            struct stat sb;
+
+            if (fstat(fileno(df->file), &sb) == 0 && !S_ISREG(sb.st_mode))
+                df->kind = XPOST_DISKFILE_STREAM;
+            else
+                df->kind = XPOST_DISKFILE_REGULAR;
+        }
     }
 
     return &df->methods;
 }
 
 
+/* a readable MemoryFile exposes its contents as the read window,
+   so the slow path is only reached at end of file */
 static int
 memory_readch(Xpost_File *f)
 {
-    Xpost_MemoryFile *mf = (Xpost_MemoryFile *)f;
+    (void)f;
+    return EOF;
+}
 
-    if (!mf->is_read)
-        return EOF;
-    if (mf->read_next == mf->read_limit)
-        return EOF;
+/* make room for n more bytes of output, return 0 if there is none */
+static int
+memory_reserve(Xpost_MemoryFile *mf, size_t n)
+{
+    unsigned char *tmp;
+    size_t capacity;
 
-    return mf->contents[ mf->read_next++ ];
+    if (mf->write_capacity - mf->write_next >= n)
+        return 1;
+    if (!mf->is_malloc)
+        return 0;
+    capacity = mf->write_capacity * 1.4 + 12;
+    if (capacity < mf->write_next + n)
+        capacity = mf->write_next + n;
+    tmp = realloc(mf->contents, capacity);
+    if (!tmp)
+        return 0;
+    mf->contents = tmp;
+    mf->write_capacity = capacity;
+    return 1;
 }
 
 static int
@@ -254,21 +491,37 @@ memory_writech(Xpost_File *f, int c)
 
     if (mf->is_read)
         return EOF;
-    if (mf->write_next == mf->write_capacity){
-        unsigned char *tmp;
-        if (!mf->is_malloc)
-	    return EOF;
-	tmp = realloc(mf->contents, mf->write_capacity * 1.4 + 12);
-	if (!tmp)
-	    return EOF;
-	mf->contents = tmp;
-	mf->write_capacity = mf->write_capacity * 1.4 + 12;
-    }
+    if (!memory_reserve(mf, 1))
+        return EOF;
 
     mf->contents[ mf->write_next++ ] = c;
     return 0;
 }
 
+static size_t
+memory_read(Xpost_File *f, unsigned char *buf, size_t n)
+{
+    (void)f;
+    (void)buf;
+    (void)n;
+    return 0;
+}
+
+static size_t
+memory_write(Xpost_File *f, const unsigned char *buf, size_t n)
+{
+    Xpost_MemoryFile *mf = (Xpost_MemoryFile *)f;
+
+    if (mf->is_read)
+        return 0;
+    if (!memory_reserve(mf, n))
+        return 0;
+
+    memcpy(mf->contents + mf->write_next, buf, n);
+    mf->write_next += n;
+    return n;
+}
+
 static int
 memory_close(Xpost_File *f)
 {
@@ -278,9 +531,10 @@ memory_close(Xpost_File *f)
         free(mf->contents);
 
     mf->contents = NULL;
-    mf->read_next =
-      mf->read_limit =
-      mf->write_next =
+    mf->methods.read_base =
+      mf->methods.read_next =
+      mf->methods.read_limit = NULL;
+    mf->write_next =
       mf->write_capacity = 0;
     
     return 0;
@@ -301,7 +555,7 @@ memory_purge(Xpost_File *f)
     Xpost_MemoryFile *mf = (Xpost_MemoryFile *)f;
 
     if (mf->is_read)
-        mf->read_next = mf->read_limit;
+        mf->methods.read_next = mf->methods.read_limit;
 }
 
 static int
@@ -311,33 +565,36 @@ memory_unreadch(Xpost_File *f, int c)
 
     if (!mf->is_read)
         return EOF;
-    if (mf->read_next <= 0)
+    if (mf->methods.read_next <= mf->methods.read_base)
         return EOF;
 
-    mf->contents[ --mf->read_next ] = c;
+    *--mf->methods.read_next = c;
     return 0;
 }
 
 static long
 memory_tell(Xpost_File *f)
 {
-    Xpost_MemoryFile *mf = (Xpost_MemoryFile *)f;
-
-    return mf->read_next;
+    return f->read_next - f->read_base;
 }
 
 static int
 memory_seek(Xpost_File *f, long pos)
 {
-    Xpost_MemoryFile *mf = (Xpost_MemoryFile *)f;
-
-    if (pos > (ssize_t)mf->read_limit)
+    if (pos < 0 || pos > f->read_limit - f->read_base)
         return EOF;
 
-    mf->read_next = pos;
+    f->read_next = f->read_base + pos;
     return 0;
 }
 
+/* the read window holds the whole of the contents */
+static long
+memory_bytesavailable(Xpost_File *f)
+{
+    return f->read_limit - f->read_next;
+}
+
 struct Xpost_File_Methods memory_methods =
 {
     memory_readch,
@@ -347,7 +604,10 @@ struct Xpost_File_Methods memory_methods =
     memory_purge,
     memory_unreadch,
     memory_tell,
-    memory_seek
+    memory_seek,
+    memory_read,
+    memory_write,
+    memory_bytesavailable
 };
 
 static Xpost_File *
@@ -358,11 +618,12 @@ xpost_memoryfile_open_read(unsigned char *ptr, size_t limit)
     if (mf)
     {
         mf->methods.methods = &memory_methods;
+        mf->methods.read_base = ptr;
+        mf->methods.read_next = ptr;
+        mf->methods.read_limit = ptr + limit;
         mf->contents = ptr;
         mf->is_read = 1;
         mf->is_malloc = 0;
-        mf->read_next = 0;
-        mf->read_limit = limit;
     }
 
     return &mf->methods;
@@ -376,6 +637,7 @@ xpost_memoryfile_open_write(void)
     if (mf)
     {
         mf->methods.methods = &memory_methods;
+        mf->methods.read_base = mf->methods.read_next = mf->methods.read_limit = NULL;
 	mf->contents = NULL;
 	mf->is_read = 0;
 	mf->is_malloc = 1;
@@ -386,6 +648,238 @@ xpost_memoryfile_open_write(void)
     return &mf->methods;
 }
 
+static int
+mapped_readch(Xpost_File *f)
+{
+    /* the read window covers the whole mapping,
+       so the slow path is only reached at end of file */
+    (void)f;
+    return EOF;
+}
+
+static int
+mapped_writech(Xpost_File *f, int c)
+{
+    (void)f;
+    (void)c;
+    return EOF;
+}
+
+static void
+mapped_unmap(Xpost_MappedFile *mf)
+{
+    if (mf->is_mapped && mf->length)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile((void *)mf->base);
+#elif defined HAVE_MMAP
+        munmap((void *)mf->base, mf->length);
+#else
+        free((void *)mf->base);
+#endif
+    }
+    mf->is_mapped = 0;
+}
+
+static int
+mapped_close(Xpost_File *f)
+{
+    Xpost_MappedFile *mf = (Xpost_MappedFile *)f;
+
+    mapped_unmap(mf);
+    mf->base = NULL;
+    mf->length = 0;
+    mf->methods.read_base =
+        mf->methods.read_next =
+        mf->methods.read_limit = NULL;
+
+    return 0;
+}
+
+static int
+mapped_flush(Xpost_File *f)
+{
+    (void)f;
+    return 0;
+}
+
+static void
+mapped_purge(Xpost_File *f)
+{
+    f->read_next = f->read_limit;
+}
+
+/* the mapping is read-only, so only the byte just read
+   can be pushed back, and xpost_file_ungetc handles that inline */
+static int
+mapped_unreadch(Xpost_File *f, int c)
+{
+    (void)f;
+    (void)c;
+    return EOF;
+}
+
+static size_t
+mapped_read(Xpost_File *f, unsigned char *buf, size_t n)
+{
+    (void)f;
+    (void)buf;
+    (void)n;
+    return 0;
+}
+
+static size_t
+mapped_write(Xpost_File *f, const unsigned char *buf, size_t n)
+{
+    (void)f;
+    (void)buf;
+    (void)n;
+    return 0;
+}
+
+static long
+mapped_tell(Xpost_File *f)
+{
+    return f->read_next - f->read_base;
+}
+
+static int
+mapped_seek(Xpost_File *f, long pos)
+{
+    if (pos < 0 || pos > f->read_limit - f->read_base)
+        return EOF;
+
+    f->read_next = f->read_base + pos;
+    return 0;
+}
+
+/* the read window covers the whole mapping */
+static long
+mapped_bytesavailable(Xpost_File *f)
+{
+    return f->read_limit - f->read_next;
+}
+
+struct Xpost_File_Methods mapped_methods =
+{
+    mapped_readch,
+    mapped_writech,
+    mapped_close,
+    mapped_flush,
+    mapped_purge,
+    mapped_unreadch,
+    mapped_tell,
+    mapped_seek,
+    mapped_read,
+    mapped_write,
+    mapped_bytesavailable
+};
+
+static Xpost_File *
+xpost_mappedfile_open(const unsigned char *base, size_t length, int is_mapped)
+{
+    Xpost_MappedFile *mf = malloc(sizeof *mf);
+
+    if (!mf)
+        return NULL;
+
+    mf->methods.methods = &mapped_methods;
+    mf->base = base;
+    mf->length = length;
+    mf->is_mapped = is_mapped;
+    mf->methods.read_base = (unsigned char *)base;
+    mf->methods.read_next = (unsigned char *)base;
+    mf->methods.read_limit = (unsigned char *)base + length;
+
+    return &mf->methods;
+}
+
+/* map the contents of a regular file read-only.
+   an empty file yields a NULL base and length 0. */
+static
+int mapfile(const char *fn, const unsigned char **base, size_t *length)
+{
+#ifdef _WIN32
+    HANDLE h;
+    HANDLE fm;
+    LARGE_INTEGER sz;
+
+    h = CreateFile(fn, GENERIC_READ, FILE_SHARE_READ,
+                   NULL, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return undefinedfilename;
+    if (!GetFileSizeEx(h, &sz))
+    {
+        CloseHandle(h);
+        return ioerror;
+    }
+    *length = (size_t)sz.QuadPart;
+    *base = NULL;
+    if (*length)
+    {
+        fm = CreateFileMapping(h, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (fm)
+        {
+            *base = (const unsigned char *)MapViewOfFile(fm, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(fm);
+        }
+    }
+    CloseHandle(h);
+    if (*length && !*base)
+        return ioerror;
+    return 0;
+#else
+    struct stat sb;
+    int fd;
+
+    fd = open(fn, O_RDONLY);
+    if (fd == -1)
+    {
+        switch (errno)
+        {
+            case EACCES: return invalidfileaccess;
+            case ENOENT: return undefinedfilename;
+            default: return unregistered;
+        }
+    }
+    if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode))
+    {
+        close(fd);
+        return ioerror;
+    }
+    *length = (size_t)sb.st_size;
+    *base = NULL;
+    if (*length)
+    {
+# ifdef HAVE_MMAP
+        void *p = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return ioerror;
+        }
+        *base = p;
+# else
+        unsigned char *p = malloc(*length);
+        size_t n = 0;
+        ssize_t r;
+
+        if (!p)
+        {
+            close(fd);
+            return VMerror;
+        }
+        while (n < *length && (r = read(fd, p + n, *length - n)) > 0)
+            n += r;
+        *length = n;
+        *base = p;
+# endif
+    }
+    close(fd); /* the mapping stays valid */
+    return 0;
+#endif
+}
+
 /* filetype objects use a slightly different interpretation
    of the access field.
    It uses two flags rather than a 2-bit number.
@@ -405,8 +899,8 @@ xpost_memoryfile_open_write(void)
     FILE *fp = fopen(...);
     Xpost_Object f = readonly(xpost_file_cons(fp)).
  */
-Xpost_Object xpost_file_cons(Xpost_Memory_File *mem,
-                             /*@NULL@*/ const FILE *fp)
+XPCHECKAPI Xpost_Object xpost_file_cons(Xpost_Memory_File *mem,
+                                        /*@NULL@*/ const FILE *fp)
 {
     Xpost_Object f;
     unsigned int ent;
@@ -484,6 +978,77 @@ Xpost_Object xpost_file_cons_writebuffer(Xpost_Memory_File *mem)
     return f;
 }
 
+/* construct a read-only file object over caller memory.
+   the memory must stay valid while the file is open. */
+XPCHECKAPI Xpost_Object xpost_file_cons_mapped(Xpost_Memory_File *mem,
+                                               const unsigned char *base,
+                                               size_t length)
+{
+    Xpost_Object f;
+    unsigned int ent;
+    int ret;
+    Xpost_File *mf;
+
+    f.tag = filetype;
+    mf = xpost_mappedfile_open(base, length, 0);
+    if (!mf)
+    {
+        XPOST_LOG_ERR("cannot allocate mapped file");
+        return invalid;
+    }
+    if (!xpost_memory_table_alloc(mem, sizeof mf, filetype, &ent))
+    {
+        XPOST_LOG_ERR("cannot allocate file record");
+        free(mf);
+        return invalid;
+    }
+    f.mark_.padw = ent;
+    ret = xpost_memory_put(mem, f.mark_.padw, 0, sizeof mf, &mf);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot save file pointer in VM");
+        free(mf);
+        return invalid;
+    }
+    f.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_MASK;
+    f.tag |= (XPOST_OBJECT_TAG_ACCESS_FILE_READ << XPOST_OBJECT_TAG_DATA_FLAG_ACCESS_OFFSET);
+    return f;
+}
+
+/* map a regular file and construct a readable file object for it.
+   the mapping is released by closefile. */
+XPCHECKAPI int xpost_file_open_mapped(Xpost_Memory_File *mem,
+                                      const char *fn,
+                                      Xpost_Object *retval)
+{
+    Xpost_Object f;
+    const unsigned char *base;
+    size_t length;
+    Xpost_MappedFile *mf;
+    int ret;
+
+    ret = mapfile(fn, &base, &length);
+    if (ret)
+        return ret;
+
+    f = xpost_file_cons_mapped(mem, base, length);
+    if (xpost_object_get_type(f) == invalidtype)
+    {
+        Xpost_MappedFile tmp;
+        tmp.base = base;
+        tmp.length = length;
+        tmp.is_mapped = 1;
+        mapped_unmap(&tmp);
+        return VMerror;
+    }
+    mf = (Xpost_MappedFile *)xpost_file_get_file_pointer(mem, f);
+    mf->is_mapped = 1;
+
+    f.tag |= XPOST_OBJECT_TAG_DATA_FLAG_LIT;
+    *retval = f;
+    return 0;
+}
+
 /* pinch-off a tmpfile containing one line from file. */
 /*@null@*/
 static
@@ -732,8 +1297,8 @@ int xpost_file_open(Xpost_Memory_File *mem,
 /* adapter:
            FILE* <- filetype object
    yield the FILE* from a filetype object */
-Xpost_File *xpost_file_get_file_pointer(Xpost_Memory_File *mem,
-                                        Xpost_Object f)
+XPCHECKAPI Xpost_File *xpost_file_get_file_pointer(Xpost_Memory_File *mem,
+                                                   Xpost_Object f)
 {
     Xpost_File *fp;
     int ret;
@@ -753,42 +1318,31 @@ int xpost_file_get_status(Xpost_Memory_File *mem,
     return xpost_file_get_file_pointer(mem, f) != NULL;
 }
 
-//FIXME assumes DiskFile subtype
-/* call fstat. */
-int xpost_file_get_bytes_available(Xpost_Memory_File *mem,
-                                   Xpost_Object f,
-                                   int *retval)
+/* ask the file for the bytes left to read. */
+XPCHECKAPI int xpost_file_get_bytes_available(Xpost_Memory_File *mem,
+                                              Xpost_Object f,
+                                              int *retval)
 {
-    int ret;
-    FILE *fp;
-    struct stat sb;
-    long sz, pos;
+    Xpost_File *file;
+    long n;
 
-    fp = ((Xpost_DiskFile*)xpost_file_get_file_pointer(mem, f))->file;
-    if (!fp) return ioerror;
-    ret = fstat(fileno(fp), &sb);
-    if (ret != 0)
-    {
-        XPOST_LOG_ERR("fstat did not return 0");
+    file = xpost_file_get_file_pointer(mem, f);
+    if (!file) return ioerror;
+    n = xpost_file_bytesavailable(file);
+    if (n < 0)
         return ioerror;
-    }
-    if (sb.st_size > LONG_MAX)
-        return rangecheck;
-    sz = (long)sb.st_size;
-
-    pos = ftell(fp);
-    if ((sz - pos) > INT_MAX)
+    if (n > INT_MAX)
         return rangecheck;
 
-    *retval = (int)(sz - pos);
+    *retval = (int)n;
 
     return 0;
 }
 
 /* close the file,
    NULL the FILE*. */
-int xpost_file_object_close(Xpost_Memory_File *mem,
-                            Xpost_Object f)
+XPCHECKAPI int xpost_file_object_close(Xpost_Memory_File *mem,
+                                       Xpost_Object f)
 {
     Xpost_File *fp;
     int ret;
@@ -814,32 +1368,37 @@ int xpost_file_object_close(Xpost_Memory_File *mem,
 
 // returned value is count of complete size-sized chunks read.
 // function may have read up to size-1 additional bytes.
+/* copy what the read window holds, then read the rest
+   through the block method. */
 int xpost_file_read(char *buf, int size, int count, Xpost_File *fp)
 {
-    int c, i, j, k = 0;
+    size_t want;
+    size_t n;
 
-    for (i = 0; i < count; ++i)
+    if (size <= 0 || count <= 0)
+        return 0;
+    want = (size_t)size * count;
+
+    n = fp->read_limit - fp->read_next;
+    if (n > want)
+        n = want;
+    if (n)
     {
-        for (j = 0; j < size; ++j)
-	{
-            c = xpost_file_getc(fp);
-	    if (c == EOF) return i;
-            buf[k++] = c;
-	}
+        memcpy(buf, fp->read_next, n);
+        fp->read_next += n;
     }
+    if (n < want)
+        n += fp->methods->read(fp, (unsigned char *)buf + n, want - n);
 
-    return i;
+    return n / size;
 }
 
 int xpost_file_write(const char *buf, int size, int count, Xpost_File *fp)
 {
-    int i, j, k = 0;
-
-    for (i = 0; i < count; ++i)
-        for (j = 0; j < size; ++j)
-            if (xpost_file_putc(fp, buf[k++]) == EOF) return i;
+    if (size <= 0 || count <= 0)
+        return 0;
 
-    return i;
+    return fp->methods->write(fp, (const unsigned char *)buf, (size_t)size * count) / size;
 }
 
 /* if the file is valid,
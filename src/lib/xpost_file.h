@@ -71,17 +71,56 @@ typedef struct Xpost_File_Methods
     int (*unreadch)(Xpost_File*, int);
     long (*tell)(Xpost_File*);
     int (*seek)(Xpost_File*, long);
+    size_t (*read)(Xpost_File*, unsigned char*, size_t);
+    size_t (*write)(Xpost_File*, const unsigned char*, size_t);
+    long (*bytesavailable)(Xpost_File*);
 } Xpost_File_Methods;
 
+/*
+   read_next/read_limit describe a window of already-buffered
+   input bytes. While the window is non-empty, xpost_file_getc
+   and xpost_file_ungetc are served inline without calling
+   through the vtable. Implementations which do not buffer
+   leave the window empty (both NULL).
+
+   Like readch, the block method read is only called once the
+   window is empty. read and write move as many bytes as they can
+   and return the count, which is short only at end of file or
+   on error.
+
+   bytesavailable returns the number of bytes left to read,
+   or -1 if it cannot be determined.
+   */
 struct Xpost_File
 {
     Xpost_File_Methods *methods;
+    unsigned char *read_base;
+    unsigned char *read_next;
+    unsigned char *read_limit;
 };
 
+/*
+   DiskFiles reading from an interactive device (tty) are
+   unbuffered and poll the descriptor for every byte.
+   All other DiskFiles read in blocks of
+   XPOST_DISKFILE_BUFFER_SIZE bytes into buf,
+   regular files with fread, pipes and sockets with read.
+   */
+typedef enum
+{
+    XPOST_DISKFILE_INTERACTIVE,
+    XPOST_DISKFILE_REGULAR,
+    XPOST_DISKFILE_STREAM
+} Xpost_DiskFile_Kind;
+
+#define XPOST_DISKFILE_BUFFER_SIZE 65536
+
 typedef struct Xpost_DiskFile
 {
     Xpost_File methods;
     FILE *file;
+    Xpost_DiskFile_Kind kind;
+    unsigned char *buf;
 } Xpost_DiskFile;
 
 typedef struct Xpost_MemoryFile
@@ -89,13 +128,27 @@ typedef struct Xpost_MemoryFile
     Xpost_File methods;
     unsigned char *contents;
     int is_malloc;
-    int is_read;
-    size_t read_next;
-    size_t read_limit;
+    int is_read; /* reads use the read window over contents */
     size_t write_next;
     size_t write_capacity;
 } Xpost_MemoryFile;
 
+/*
+   MappedFiles are read-only views of a contiguous byte range,
+   either a file mapped into memory by xpost_file_open_mapped
+   or memory owned by the caller (eg. a DSC mapping or the
+   program string given to xpost_run). The whole range is
+   exposed as the read window, so reading never calls through
+   the vtable until end of file.
+   */
+typedef struct Xpost_MappedFile
+{
+    Xpost_File methods;
+    const unsigned char *base;
+    size_t length;
+    int is_mapped; /* base was mapped by us, unmap on close */
+} Xpost_MappedFile;
+
 /* interface fgetc
    in preparation for more elaborate cross-platform non-blocking mechanisms
 cf. http://stackoverflow.com/questions/20428616/how-to-handle-window-events-while-waiting-for-terminal-input
@@ -107,6 +160,8 @@ and http://stackoverflow.com/questions/25506324/how-to-do-pollstdin-or-selectstd
 static inline
 int xpost_file_getc(Xpost_File *in)
 {
+    if (in->read_next < in->read_limit)
+        return *in->read_next++;
     return in->methods->readch(in);
 }
 
@@ -137,6 +192,11 @@ void xpost_file_purge(Xpost_File *f)
 static inline
 int xpost_file_ungetc(Xpost_File *in, int c)
 {
+    if (in->read_next > in->read_base && in->read_next[-1] == c)
+    {
+        --in->read_next;
+        return c;
+    }
     return in->methods->unreadch(in, c);
 }
 
@@ -152,17 +212,33 @@ int xpost_file_seek(Xpost_File *f, long offset)
     return f->methods->seek(f, offset);
 }
 
+static inline
+long xpost_file_bytesavailable(Xpost_File *f)
+{
+    return f->methods->bytesavailable(f);
+}
+
 
 /**
  * @brief Construct a file object given a FILE*.
  */
-Xpost_Object xpost_file_cons(Xpost_Memory_File *mem, /*@NULL@*/ const FILE *fp);
+XPCHECKAPI Xpost_Object xpost_file_cons(Xpost_Memory_File *mem, /*@NULL@*/ const FILE *fp);
 
 /**
  * @brief Construct a file object wrapping a pointer and size.
  */
 Xpost_Object xpost_file_cons_readbuffer(Xpost_Memory_File *mem, unsigned char *str, size_t limit);
 
+/**
+ * @brief Construct a read-only file object over memory owned by the caller.
+ */
+XPCHECKAPI Xpost_Object xpost_file_cons_mapped(Xpost_Memory_File *mem, const unsigned char *base, size_t length);
+
+/**
+ * @brief Map a file into memory and construct a read-only file object.
+ */
+XPCHECKAPI int xpost_file_open_mapped(Xpost_Memory_File *mem, const char *fn, Xpost_Object *retval);
+
 /**
  * @brief Construct a file object for accumulating output.
  */
@@ -176,7 +252,7 @@ int xpost_file_open(Xpost_Memory_File *mem, char *fn, char *mode, Xpost_Object *
 /**
  * @brief Return the FILE* from the file object.
  */
-Xpost_File *xpost_file_get_file_pointer(Xpost_Memory_File *mem, Xpost_Object f);
+XPCHECKAPI Xpost_File *xpost_file_get_file_pointer(Xpost_Memory_File *mem, Xpost_Object f);
 
 /**
  * @brief Get the status of the file object.
@@ -186,14 +262,21 @@ int xpost_file_get_status(Xpost_Memory_File *mem, Xpost_Object f);
 /**
  * @brief Return number of bytes available to read.
  */
-int xpost_file_get_bytes_available(Xpost_Memory_File *mem, Xpost_Object f, int *retval);
+XPCHECKAPI int xpost_file_get_bytes_available(Xpost_Memory_File *mem, Xpost_Object f, int *retval);
 
 /**
  * @brief Close the file and deallocate the descriptor in VM.
  */
-int xpost_file_object_close(Xpost_Memory_File *mem, Xpost_Object f);
+XPCHECKAPI int xpost_file_object_close(Xpost_Memory_File *mem, Xpost_Object f);
 
+/**
+ * @brief Read count items of size bytes, return the number of whole items read.
+ */
 int xpost_file_read(char *buf, int size, int count, Xpost_File *fp);
+
+/**
+ * @brief Write count items of size bytes, return the number of whole items written.
+ */
 int xpost_file_write(const char *buf, int size, int count, Xpost_File *fp);
 
 /**
@@ -34,7 +34,9 @@
 #endif
 
 #include <assert.h>
+#include <limits.h> /* INT_MAX */
 #include <stdio.h>
+#include <stdlib.h> /* malloc qsort */
 #include <string.h>
 
 #include "xpost.h"
@@ -43,21 +45,56 @@
 #include "xpost_object.h" /* Xpost_Object */
 #include "xpost_free.h"
 
+/* the list heads and statistics in the allocation of ent 0.
+   invalidated, like any VM pointer, when the memory file grows. */
+static
+Xpost_Free_Lists *_xpost_free_lists(Xpost_Memory_File *mem)
+{
+    return (Xpost_Free_Lists *)(mem->base +
+                                mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_FREE].adr);
+}
+
+/* the list an ent of size sz is filed on.
+   bin b < XPOST_FREE_SMALL_BINS holds sizes in [b*GRAIN, (b+1)*GRAIN),
+   large bin c holds sizes in [2^c, 2^(c+1)) times the small limit. */
+static
+unsigned int _xpost_free_bin(unsigned int sz)
+{
+    unsigned int c;
+
+    if (sz < XPOST_FREE_GRAIN * XPOST_FREE_SMALL_BINS)
+        return sz / XPOST_FREE_GRAIN;
+    for (c = 0;
+         c + 1 < XPOST_FREE_LARGE_BINS &&
+             (sz / (XPOST_FREE_GRAIN * XPOST_FREE_SMALL_BINS)) >> (c + 1);
+         c++)
+        ;
+    return XPOST_FREE_SMALL_BINS + c;
+}
+
+/* the smallest size filed on a list */
+static
+unsigned int _xpost_free_bin_size(unsigned int bin)
+{
+    if (bin < XPOST_FREE_SMALL_BINS)
+        return bin * XPOST_FREE_GRAIN;
+    return (XPOST_FREE_GRAIN * XPOST_FREE_SMALL_BINS) << (bin - XPOST_FREE_SMALL_BINS);
+}
+
 /*
-   initialize the free-list in the memory file.
-   free list head is in slot zero
+   initialize the free lists in the memory file.
+   the list heads are in slot zero
    sz is 0 so gc will ignore it */
-int xpost_free_init(Xpost_Memory_File *mem)
+XPCHECKAPI int xpost_free_init(Xpost_Memory_File *mem)
 {
     unsigned int ent;
-    unsigned int val = 0;
     int ret;
 
-    /* allocate the free list head: 4 bytes in ent 0
-       allocate additional 1k "scratch" space to protect
+    /* allocate the list heads in ent 0
+       allocate additional "scratch" space, to 2k, to protect
        interpreter data from NULL writes
      */
-    ret = xpost_memory_table_alloc(mem, 1024, 0, &ent);
+    ret = xpost_memory_table_alloc(mem, 2048, 0, &ent);
     if (!ret)
     {
         return 0;
@@ -65,14 +102,10 @@ int xpost_free_init(Xpost_Memory_File *mem)
 
     /* make sure this is the correct ent */
     assert (ent == XPOST_MEMORY_TABLE_SPECIAL_FREE);
+    assert (sizeof(Xpost_Free_Lists) <= 2048);
 
-    /* set to zero (== NULL == link-back-to-head) */
-    ret = xpost_memory_put(mem, ent, 0, sizeof(unsigned int), &val);
-    if (!ret)
-    {
-        XPOST_LOG_ERR("xpost_free_init cannot access list head");
-        return 0;
-    }
+    /* set to zero (== NULL == empty list) */
+    memset(_xpost_free_lists(mem), 0, sizeof(Xpost_Free_Lists));
 
     /* set zero size to enable guards against NULL writes */
     {
@@ -82,21 +115,75 @@ int xpost_free_init(Xpost_Memory_File *mem)
 
     /* make free list available for general memory allocations */
     (void) xpost_memory_register_free_list_alloc_function(mem, xpost_free_alloc);
-    mem->period = XPOST_GARBAGE_COLLECTION_PERIOD;
-    mem->threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    mem->vmthreshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    mem->threshold = mem->vmthreshold;
+    mem->autocollect = 1;
+    mem->minor = 0;
+    mem->compact = 0;
 
     return 1;
 }
 
+/* set the least number of bytes to allocate between automatic collections,
+   and start counting them anew */
+void xpost_free_set_threshold(Xpost_Memory_File *mem,
+                              int threshold)
+{
+    mem->vmthreshold = threshold;
+    mem->threshold = threshold;
+}
+
+unsigned int xpost_free_schedule(Xpost_Memory_File *mem)
+{
+    unsigned int live = mem->used - xpost_free_get_size(mem);
+    unsigned int next = live / 100 * XPOST_GARBAGE_COLLECTION_OVERHEAD;
+
+    if (next > INT_MAX)
+        next = INT_MAX;
+    if ((int)next < mem->vmthreshold)
+        next = mem->vmthreshold;
+    mem->threshold = next;
+    return live;
+}
+
+/* empty all lists. statistics of re-use are kept. */
+void xpost_free_discard(Xpost_Memory_File *mem)
+{
+    Xpost_Free_Lists *fl = _xpost_free_lists(mem);
+
+    memset(fl->head, 0, sizeof fl->head);
+    memset(fl->count, 0, sizeof fl->count);
+    memset(fl->bytes, 0, sizeof fl->bytes);
+}
+
+/* keep an ent whose storage is gone, to be given new storage
+   by _xpost_free_spare(). spares are chained through adr. */
+static
+void _xpost_free_spare_ent(Xpost_Memory_File *mem,
+                           unsigned int ent)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    Xpost_Free_Lists *fl = _xpost_free_lists(mem);
+
+    tab->tab[ent].adr = fl->spare;
+    tab->tab[ent].sz = 0;
+    tab->tab[ent].used = 0;
+    tab->tab[ent].mark = 0;
+    tab->tab[ent].tag = 0;
+    fl->spare = ent;
+}
+
 /* free this ent! returns reclaimed size or -1 on error */
-int xpost_free_memory_ent(Xpost_Memory_File *mem,
+XPCHECKAPI int xpost_free_memory_ent(Xpost_Memory_File *mem,
                           unsigned int ent)
 {
     Xpost_Memory_Table *tab;
+    Xpost_Free_Lists *fl;
     unsigned int rent = ent; /* relative ent index */
     unsigned int z; /* free list pointer */
     unsigned int a; /* adr associated with ent */
     unsigned int sz; /* sz associated with adr */
+    unsigned int b; /* list for sz */
     int ret;
     /* return; */
 
@@ -145,47 +232,52 @@ int xpost_free_memory_ent(Xpost_Memory_File *mem,
         }
     }
     tab->tab[rent].tag = 0;
-
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
-    if (!ret)
+    /* a reused ent starts young, at no save level */
+    tab->tab[rent].mark &= ~(XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK
+                             | XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK
+                             | XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK
+                             | XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK);
+
+    /* storage at the end of the memory file goes back to it */
+    if (a + sz == mem->used)
     {
-        XPOST_LOG_ERR("unable to load free list head");
-        return -1;
+        mem->used = a;
+        _xpost_free_spare_ent(mem, ent);
+        return sz;
     }
-    /* printf("freeing %d bytes\n", xpost_memory_table_get_size(mem, ent)); */
 
-    //while current node < size of ent being added
-        //load next ent in list
-    while (1)
+    fl = _xpost_free_lists(mem);
+    b = _xpost_free_bin(sz);
+    ++fl->count[b];
+    fl->bytes[b] += sz;
+    /* printf("freeing %d bytes\n", sz); */
+
+    z = tab->tab[XPOST_MEMORY_TABLE_SPECIAL_FREE].adr
+        + b * sizeof(unsigned int);
+
+    /* small bins are unordered: push on the front.
+       large lists are sorted:
+       while current node < size of ent being added
+           load next ent in list
+       (an ent goes before others of its size,
+       so freeing many of one size does not walk them all) */
+    if (b >= XPOST_FREE_SMALL_BINS)
     {
-        unsigned int t;
-        unsigned int ta;
-        unsigned int tsz;
-
-        /* get the next ent from z node */
-        memcpy(&t, mem->base + z, sizeof(unsigned int));
+        while (1)
+        {
+            unsigned int t;
 
-        if (t == 0) /* end of the list */
-            break;
+            /* get the next ent from z node */
+            memcpy(&t, mem->base + z, sizeof(unsigned int));
 
-        ret = xpost_memory_table_get_size(mem, t, &tsz);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot get size from ent on free list");
-            return -1;
-        }
+            if (t == 0) /* end of the list */
+                break;
 
-        if (tsz > sz) /* this is the place */
-            break;
+            if (tab->tab[t].sz >= sz) /* this is the place */
+                break;
 
-        ret = xpost_memory_table_get_addr(mem, t, &ta);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot get addr from ent on free list");
-            return -1;
+            z = tab->tab[t].adr;
         }
-
-        z = ta;
     }
 
     /* copy the current free-list node to the data area of the ent. */
@@ -197,43 +289,128 @@ int xpost_free_memory_ent(Xpost_Memory_File *mem,
     return sz;
 }
 
-/* print a dump of the free list */
+/* print a dump of the free lists */
 void xpost_free_dump(Xpost_Memory_File *mem)
 {
+    unsigned int b;
     unsigned int e;
-    unsigned int z;
-    int ret;
-
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z);
-    if (!ret)
-    {
-        return;
-    }
+    Xpost_Free_Lists *fl = _xpost_free_lists(mem);
 
     printf("freelist: ");
-    memcpy(&e, mem->base + z, sizeof(unsigned int));
-    while (e)
+    for (b = 0; b < XPOST_FREE_BINS; b++)
     {
-        unsigned int sz;
-        ret = xpost_memory_table_get_size(mem, e, &sz);
-        if (!ret)
+        if (!fl->head[b])
+            continue;
+        printf("[%u] ", _xpost_free_bin_size(b));
+        e = fl->head[b];
+        while (e)
         {
-            return;
+            if (e >= mem->table.nextent)
+                return;
+            printf("%u(%u) ", e, mem->table.tab[e].sz);
+            memcpy(&e, mem->base + mem->table.tab[e].adr, sizeof(unsigned int));
         }
-        printf("%u(%u) ", e, sz);
-        ret = xpost_memory_table_get_addr(mem, e, &z);
-        if (!ret)
-        {
-            return;
-        }
-        memcpy(&e, mem->base + z, sizeof(unsigned int));
     }
 }
 
-/* scan the free list for a suitably-sized bit of memory,
+XPCHECKAPI unsigned int xpost_free_get_size(Xpost_Memory_File *mem)
+{
+    Xpost_Free_Lists *fl = _xpost_free_lists(mem);
+    unsigned int sz = 0;
+    int b;
+
+    for (b = 0; b < XPOST_FREE_BINS; b++)
+        sz += fl->bytes[b];
+    return sz;
+}
+
+int xpost_free_get_bin_stats(Xpost_Memory_File *mem,
+                             int bin,
+                             unsigned int *size,
+                             unsigned int *count,
+                             unsigned int *bytes,
+                             unsigned int *reused)
+{
+    Xpost_Free_Lists *fl = _xpost_free_lists(mem);
+
+    if (bin < 0 || bin >= XPOST_FREE_BINS)
+        return 0;
+    *size = _xpost_free_bin_size(bin);
+    *count = fl->count[bin];
+    *bytes = fl->bytes[bin];
+    *reused = fl->reused[bin];
+    return 1;
+}
+
+/* unlink ent e, found at link z of list b, and hand it out */
+static
+int _xpost_free_take(Xpost_Memory_File *mem,
+                     unsigned int b,
+                     unsigned int z,
+                     unsigned int e,
+                     unsigned int sz,
+                     unsigned int tag,
+                     unsigned int *entity)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    Xpost_Free_Lists *fl;
+
+    memcpy(mem->base + z, mem->base + tab->tab[e].adr, sizeof(unsigned int));
+    fl = _xpost_free_lists(mem);
+    --fl->count[b];
+    fl->bytes[b] -= tab->tab[e].sz;
+    ++fl->reused[b];
+    tab->tab[e].tag = tag;
+    tab->tab[e].used = sz;
+    *entity = e;
+    return 1; /* found, return SUCCESS */
+}
+
+/* nothing on the lists fits. if a spare ent is waiting,
+   give it new storage from the end of the memory file.
+   return 0 to fall back to the _new allocator. */
+static
+int _xpost_free_spare(Xpost_Memory_File *mem,
+                      unsigned int sz,
+                      unsigned int tag,
+                      unsigned int *entity)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int e;
+    unsigned int adr;
+
+    e = _xpost_free_lists(mem)->spare;
+    if (e == 0 || e >= tab->nextent)
+        return 0;
+    if (!xpost_memory_file_alloc(mem, sz, &adr))
+        return 0;
+    _xpost_free_lists(mem)->spare = tab->tab[e].adr; /* recalc */
+    tab->tab[e].adr = adr;
+    tab->tab[e].sz = sz;
+    tab->tab[e].used = sz;
+    tab->tab[e].mark = 0;
+    tab->tab[e].tag = tag;
+    *entity = e;
+    return 1;
+}
+
+/* a bad element was found: discard the free lists */
+static
+int _xpost_free_bad_ent(Xpost_Memory_File *mem,
+                        unsigned int e)
+{
+    XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
+            e, XPOST_OBJECT_COMP_MAX_ENT);
+    xpost_free_discard(mem);
+    return 2; /* request collection to fill the lists */
+}
+
+/* take a suitably-sized bit of memory from the free lists:
+   the first ent of the smallest non-empty small bin that fits,
+   or the best fit among the larger ents.
 
-   if the allocator falls back to fresh memory XPOST_GARBAGE_COLLECTION_PERIOD times,
-        it triggers a collection.
+   once the bytes allowed since the last collection are allocated,
+        it triggers a collection, which schedules the next.
     Returns 1 on success, 0 on failure, 2 to request garbage collection and re-call.
  */
 int xpost_free_alloc(Xpost_Memory_File *mem,
@@ -241,102 +418,101 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
                      unsigned int tag,
                      unsigned int *entity)
 {
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int lists;
     unsigned int z;
     unsigned int e;                     /* working pointer */
-    //static int period = XPOST_GARBAGE_COLLECTION_PERIOD;
-    //static int threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
-    int ret;
+    unsigned int b;
 
-    if (!mem->interpreter_get_initializing())
+    if (mem->autocollect && !mem->interpreter_get_initializing())
     {
-#ifdef XPOST_USE_THRESHOLD
-        //(void)period;
         if ((mem->threshold -= sz) <= 0)
         {
-            mem->threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+            /* in case no collection follows to schedule the next */
+            mem->threshold = mem->vmthreshold;
             return 2;
         }
-#else
-        //(void)threshold;
-        if (--mem->period == 0) /* check garbage-collection control */
-        {
-            mem->period = XPOST_GARBAGE_COLLECTION_PERIOD;
-            return 2; /* not found, request garbage-collection and try-again */
-            /* collect(mem, 1, 0); */
-            /* goto try_again; */
-        }
-#endif
     }
 
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z); /* free pointer */
-    if (!ret)
+    if (sz == 0) /* zero-sized ents are never put on the lists */
     {
-        XPOST_LOG_ERR("unable to load free list head");
-        return 0;
+        /* but a spare will do, once the special ents are laid out */
+        if (!mem->interpreter_get_initializing ||
+            mem->interpreter_get_initializing())
+            return 0;
+        return _xpost_free_spare(mem, 0, tag, entity);
     }
 
-    memcpy(&e, mem->base+z, sizeof(unsigned int)); /* e = *z */
-    while (e) /* e is not zero */
+    lists = tab->tab[XPOST_MEMORY_TABLE_SPECIAL_FREE].adr;
+
+    /* sizes in the bin of sz may be smaller than sz,
+       but allocations of the same kind usually have the same size,
+       so the first one is worth a look */
+    b = sz / XPOST_FREE_GRAIN;
+    if (b < XPOST_FREE_SMALL_BINS && sz % XPOST_FREE_GRAIN)
     {
-        unsigned int tsz;
-        if (e > XPOST_OBJECT_COMP_MAX_ENT)
+        z = lists + b * sizeof(unsigned int);
+        memcpy(&e, mem->base + z, sizeof(unsigned int));
+        if (e)
         {
-            unsigned int zero = 0;
-            XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
-                    e, XPOST_OBJECT_COMP_MAX_ENT);
-            /* bad element found: discard free list */
-            xpost_memory_put(mem, 0, 0, sizeof zero, &zero);
-            return 2; /* request collection to fill the list */
+            if (e >= tab->nextent || e > XPOST_OBJECT_COMP_MAX_ENT)
+                return _xpost_free_bad_ent(mem, e);
+            if (tab->tab[e].sz >= sz)
+                return _xpost_free_take(mem, b, z, e, sz, tag, entity);
         }
-        ret = xpost_memory_table_get_size(mem, e, &tsz);
-        if (!ret)
+    }
+
+    /* any ent in a small bin at or above the size rounded up fits,
+       if it does not waste more than the accepted oversize */
+    for (b = (sz + XPOST_FREE_GRAIN - 1) / XPOST_FREE_GRAIN;
+         b < XPOST_FREE_SMALL_BINS &&
+             b * XPOST_FREE_GRAIN * XPOST_FREE_ACCEPT_DENOM <= sz * XPOST_FREE_ACCEPT_OVERSIZE;
+         b++)
+    {
+        z = lists + b * sizeof(unsigned int);
+        memcpy(&e, mem->base + z, sizeof(unsigned int));
+        if (e)
         {
-            XPOST_LOG_ERR("cannot retrieve size of ent %u", e);
-            return 0;
+            if (e >= tab->nextent || e > XPOST_OBJECT_COMP_MAX_ENT)
+                return _xpost_free_bad_ent(mem, e);
+            return _xpost_free_take(mem, b, z, e, sz, tag, entity);
         }
-
-        /* if this ent is sufficient to hold sz,
-           but does not waste more than sz bytes, use it */
-        if (tsz >= sz)
+    }
+    if (b < XPOST_FREE_SMALL_BINS)
+        return _xpost_free_spare(mem, sz, tag, entity);
+
+    /* the large lists are sorted, so the first ent that fits,
+       in the first list holding one, is the best fit */
+    b = _xpost_free_bin(sz);
+    if (b < XPOST_FREE_SMALL_BINS)
+        b = XPOST_FREE_SMALL_BINS;
+    for ( ; b < XPOST_FREE_BINS; b++)
+    {
+        z = lists + b * sizeof(unsigned int);
+        memcpy(&e, mem->base + z, sizeof(unsigned int)); /* e = *z */
+        while (e) /* e is not zero */
         {
-            Xpost_Memory_Table *tab = &mem->table;
-            unsigned int ent;
-            unsigned int ad;
+            unsigned int tsz;
 
-            /* if this ent is too big */
-            if (tsz * XPOST_FREE_ACCEPT_DENOM > sz * XPOST_FREE_ACCEPT_OVERSIZE)
-            {
-                return 0; /* early exit to _new allocator since free list is sorted */
-            }
-
-            ret = xpost_memory_table_get_addr(mem, e, &ad);
-            if (!ret)
-            {
-                XPOST_LOG_ERR("cannot retrieve address of ent %u", e);
-                return 0;
-            }
-            memcpy(mem->base + z, mem->base + ad, sizeof(unsigned int));
-            ent = e;
-            if (ent >= mem->table.nextent)
+            if (e >= tab->nextent || e > XPOST_OBJECT_COMP_MAX_ENT)
+                return _xpost_free_bad_ent(mem, e);
+            tsz = tab->tab[e].sz;
+            if (tsz >= sz)
             {
-                XPOST_LOG_ERR("cannot find table for ent %u", e);
-                return 0;
+                /* if this ent is too big, so is every other */
+                if (tsz * XPOST_FREE_ACCEPT_DENOM > sz * XPOST_FREE_ACCEPT_OVERSIZE)
+                {
+                    return _xpost_free_spare(mem, sz, tag, entity);
+                }
+                return _xpost_free_take(mem, b, z, e, sz, tag, entity);
             }
-            tab->tab[ent].tag = tag;
-            *entity = e;
-            return 1; /* found, return SUCCESS */
-        }
-        ret = xpost_memory_table_get_addr(mem, e, &z);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot retrieve address for ent %u", e);
-            return 0;
+            z = tab->tab[e].adr;
+            memcpy(&e, mem->base + z, sizeof(unsigned int));
         }
-        memcpy(&e, mem->base + z, sizeof(unsigned int));
     }
-    /* finished scanning free list */
+    /* finished scanning free lists */
 
-    return 0; /* not found, fall-back to _new allocator */
+    return _xpost_free_spare(mem, sz, tag, entity);
 }
 
 /*
@@ -402,3 +578,158 @@ unsigned int xpost_free_realloc(Xpost_Memory_File *mem,
 
     return newadr;
 }
+
+/* an ent's storage, for sorting by address */
+typedef struct
+{
+    unsigned int adr;
+    unsigned int ent;
+} Xpost_Free_Region;
+
+static
+int _xpost_free_region_cmp(const void *a,
+                           const void *b)
+{
+    const Xpost_Free_Region *ra = a;
+    const Xpost_Free_Region *rb = b;
+
+    return (ra->adr > rb->adr) - (ra->adr < rb->adr);
+}
+
+int xpost_free_release(Xpost_Memory_File *mem,
+                       const unsigned int *ents,
+                       unsigned int n)
+{
+    Xpost_Free_Region *r;
+    unsigned int sz = 0;
+    unsigned int i;
+    int ret;
+
+    if (n == 0)
+        return 0;
+    r = malloc(n * sizeof *r);
+    if (!r)
+    {
+        XPOST_LOG_ERR("cannot allocate release table");
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        r[i].adr = mem->table.tab[ents[i]].adr;
+        r[i].ent = ents[i];
+    }
+    qsort(r, n, sizeof *r, _xpost_free_region_cmp);
+
+    /* highest first: each ent at the end of the file uncovers the next */
+    for (i = n; i-- > 0; )
+    {
+        ret = xpost_free_memory_ent(mem, r[i].ent);
+        if (ret < 0)
+        {
+            free(r);
+            return -1;
+        }
+        sz += (unsigned int)ret;
+    }
+    free(r);
+    return (int)sz;
+}
+
+XPCHECKAPI unsigned int xpost_free_compact(Xpost_Memory_File *mem)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    Xpost_Free_Lists *fl;
+    Xpost_Free_Region *r;
+    unsigned char *isfree;
+    unsigned int *f; /* free ents of the current run, then all of them */
+    unsigned int n = 0;
+    unsigned int nf = 0;
+    unsigned int run; /* first free ent of the current run in f */
+    unsigned int cursor;
+    unsigned int end;
+    unsigned int oldused = mem->used;
+    unsigned int i;
+    unsigned int b;
+    unsigned int e;
+
+    r = malloc(tab->nextent * sizeof *r);
+    f = malloc(tab->nextent * sizeof *f);
+    isfree = calloc(tab->nextent, 1);
+    if (!r || !f || !isfree)
+    {
+        XPOST_LOG_ERR("cannot allocate compaction tables");
+        free(r);
+        free(f);
+        free(isfree);
+        return 0;
+    }
+
+    /* find the free ents, then forget the lists:
+       the links are in the storage about to be moved */
+    fl = _xpost_free_lists(mem);
+    for (b = 0; b < XPOST_FREE_BINS; b++)
+        for (e = fl->head[b]; e && e < tab->nextent; )
+        {
+            isfree[e] = 1;
+            memcpy(&e, mem->base + tab->tab[e].adr, sizeof(unsigned int));
+        }
+    xpost_free_discard(mem);
+
+    for (i = mem->start; i < tab->nextent; i++)
+        if (tab->tab[i].sz != 0)
+        {
+            r[n].adr = tab->tab[i].adr;
+            r[n].ent = i;
+            ++n;
+        }
+    qsort(r, n, sizeof *r, _xpost_free_region_cmp);
+
+    cursor = end = n ? r[0].adr : 0;
+    run = 0;
+    for (i = 0; i <= n; i++)
+    {
+        if (i == n || r[i].adr != end)
+        {
+            /* the run is over: gather its free ents above its live ones */
+            if (i == n && end == mem->used)
+            {
+                mem->used = cursor;
+                while (nf > run)
+                    _xpost_free_spare_ent(mem, f[--nf]);
+            }
+            for ( ; run < nf; run++)
+            {
+                tab->tab[f[run]].adr = cursor;
+                cursor += tab->tab[f[run]].sz;
+            }
+            if (i == n)
+                break;
+            cursor = end = r[i].adr;
+        }
+        e = r[i].ent;
+        end += tab->tab[e].sz;
+        if (isfree[e])
+        {
+            f[nf++] = e;
+            continue;
+        }
+        if (cursor != r[i].adr)
+        {
+            memmove(mem->base + cursor, mem->base + r[i].adr, tab->tab[e].sz);
+            tab->tab[e].adr = cursor;
+        }
+        cursor += tab->tab[e].sz;
+    }
+
+    /* re-file the free ents at their new addresses */
+    for (i = 0; i < nf; i++)
+        (void) xpost_free_memory_ent(mem, f[i]);
+
+    free(r);
+    free(f);
+    free(isfree);
+
+    if (mem->used < oldused)
+        (void) xpost_memory_file_shrink(mem);
+    return oldused - mem->used;
+}
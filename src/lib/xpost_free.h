@@ -45,15 +45,21 @@
  *  will first call xpost_free_alloc before falling back to increasing the size
  *  of the memory space.
 
- *  The free list is a chain of unused ents and their associated memory.
- *  The free list head is ent 0, which points (via the address field in
- *  the memory table entry for ent 0) to a 32bit int which is either 0
- *  (ie. a "NULL" "pointer", also a link back to the head (!)) or the ent
- *  number of the next free allocation. Any subsequent ents in the chain
- *  will have the next ent or 0 in the first 4 bytes of the allocation.
+ *  The free lists are chains of unused ents and their associated memory.
+ *  The allocation of ent 0 holds an Xpost_Free_Lists: the head of each
+ *  list, which is either 0 (ie. a "NULL" "pointer") or the ent number of
+ *  the first free allocation, and some statistics. Any subsequent ents in
+ *  a chain will have the next ent or 0 in the first 4 bytes of the
+ *  allocation.
+ *
+ *  Small allocations, under XPOST_FREE_GRAIN * XPOST_FREE_SMALL_BINS
+ *  bytes, are segregated by size into bins XPOST_FREE_GRAIN bytes wide,
+ *  so both freeing and re-using them is a push or a pop. Larger ones go
+ *  on one list per power of two, each kept sorted by size, and are
+ *  re-used best-fit.
  *
  *  (All allocations are padded to at least an even word and zero-sized
- *  allocations are ignored, so any ent that can be put on the free list
+ *  allocations are ignored, so any ent that can be put on a free list
  *  is guaranteed to have at least these 4 bytes allocated to it.)
  */
 
@@ -61,10 +67,13 @@
  * @enum  Xpost_Garbage_Params
  * @brief private constants
  *
- * FIXME: PLRM describes garbage collection control to be based on
- * number of bytes allocated, not the number of allocations.
- * Also this should be a variable accessible through `setvmthreshold`
- * and `setsystemparams` operators.
+ * Automatic collection is scheduled by heap growth: after a
+ * collection, the vm may allocate XPOST_GARBAGE_COLLECTION_OVERHEAD
+ * percent of its live size before the next one, but never less than
+ * its threshold. The threshold starts at
+ * XPOST_GARBAGE_COLLECTION_THRESHOLD, and `setvmthreshold` may change
+ * it; it should also be accessible through the `setsystemparams`
+ * operator.
  * PLRM, appendix C describes this variable, which is expected in the
  * dictionary argument of `setsystemparams`, and returned by
  * `currentsystemparams`:
@@ -74,29 +83,110 @@
  */
 typedef enum
 {
-    XPOST_GARBAGE_COLLECTION_PERIOD = 20000,  /**< number of times to grow before collecting */
-    XPOST_GARBAGE_COLLECTION_THRESHOLD = 1000000000  /**< number of bytes to allocate before collecting */
+    XPOST_GARBAGE_COLLECTION_THRESHOLD = 1000000,  /**< least number of bytes to allocate between collections */
+    XPOST_GARBAGE_COLLECTION_OVERHEAD = 100  /**< bytes to allocate before collecting, in percent of the live bytes */
 } Xpost_Garbage_Params;
 
-#define XPOST_USE_THRESHOLD
-
 /**
  * Maximum size to accept from an allocation relative to the size requested
  */
 #define XPOST_FREE_ACCEPT_OVERSIZE 3
 #define XPOST_FREE_ACCEPT_DENOM 2
 
+/**
+ * Width in bytes of each small bin, the size of an object
+ */
+#define XPOST_FREE_GRAIN 16
+
+/**
+ * Number of small bins, and of size-sorted lists for larger allocations
+ */
+#define XPOST_FREE_SMALL_BINS 64
+#define XPOST_FREE_LARGE_BINS 22
+#define XPOST_FREE_BINS (XPOST_FREE_SMALL_BINS + XPOST_FREE_LARGE_BINS)
+
+/**
+ * @struct Xpost_Free_Lists
+ * @brief  list heads and statistics, stored in the allocation of ent 0
+ */
+typedef struct
+{
+    unsigned int head[XPOST_FREE_BINS]; /**< first free ent of each list, or 0 */
+    unsigned int count[XPOST_FREE_BINS]; /**< number of ents on each list */
+    unsigned int bytes[XPOST_FREE_BINS]; /**< total size of the ents on each list */
+    unsigned int reused[XPOST_FREE_BINS]; /**< allocations served by each list */
+    unsigned int spare; /**< first ent left without storage by compaction, or 0 */
+} Xpost_Free_Lists;
+
 /**
  * @brief  initialize the FREE special entity which points
  *         to the head of the free list
  */
-int xpost_free_init(Xpost_Memory_File *mem);
+XPCHECKAPI int xpost_free_init(Xpost_Memory_File *mem);
 
 /**
- * @brief  print a dump of the free list
+ * @brief  print a dump of the free lists
  */
 void xpost_free_dump(Xpost_Memory_File *mem);
 
+/**
+ * @brief  empty the free lists, eg. before a sweep re-fills them
+ */
+void xpost_free_discard(Xpost_Memory_File *mem);
+
+/**
+ * @brief  set the least number of bytes to allocate between automatic
+ *         collections of mem, and restart the count from it
+ */
+void xpost_free_set_threshold(Xpost_Memory_File *mem,
+                              int threshold);
+
+/**
+ * @brief  schedule the next automatic collection of mem, after one
+ *         has just been swept
+ *
+ * The next collection comes after XPOST_GARBAGE_COLLECTION_OVERHEAD
+ * percent of the live size has been allocated, or mem->vmthreshold
+ * bytes, whichever is more. Returns the live size: the used size of
+ * the memory file less the size of the free lists.
+ */
+unsigned int xpost_free_schedule(Xpost_Memory_File *mem);
+
+/**
+ * @brief  slide live ents down over the free space in the memory file
+ *
+ * Ents are visited in address order. Within each run of ents whose
+ * storage is contiguous, live ents move down and the free ents are
+ * gathered above them. Objects refer to storage through the table,
+ * so only tab[ent].adr changes. Raw allocations, and the special ents
+ * below mem->start, are not moved and end a run.
+ *
+ * The free space of a run that ends the memory file is cut off, its
+ * ents become spares to be given storage again by xpost_free_alloc(),
+ * and the memory file shrinks.
+ *
+ * This must only be called where no VM address is held across it.
+ * Returns the number of bytes cut from the end of the memory file.
+ */
+XPCHECKAPI unsigned int xpost_free_compact(Xpost_Memory_File *mem);
+
+/**
+ * @brief  return the total size of the ents on the free lists
+ */
+XPCHECKAPI unsigned int xpost_free_get_size(Xpost_Memory_File *mem);
+
+/**
+ * @brief  return statistics for one list: the smallest size it holds,
+ *         the number and total size of its ents, and the number of
+ *         allocations it has served
+ */
+int xpost_free_get_bin_stats(Xpost_Memory_File *mem,
+                             int bin,
+                             unsigned int *size,
+                             unsigned int *count,
+                             unsigned int *bytes,
+                             unsigned int *reused);
+
 /**
  * @brief  allocate data, re-using garbage if possible
  */
@@ -106,11 +196,26 @@ int xpost_free_alloc(Xpost_Memory_File *mem,
                      unsigned int *entity);
 
 /**
- * @brief  explicitly add ent to free list
+ * @brief  explicitly add ent to the free lists
+ *
+ * Storage at the end of the memory file is given back to the file
+ * instead, and the ent kept as a spare.
  */
-int xpost_free_memory_ent(Xpost_Memory_File *mem,
+XPCHECKAPI int xpost_free_memory_ent(Xpost_Memory_File *mem,
                           unsigned int ent);
 
+/**
+ * @brief  free n ents at once, in descending order of address
+ *
+ * An ent whose storage ends the memory file is not listed: the used
+ * size of the file is cut back over it, and the ent becomes a spare.
+ * Freeing from the top down lets a run of such ents give all of their
+ * storage back. Returns the reclaimed size or -1 on error.
+ */
+int xpost_free_release(Xpost_Memory_File *mem,
+                       const unsigned int *ents,
+                       unsigned int n);
+
 /**
  * @brief reallocate data, preserving original contents
 
@@ -34,12 +34,26 @@
 #endif
 
 #include <assert.h>
+#include <limits.h> /* INT_MAX */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #ifdef HAVE_UNISTD_H
-# include <unistd.h> /* close */
+# include <unistd.h> /* close sysconf */
+#endif
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# include <sched.h> /* sched_yield */
+#endif
+
+#ifdef HAVE_TIME_H
+# include <time.h>
+#endif
+
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
 #endif
 
 #include "xpost.h"
@@ -79,11 +93,98 @@ void _xpost_garbage_unmark(Xpost_Memory_File *mem)
     }
 }
 
-/* set the MARK in the mark in the tab[ent] */
+/* has the ent survived enough collections to be old? */
+static
+int _xpost_garbage_ent_is_old(Xpost_Memory_File *mem,
+                              unsigned int ent)
+{
+    return ((mem->table.tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK)
+            >> XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET)
+        >= XPOST_GARBAGE_PROMOTION_AGE;
+}
+
+/* iterate through all tables,
+    clear the MARK of young ents, set the MARK of old ents.
+   for a minor collection: marking stops at old ents,
+   and the sweep leaves them alone. */
+static
+void _xpost_garbage_unmark_young(Xpost_Memory_File *mem)
+{
+    unsigned int i;
+
+    if (!mem) return;
+
+    for (i = mem->start; i < mem->table.nextent; i++)
+    {
+        if (_xpost_garbage_ent_is_old(mem, i))
+            mem->table.tab[i].mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+        else
+            mem->table.tab[i].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    }
+}
+
+/* is o a composite object with a young ent in mem? */
+static
+int _xpost_garbage_object_is_young(Xpost_Context *ctx,
+                                   Xpost_Memory_File *mem,
+                                   Xpost_Object o)
+{
+    unsigned int ent;
+
+    if (!xpost_object_is_composite(o) ||
+        xpost_context_select_memory(ctx, o) != mem)
+        return 0;
+    if (xpost_object_get_type(o) == filetype)
+        ent = o.mark_.padw;
+    else
+        ent = xpost_object_get_ent(o);
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return 0;
+    return !_xpost_garbage_ent_is_old(mem, ent);
+}
+
+/*
+   the mark bits of an ent are set with an atomic or,
+   as markers on other threads may set them at the same time.
+   the other fields of the mark are not written while marking.
+   while the first marker runs alone, plain code is enough,
+   and the deques are not locked.
+ */
+static int _xpost_garbage_shared = 0;
+
+static inline
+unsigned int _xpost_garbage_fetch_or(unsigned int *p, unsigned int v)
+{
+    unsigned int old = *p;
+    *p |= v;
+    return old;
+}
+
+#ifdef HAVE_PTHREAD
+# define XPOST_GARBAGE_FETCH_OR(p, v) (_xpost_garbage_shared ? \
+        __atomic_fetch_or((p), (v), __ATOMIC_RELAXED) : _xpost_garbage_fetch_or((p), (v)))
+# define XPOST_GARBAGE_ADD(p, v) (_xpost_garbage_shared ? \
+        __atomic_add_fetch((p), (v), __ATOMIC_ACQ_REL) : (*(p) += (v)))
+# define XPOST_GARBAGE_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define XPOST_GARBAGE_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+# define XPOST_GARBAGE_FETCH_OR(p, v) _xpost_garbage_fetch_or((p), (v))
+# define XPOST_GARBAGE_ADD(p, v) (*(p) += (v))
+# define XPOST_GARBAGE_LOAD(p) (*(p))
+# define XPOST_GARBAGE_STORE(p, v) (*(p) = (v))
+#endif
+
+/* set the MARK in the mark in the tab[ent].
+   if first is not NULL, it is set to 1 if the ent was not yet marked. */
 static
 int _xpost_garbage_mark_ent(Xpost_Memory_File *mem,
-                            unsigned int ent)
+                            unsigned int ent,
+                            int *first)
 {
+    unsigned int old;
+
+    if (first)
+        *first = 0;
     if (!mem) return 0;
 
     if (ent < mem->start)
@@ -97,141 +198,435 @@ int _xpost_garbage_mark_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find ent %u", ent);
         return 0;
     }
-    mem->table.tab[ent].mark |= XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK;
+    old = XPOST_GARBAGE_FETCH_OR(&mem->table.tab[ent].mark,
+                                 XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK);
+    if (first)
+        *first = (old & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) == 0;
     return 1;
 }
 
-/* is it marked? */
-static
-int _xpost_garbage_ent_is_marked(Xpost_Memory_File *mem,
-                                 unsigned int ent,
-                                 int *retval)
+/*
+   number of ranges a mark deque first has room for.
+   it doubles as needed.
+ */
+#define XPOST_GARBAGE_WORK_INITIAL_SIZE 256
+
+/*
+   longest range marked as one piece. the rest of a longer range
+   goes back on the deque, where an idle marker may steal it.
+ */
+#define XPOST_GARBAGE_WORK_SPLIT 256
+
+/*
+   ranges the first marker marks alone before it starts the others,
+   so that small collections do not pay for starting threads.
+ */
+#define XPOST_GARBAGE_WORK_SPAWN 1024
+
+/* a range of objects waiting to be marked:
+   the elements of an array, or the key/value pairs of a dict.
+   the context selects the memory of the objects in the range. */
+typedef struct
 {
-    if (!mem) return 0;
+    Xpost_Context *ctx;
+    Xpost_Memory_File *mem;
+    unsigned int adr;
+    unsigned int n;
+    unsigned char isdict;
+    unsigned char markall;
+} Xpost_Garbage_Work;
+
+/* a marker and its deque of ranges. the marker pushes and pops
+   at the top, idle markers steal from the bottom. */
+typedef struct
+{
+    Xpost_Garbage_Work *work;
+    unsigned int bottom;
+    unsigned int top;
+    unsigned int max;
+#ifdef HAVE_PTHREAD
+    pthread_mutex_t lock;
+    pthread_t thread;
+    int running;
+#endif
+} Xpost_Garbage_Marker;
 
-    if (ent >= mem->table.nextent)
-    {
-        XPOST_LOG_ERR("cannot find table for ent %u", ent);
-        return 0;
-    }
-    *retval = (mem->table.tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
-        >> XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET;
+/*
+   the markers. the roots are queued on the first marker's deque,
+   and the first marker drains it, starting the others once there
+   is enough work to share. marking is iterative, so the nesting of
+   arrays and dicts is not limited by the C stack. the deques are
+   kept from one collection to the next.
+ */
+static struct
+{
+    Xpost_Garbage_Marker marker[XPOST_GARBAGE_MARKERS_MAX];
+    unsigned int n; /* markers in use, 0 until the first collection */
+    int pending; /* ranges queued or being marked */
+    int failed;
+} _xpost_garbage_mark;
+
+#ifdef HAVE_PTHREAD
+# define XPOST_GARBAGE_LOCK(m) \
+    do { if (_xpost_garbage_shared) pthread_mutex_lock(&(m)->lock); } while (0)
+# define XPOST_GARBAGE_UNLOCK(m) \
+    do { if (_xpost_garbage_shared) pthread_mutex_unlock(&(m)->lock); } while (0)
+#else
+# define XPOST_GARBAGE_LOCK(m) (void)(m)
+# define XPOST_GARBAGE_UNLOCK(m) (void)(m)
+#endif
 
-    return 1;
+/* choose the number of markers:
+   XPOST_GC_THREADS if set, else the number of processors */
+static
+void _xpost_garbage_mark_init(void)
+{
+    unsigned int n = 1;
+#ifdef HAVE_PTHREAD
+    const char *s;
+    unsigned int i;
+    long l = 1;
+
+    if ((s = getenv("XPOST_GC_THREADS")) && *s)
+        l = strtol(s, NULL, 10);
+# ifdef _SC_NPROCESSORS_ONLN
+    else
+        l = sysconf(_SC_NPROCESSORS_ONLN);
+# endif
+    if (l > XPOST_GARBAGE_MARKERS_MAX)
+        l = XPOST_GARBAGE_MARKERS_MAX;
+    if (l > 1)
+        n = (unsigned int)l;
+    for (i = 0; i < n; i++)
+        pthread_mutex_init(&_xpost_garbage_mark.marker[i].lock, NULL);
+    XPOST_LOG_INFO("marking with %u thread%s", n, n > 1 ? "s" : "");
+#endif
+    _xpost_garbage_mark.n = n;
 }
 
-/* recursively mark an object */
+/* empty the deques, which a failed collection may have left */
 static
-int _xpost_garbage_mark_object(Xpost_Context *ctx, Xpost_Memory_File *mem, Xpost_Object o, int markall);
+void _xpost_garbage_mark_start(void)
+{
+    unsigned int i;
+
+    if (!_xpost_garbage_mark.n)
+        _xpost_garbage_mark_init();
+    for (i = 0; i < _xpost_garbage_mark.n; i++)
+        _xpost_garbage_mark.marker[i].top = _xpost_garbage_mark.marker[i].bottom = 0;
+    _xpost_garbage_mark.pending = 0;
+    _xpost_garbage_mark.failed = 0;
+}
 
-/* recursively mark a dictionary */
+/* queue a range of objects to be marked */
 static
-int _xpost_garbage_mark_dict(Xpost_Context *ctx,
+int _xpost_garbage_push_work(Xpost_Garbage_Marker *m,
+                             Xpost_Context *ctx,
                              Xpost_Memory_File *mem,
                              unsigned int adr,
+                             unsigned int n,
+                             int isdict,
                              int markall)
 {
-    if (!mem) return 0;
+    Xpost_Garbage_Work *w;
+
+    if (n == 0)
+        return 1;
+    /* counted first, so that the count never drops to 0
+       while a thief marks this range */
+    XPOST_GARBAGE_ADD(&_xpost_garbage_mark.pending, 1);
+    XPOST_GARBAGE_LOCK(m);
+    if (m->top == m->max)
+    {
+        unsigned int max = m->max ? 2 * m->max : XPOST_GARBAGE_WORK_INITIAL_SIZE;
+        void *tmp = realloc(m->work, max * sizeof(Xpost_Garbage_Work));
+        if (!tmp)
+        {
+            XPOST_GARBAGE_UNLOCK(m);
+            XPOST_GARBAGE_ADD(&_xpost_garbage_mark.pending, -1);
+            XPOST_LOG_ERR("cannot grow mark deque to %u", max);
+            return 0;
+        }
+        m->work = tmp;
+        m->max = max;
+    }
+    w = &m->work[m->top++];
+    w->ctx = ctx;
+    w->mem = mem;
+    w->adr = adr;
+    w->n = n;
+    w->isdict = (unsigned char)isdict;
+    w->markall = (unsigned char)markall;
+    XPOST_GARBAGE_UNLOCK(m);
+    return 1;
+}
 
+/* take the newest range of the marker's own deque */
+static
+int _xpost_garbage_pop_work(Xpost_Garbage_Marker *m,
+                            Xpost_Garbage_Work *w)
+{
+    int ret = 0;
+
+    XPOST_GARBAGE_LOCK(m);
+    if (m->top > m->bottom)
     {
-        dichead *dp = (void *)(mem->base + adr);
-        dicrec *tp = (void *)(mem->base + adr + sizeof(dichead));
-        int j;
+        *w = m->work[--m->top];
+        ret = 1;
+    }
+    if (m->top == m->bottom)
+        m->top = m->bottom = 0;
+    XPOST_GARBAGE_UNLOCK(m);
+    return ret;
+}
+
+#ifdef HAVE_PTHREAD
+/* take the oldest range of another marker's deque */
+static
+int _xpost_garbage_steal_work(Xpost_Garbage_Marker *m,
+                              Xpost_Garbage_Work *w)
+{
+    unsigned int n = _xpost_garbage_mark.n;
+    unsigned int self = (unsigned int)(m - _xpost_garbage_mark.marker);
+    unsigned int i;
+
+    for (i = 1; i < n; i++)
+    {
+        Xpost_Garbage_Marker *v = &_xpost_garbage_mark.marker[(self + i) % n];
+        int ret = 0;
+
+        XPOST_GARBAGE_LOCK(v);
+        if (v->top > v->bottom)
+        {
+            *w = v->work[v->bottom++];
+            ret = 1;
+        }
+        if (v->top == v->bottom)
+            v->top = v->bottom = 0;
+        XPOST_GARBAGE_UNLOCK(v);
+        if (ret)
+            return 1;
+    }
+    return 0;
+}
+#endif
+
+static
+int _xpost_garbage_mark_one(Xpost_Garbage_Marker *m, Xpost_Context *ctx, Xpost_Memory_File *mem, Xpost_Object o, int markall);
+
+/* mark the objects of a range, queueing their contents */
+static
+int _xpost_garbage_mark_range(Xpost_Garbage_Marker *m,
+                              Xpost_Garbage_Work *w)
+{
+    Xpost_Context *ctx = w->ctx;
+    unsigned int j;
+
+    if (w->n > XPOST_GARBAGE_WORK_SPLIT)
+    {
+        unsigned int elsz = w->isdict ? sizeof(dicrec) : sizeof(Xpost_Object);
+
+        if (!_xpost_garbage_push_work(m, ctx, w->mem,
+                                      w->adr + XPOST_GARBAGE_WORK_SPLIT * elsz,
+                                      w->n - XPOST_GARBAGE_WORK_SPLIT,
+                                      w->isdict, w->markall))
+            return 0;
+        w->n = XPOST_GARBAGE_WORK_SPLIT;
+    }
+
+    if (w->isdict)
+    {
+        dicrec *tp = (void *)(w->mem->base + w->adr);
 #ifdef DEBUG_GC
-        Xpost_Object_Type type;
-        printf("markdict: nused=%d\n", dp->nused);
+        printf("markdict: n=%u\n", w->n);
 #endif
 
-        for (j = 0; j < DICTABN(dp->sz); j++)
+        for (j = 0; j < w->n; j++)
         {
-            if (xpost_object_get_type(tp[j].key) != nulltype){
-                if (!_xpost_garbage_mark_object(ctx,
-                            xpost_context_select_memory(ctx,tp[j].key), tp[j].key, markall))
-                    return 0;
+            if (xpost_object_get_type(tp[j].key) == nulltype)
+                continue;
 #ifdef DEBUG_GC
-            switch(type = xpost_object_get_type(tp[j].key)){
-            default: {
-                    printf("%s", xpost_object_type_names[type]);
-                }
-                break;
-            case nametype: {
-                unsigned int address;
-                Xpost_Object str;
+            printf("%s:%s\n",
+                   xpost_object_type_names[xpost_object_get_type(tp[j].key)],
+                   xpost_object_type_names[xpost_object_get_type(tp[j].value)]);
+#endif
+            if (!_xpost_garbage_mark_one(m, ctx,
+                        xpost_context_select_memory(ctx, tp[j].key), tp[j].key, w->markall) ||
+                !_xpost_garbage_mark_one(m, ctx,
+                        xpost_context_select_memory(ctx, tp[j].value), tp[j].value, w->markall))
+                return 0;
+        }
+    }
+    else
+    {
+        Xpost_Object *op = (void *)(w->mem->base + w->adr);
+#ifdef DEBUG_GC
+        printf("markarray: sz=%u\n", w->n);
+#endif
 
-                xpost_memory_table_get_addr( xpost_context_select_memory(ctx,tp[j].key),
-                    XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &address);
+        for (j = 0; j < w->n; j++)
+        {
+            if (!_xpost_garbage_mark_one(m, ctx,
+                        xpost_context_select_memory(ctx, op[j]), op[j], w->markall))
+                return 0;
+        }
+    }
 
-                str = xpost_stack_bottomup_fetch(
-                    xpost_context_select_memory(ctx,tp[j].key),
-                    address, tp[j].key.mark_.padw);
-                printf("%*s", str.comp_.sz, xpost_string_get_pointer(ctx,str));
+    return 1;
+}
 
-                }
-                break;
-            }
-            printf(":");
-            printf("%s\n", xpost_object_type_names[xpost_object_get_type(tp[j].value)]);
+static
+void _xpost_garbage_spawn(void);
+
+/*
+   mark ranges until no marker has any left.
+   the count of pending ranges only reaches 0 once every range,
+   and every range it queued, is marked.
+ */
+static
+void _xpost_garbage_mark_loop(Xpost_Garbage_Marker *m)
+{
+    unsigned int marked = 0;
+    Xpost_Garbage_Work w;
+
+    while (!XPOST_GARBAGE_LOAD(&_xpost_garbage_mark.failed))
+    {
+        if (_xpost_garbage_pop_work(m, &w)
+#ifdef HAVE_PTHREAD
+            || _xpost_garbage_steal_work(m, &w)
 #endif
-                if (!_xpost_garbage_mark_object(ctx,
-                            xpost_context_select_memory(ctx,tp[j].value), tp[j].value, markall))
-                    return 0;
-            }
+           )
+        {
+            if (!_xpost_garbage_mark_range(m, &w))
+                XPOST_GARBAGE_STORE(&_xpost_garbage_mark.failed, 1);
+            XPOST_GARBAGE_ADD(&_xpost_garbage_mark.pending, -1);
+            if (++marked == XPOST_GARBAGE_WORK_SPAWN &&
+                m == &_xpost_garbage_mark.marker[0])
+                _xpost_garbage_spawn();
+            continue;
         }
+        if (XPOST_GARBAGE_LOAD(&_xpost_garbage_mark.pending) == 0)
+            break;
+#ifdef HAVE_PTHREAD
+        sched_yield();
+#endif
     }
+}
 
-    return 1;
+#ifdef HAVE_PTHREAD
+static
+void *_xpost_garbage_mark_thread(void *data)
+{
+    _xpost_garbage_mark_loop(data);
+    return NULL;
 }
+#endif
 
-/* recursively mark all elements of array */
+/* start the other markers, if there is still work to share */
 static
-int _xpost_garbage_mark_array(Xpost_Context *ctx,
-                              Xpost_Memory_File *mem,
-                              unsigned int adr,
-                              unsigned int sz,
-                              int markall)
+void _xpost_garbage_spawn(void)
 {
-    if (!mem) return 0;
+#ifdef HAVE_PTHREAD
+    unsigned int i;
 
-#ifdef DEBUG_GC
-    printf("markarray: sz=%u\n", sz);
+    if (_xpost_garbage_mark.n < 2 ||
+        XPOST_GARBAGE_LOAD(&_xpost_garbage_mark.pending) == 0)
+        return;
+    /* from here on, the deques are locked and the marks atomic */
+    _xpost_garbage_shared = 1;
+    for (i = 1; i < _xpost_garbage_mark.n; i++)
+    {
+        Xpost_Garbage_Marker *m = &_xpost_garbage_mark.marker[i];
+
+        m->running = pthread_create(&m->thread, NULL,
+                                    _xpost_garbage_mark_thread, m) == 0;
+        if (!m->running)
+        {
+            XPOST_LOG_WARN("cannot start marker %u, marking with %u", i, i);
+            break;
+        }
+    }
 #endif
+}
 
+/*
+   mark everything the queued roots refer to.
+   the first marker runs on the calling thread.
+ */
+static
+int _xpost_garbage_drain(void)
+{
+#ifdef HAVE_PTHREAD
+    unsigned int i;
+#endif
+
+    _xpost_garbage_mark_loop(&_xpost_garbage_mark.marker[0]);
+#ifdef HAVE_PTHREAD
+    for (i = 1; i < _xpost_garbage_mark.n; i++)
     {
-        Xpost_Object *op = (void *)(mem->base + adr);
-        unsigned int j;
+        Xpost_Garbage_Marker *m = &_xpost_garbage_mark.marker[i];
 
-        for (j = 0; j < sz; j++)
+        if (m->running)
         {
-#ifdef DEBUG_GC
-            printf("%u:%s\n", j, xpost_object_type_names[xpost_object_get_type(op[j])]);
-#endif
-            if (!_xpost_garbage_mark_object(ctx,
-                                            xpost_context_select_memory(ctx,op[j]),
-                                            op[j], markall))
-                return 0;
+            pthread_join(m->thread, NULL);
+            m->running = 0;
         }
     }
+    _xpost_garbage_shared = 0;
+#endif
 
-    return 1;
+    return !_xpost_garbage_mark.failed;
+}
+
+/* queue the pairs of a dictionary to be marked */
+static
+int _xpost_garbage_mark_dict(Xpost_Context *ctx,
+                             Xpost_Memory_File *mem,
+                             unsigned int adr,
+                             int markall)
+{
+    dichead *dp;
+
+    if (!mem) return 0;
+
+    dp = (void *)(mem->base + adr);
+    return _xpost_garbage_push_work(&_xpost_garbage_mark.marker[0], ctx, mem,
+                                    adr + sizeof(dichead), DICTABN(dp), 1, markall);
+}
+
+/* queue the elements of an array to be marked */
+static
+int _xpost_garbage_mark_array(Xpost_Context *ctx,
+                              Xpost_Memory_File *mem,
+                              unsigned int adr,
+                              unsigned int sz,
+                              int markall)
+{
+    if (!mem) return 0;
+
+    return _xpost_garbage_push_work(&_xpost_garbage_mark.marker[0], ctx, mem,
+                                    adr, sz, 0, markall);
 }
 
-/* traverse the contents of composite objects
+/* mark the ent of a composite object, and queue its contents
    if markall is true, this is a collection of global vm,
-   so we must mark objects and recurse
+   so we must mark objects and traverse them
    even if it means switching memory files
  */
 static
-int _xpost_garbage_mark_object(Xpost_Context *ctx,
-                               Xpost_Memory_File *mem,
-                               Xpost_Object o,
-                               int markall)
+int _xpost_garbage_mark_one(Xpost_Garbage_Marker *m,
+                            Xpost_Context *ctx,
+                            Xpost_Memory_File *mem,
+                            Xpost_Object o,
+                            int markall)
 {
     unsigned int ad;
     int ret;
-    unsigned int tag;
+    int first;
     unsigned int ent;
     Xpost_Object_Type type;
     Xpost_Memory_File *objmem;
+    dichead *dp;
 
     if (!mem) return 0;
 
@@ -274,36 +669,26 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                 return 0;
             }
             if (!objmem) return 0;
-            if (!_xpost_garbage_ent_is_marked(objmem, ent, &ret))
+            /* only the marker that sets the mark queues the contents */
+            ret = _xpost_garbage_mark_ent(objmem, ent, &first);
+            if (!ret)
+            {
+                XPOST_LOG_ERR("cannot mark array %d", ent);
                 return 0;
-            if (!ret) {
-                ret = _xpost_garbage_mark_ent(objmem, ent);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark array %d", ent);
-                    return 0;
-                }
+            }
+            if (first)
+            {
                 ret = xpost_memory_table_get_addr(objmem, ent, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for array ent %u", ent);
                     return 0;
                 }
-                ret = xpost_memory_table_get_tag(objmem, ent, &tag);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot retrieve tag for array ent %u", ent);
-                    return 0;
-                }
-                if (o.comp_.sz != objmem->table.tab[ent].used/sizeof(Xpost_Object))
-                {
-                    XPOST_LOG_INFO("o.comp_.sz %u != tab[ent].used/obj %u",
-                            o.comp_.sz, objmem->table.tab[ent].used/sizeof(Xpost_Object));
-                }
-                if (!_xpost_garbage_mark_array(ctx, objmem, ad,
-                            //mem->table.tab[ent].used/sizeof(Xpost_Object)
-                            o.comp_.sz
-                            , markall))
+                /* o may be a subarray, so mark the whole allocation:
+                   the ent is not visited again once it is marked */
+                if (!_xpost_garbage_push_work(m, ctx, objmem, ad,
+                            objmem->table.tab[ent].used/sizeof(Xpost_Object),
+                            0, markall))
                     return 0;
             }
             break;
@@ -322,23 +707,23 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            if (!_xpost_garbage_ent_is_marked(objmem, ent, &ret))
-                return 0;
+            ret = _xpost_garbage_mark_ent(objmem, ent, &first);
             if (!ret)
             {
-                ret = _xpost_garbage_mark_ent(objmem, ent);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark dict");
-                    return 0;
-                }
+                XPOST_LOG_ERR("cannot mark dict");
+                return 0;
+            }
+            if (first)
+            {
                 ret = xpost_memory_table_get_addr(objmem, ent, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for dict ent %u", ent);
                     return 0;
                 }
-                if (!_xpost_garbage_mark_dict(ctx, objmem, ad, markall))
+                dp = (void *)(objmem->base + ad);
+                if (!_xpost_garbage_push_work(m, ctx, objmem, ad + sizeof(dichead),
+                                              DICTABN(dp), 1, markall))
                     return 0;
             }
             break;
@@ -363,7 +748,7 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            ret = _xpost_garbage_mark_ent(objmem, ent);
+            ret = _xpost_garbage_mark_ent(objmem, ent, NULL);
             if (!ret)
             {
                 XPOST_LOG_ERR("cannot mark string");
@@ -380,16 +765,11 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
                         ent);
                 return 0;
             }
-            if (objmem == ctx->gl)
+            ret = _xpost_garbage_mark_ent(objmem, o.mark_.padw, NULL);
+            if (!ret)
             {
-                printf("file found in global vm\n");
-            } else {
-                ret = _xpost_garbage_mark_ent(objmem, o.mark_.padw);
-                if (!ret)
-                {
-                    XPOST_LOG_ERR("cannot mark file");
-                    return 0;
-                }
+                XPOST_LOG_ERR("cannot mark file");
+                return 0;
             }
             break;
     }
@@ -398,6 +778,17 @@ int _xpost_garbage_mark_object(Xpost_Context *ctx,
 }
 
 
+/* mark an object and queue everything it refers to */
+static
+int _xpost_garbage_mark_object(Xpost_Context *ctx,
+                               Xpost_Memory_File *mem,
+                               Xpost_Object o,
+                               int markall)
+{
+    return _xpost_garbage_mark_one(&_xpost_garbage_mark.marker[0],
+                                   ctx, mem, o, markall);
+}
+
 /* mark all names in stack except 0::BOGUSNAME */
 static
 int _xpost_garbage_mark_names(Xpost_Context *ctx,
@@ -416,20 +807,11 @@ int _xpost_garbage_mark_names(Xpost_Context *ctx,
         printf("marking stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
         for (i = start; i < s->top; i++)
         {
-            if (!_xpost_garbage_mark_object(ctx, mem, s->data[i], markall))
+            if (!_xpost_garbage_mark_object(ctx, mem, XPOST_STACK_DATA(mem, s)[i], markall))
                 return 0;
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            if (s->nextseg == 0)
-                return 0;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            start = 0;
-            goto next;
-        }
     }
 
     return 1;
@@ -453,27 +835,53 @@ int _xpost_garbage_mark_stack(Xpost_Context *ctx,
         printf("marking stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
         for (i = 0; i < s->top; i++)
         {
+            Xpost_Object o = XPOST_STACK_DATA(mem, s)[i];
             Xpost_Memory_File *objmem;
-            objmem = xpost_context_select_memory(ctx, s->data[i]);
+            objmem = xpost_context_select_memory(ctx, o);
             if (objmem == mem || markall)
-                if (!_xpost_garbage_mark_object(ctx, objmem, s->data[i], markall))
+                if (!_xpost_garbage_mark_object(ctx, objmem, o, markall))
                     return 0;
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            if (s->nextseg == 0)
-                return 0;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            goto next;
-        }
     }
 
     return 1;
 }
 
+/* mark a chunk directory and its chunk copies,
+   and queue the objects they hold */
+static
+int _xpost_garbage_mark_chunks(Xpost_Context *ctx,
+                               Xpost_Memory_File *mem,
+                               unsigned tag,
+                               unsigned int dir)
+{
+    unsigned int head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    unsigned int elsz = XPOST_SAVE_ELEMENT_SIZE(tag);
+    unsigned int nchunks;
+    unsigned int c;
+
+    if (!_xpost_garbage_mark_ent(mem, dir, NULL))
+        return 0;
+    nchunks = (mem->table.tab[dir].used - head) / sizeof(unsigned int);
+    for (c = 0; c < nchunks; c++)
+    {
+        unsigned int cpy = ((unsigned int *)(mem->base + mem->table.tab[dir].adr + head))[c];
+
+        if (cpy == 0)
+            continue;
+        if (!_xpost_garbage_mark_ent(mem, cpy, NULL))
+            return 0;
+        if (!_xpost_garbage_push_work(&_xpost_garbage_mark.marker[0], ctx, mem,
+                    mem->table.tab[cpy].adr,
+                    mem->table.tab[cpy].used / elsz,
+                    (tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) == dicttype, 0))
+            return 0;
+    }
+    return 1;
+}
+
 /* mark all allocations referred to by objects in save object's stack of saverec_'s */
 static
 int _xpost_garbage_mark_save_stack(Xpost_Context *ctx,
@@ -493,72 +901,76 @@ int _xpost_garbage_mark_save_stack(Xpost_Context *ctx,
         printf("marking saverec stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-next:
         for (i = 0; i < s->top; i++)
         {
-            /* _xpost_garbage_mark_object(ctx, mem, s->data[i]); */
-            /* _xpost_garbage_mark_save_stack(ctx, mem, s->data[i].save_.stk); */
-            ret = _xpost_garbage_mark_ent(mem, s->data[i].saverec_.src);
+            Xpost_Object *data = XPOST_STACK_DATA(mem, s);
+
+            /* _xpost_garbage_mark_object(ctx, mem, data[i]); */
+            /* _xpost_garbage_mark_save_stack(ctx, mem, data[i].save_.stk); */
+            ret = _xpost_garbage_mark_ent(mem, data[i].saverec_.src, NULL);
             if (!ret)
             {
                 XPOST_LOG_ERR("cannot mark array");
                 return 0;
             }
-            ret = _xpost_garbage_mark_ent(mem, s->data[i].saverec_.cpy);
+            if (data[i].saverec_.tag & XPOST_SAVE_CHUNKED)
+                ret = _xpost_garbage_mark_chunks(ctx, mem,
+                        data[i].saverec_.tag, data[i].saverec_.cpy);
+            else
+                ret = _xpost_garbage_mark_ent(mem, data[i].saverec_.cpy, NULL);
             if (!ret)
             {
                 XPOST_LOG_ERR("cannot mark array");
                 return 0;
             }
-            if (s->data[i].saverec_.tag == dicttype)
+            if ((data[i].saverec_.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) == dicttype)
             {
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.src, &ad);
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.src, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for ent %u",
-                                  s->data[i].saverec_.src);
+                                  data[i].saverec_.src);
                     return 0;
                 }
                 if (!_xpost_garbage_mark_dict(ctx, mem, ad, 0))
                     return 0;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.cpy, &ad);
+                if (data[i].saverec_.tag & XPOST_SAVE_CHUNKED)
+                    continue;
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.cpy, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for ent %u",
-                                  s->data[i].saverec_.cpy);
+                                  data[i].saverec_.cpy);
                     return 0;
                 }
                 if (!_xpost_garbage_mark_dict(ctx, mem, ad, 0))
                     return 0;
             }
-            if (s->data[i].saverec_.tag == arraytype)
+            if ((data[i].saverec_.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) == arraytype)
             {
-                unsigned int sz = s->data[i].saverec_.pad;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.src, &ad);
+                unsigned int sz = data[i].saverec_.pad;
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.src, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for array ent %u",
-                                  s->data[i].saverec_.src);
+                                  data[i].saverec_.src);
                     return 0;
                 }
                 if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
                     return 0;
-                ret = xpost_memory_table_get_addr(mem, s->data[i].saverec_.cpy, &ad);
+                if (data[i].saverec_.tag & XPOST_SAVE_CHUNKED)
+                    continue;
+                ret = xpost_memory_table_get_addr(mem, data[i].saverec_.cpy, &ad);
                 if (!ret)
                 {
                     XPOST_LOG_ERR("cannot retrieve address for array ent %u",
-                                  s->data[i].saverec_.cpy);
+                                  data[i].saverec_.cpy);
                     return 0;
                 }
                 if (!_xpost_garbage_mark_array(ctx, mem, ad, sz, 0))
                     return 0;
             }
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
-        {
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            goto next;
-        }
     }
 
     return 1;
@@ -580,24 +992,78 @@ int _xpost_garbage_mark_save(Xpost_Context *ctx,
         printf("marking save stack of size %u\n", xpost_stack_count(mem, stackadr));
 #endif
 
-    next:
         for (i = 0; i < s->top; i++)
         {
             /* _xpost_garbage_mark_object(ctx, mem, s->data[i]); */
-            if (!_xpost_garbage_mark_save_stack(ctx, mem, s->data[i].save_.stk))
+            if (!_xpost_garbage_mark_save_stack(ctx, mem,
+                        XPOST_STACK_DATA(mem, s)[i].save_.stk))
                 return 0;
         }
-        if (i == XPOST_STACK_SEGMENT_SIZE) /* ie. s->top == XPOST_STACK_SEGMENT_SIZE */
+    }
+    return 1;
+}
+
+/* iterate through tables,
+        for each remembered array or dict,
+            if domark, mark its contents,
+            forget it if it refers to no young ent.
+   domark is set for a minor collection,
+   where the remembered set stands in for the old generation.
+ */
+static
+int _xpost_garbage_mark_remembered(Xpost_Context *ctx,
+                                   Xpost_Memory_File *mem,
+                                   int markall,
+                                   int domark)
+{
+    unsigned int i;
+
+    if (!mem) return 0;
+
+    for (i = mem->start; i < mem->table.nextent; i++)
+    {
+        unsigned int ad;
+        int young = 0;
+
+        if ((mem->table.tab[i].mark & XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK) == 0)
+            continue;
+        ad = mem->table.tab[i].adr;
+        if (mem->table.tab[i].tag == arraytype)
         {
-            s = (void *)(mem->base + s->nextseg);
-            goto next;
+            Xpost_Object *op;
+            unsigned int sz = mem->table.tab[i].used / sizeof(Xpost_Object);
+            unsigned int j;
+
+            if (domark && !_xpost_garbage_mark_array(ctx, mem, ad, sz, markall))
+                return 0;
+            op = (void *)(mem->base + ad);
+            for (j = 0; j < sz && !young; j++)
+                young = _xpost_garbage_object_is_young(ctx, mem, op[j]);
         }
+        else if (mem->table.tab[i].tag == dicttype)
+        {
+            dichead *dp;
+            dicrec *tp;
+            unsigned int j;
+
+            if (domark && !_xpost_garbage_mark_dict(ctx, mem, ad, markall))
+                return 0;
+            dp = (void *)(mem->base + ad);
+            tp = (void *)(mem->base + ad + sizeof(dichead));
+            for (j = 0; j < DICTABN(dp) && !young; j++)
+                young = _xpost_garbage_object_is_young(ctx, mem, tp[j].key) ||
+                    _xpost_garbage_object_is_young(ctx, mem, tp[j].value);
+        }
+        if (!young)
+            mem->table.tab[i].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK;
     }
+
     return 1;
 }
 
-/* discard the free list.
+/* discard the free lists.
    iterate through tables,
+        if element is marked, age it,
         if element is unmarked and not zero-sized,
             free it.
    return reclaimed size
@@ -605,21 +1071,11 @@ int _xpost_garbage_mark_save(Xpost_Context *ctx,
 static
 unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
 {
-    unsigned int zero = 0;
-    unsigned int z;
     unsigned int i;
     unsigned int sz = 0;
     int ret;
 
-    ret = xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_FREE, &z); /* address of the free list head */
-    if (!ret)
-    {
-        XPOST_LOG_ERR("cannot load free list head");
-        return 0;
-    }
-
-    memcpy(mem->base+z, &zero, sizeof(unsigned int)); /* discard list */
-    /* *(unsigned int *)(mem->base+z) = 0; */
+    xpost_free_discard(mem); /* discard lists */
 
 #ifdef DEBUG_GC
     printf("freeing ");
@@ -627,8 +1083,28 @@ unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
     /* scan table */
     for (i = mem->start; i < mem->table.nextent; i++)
     {
-        if (((mem->table.tab[i].mark & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK) == 0) &&
-            (mem->table.tab[i].sz != 0))
+        unsigned int m = mem->table.tab[i].mark;
+
+        if (m & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK)
+        {
+            unsigned int age = (m & XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK)
+                >> XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET;
+
+            if (age < XPOST_GARBAGE_PROMOTION_AGE)
+            {
+                /* a survivor ages. a newly old array or dict may still
+                   refer to young ents, so it starts out remembered. */
+                ++age;
+                m &= ~XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK;
+                m |= age << XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET;
+                if (age == XPOST_GARBAGE_PROMOTION_AGE &&
+                    (mem->table.tab[i].tag == arraytype ||
+                     mem->table.tab[i].tag == dicttype))
+                    m |= XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK;
+                mem->table.tab[i].mark = m;
+            }
+        }
+        else if (mem->table.tab[i].sz != 0)
         {
 #ifdef DEBUG_GC
             printf("%u ", i);
@@ -651,11 +1127,278 @@ unsigned int _xpost_garbage_sweep(Xpost_Memory_File *mem)
     return sz;
 }
 
+/* mark from the roots kept in the memory file itself:
+   the save stack and the name stack */
+static
+int _xpost_garbage_mark_vm(Xpost_Context *ctx,
+                           Xpost_Memory_File *mem,
+                           int markall)
+{
+    const char *vm = mem == ctx->gl ? "global" : "local";
+    unsigned int ad;
+    int ret;
+
+    ret = xpost_memory_table_get_addr(mem,
+                                      XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load save stack for %s memory", vm);
+        return 0;
+    }
+    if (!_xpost_garbage_mark_save(ctx, mem, ad))
+        return 0;
+    ret = xpost_memory_table_get_addr(mem,
+                                      XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("cannot load name stack for %s memory", vm);
+        return 0;
+    }
+#ifdef DEBUG_GC
+    printf("marking name stack\n");
+#endif
+    if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
+        return 0;
+
+    return 1;
+}
+
+/* mark from the roots kept in the context:
+   its stacks and its window device */
+static
+int _xpost_garbage_mark_context(Xpost_Context *ctx,
+                                Xpost_Memory_File *mem,
+                                int markall)
+{
+#ifdef DEBUG_GC
+    printf("marking os\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->os, markall))
+        return 0;
+
+#ifdef DEBUG_GC
+    printf("marking ds\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->ds, markall))
+        return 0;
+
+#ifdef DEBUG_GC
+    printf("marking es\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->es, markall))
+        return 0;
+
+#ifdef DEBUG_GC
+    printf("marking hold\n");
+#endif
+    if (!_xpost_garbage_mark_stack(ctx, mem, ctx->hold, markall))
+        return 0;
+#ifdef DEBUG_GC
+    printf("marking window device\n");
+#endif
+    if (!_xpost_garbage_mark_object(ctx, mem, ctx->window_device, markall))
+        return 0;
+#if 0
+#ifdef DEBUG_GC
+    printf("marking event handler\n");
+#endif
+    if (!_xpost_garbage_mark_object(ctx, mem, ctx->event_handler, markall))
+        return 0;
+#endif
+
+    return 1;
+}
+
+/* is context cid[i] the first in the list to use its local vm?
+   contexts may share local vm, which must be visited once */
+static
+int _xpost_garbage_first_local(Xpost_Memory_File *mem,
+                               unsigned int *cid,
+                               unsigned int i)
+{
+    Xpost_Memory_File *lo = mem->interpreter_cid_get_context(cid[i])->lo;
+    unsigned int j;
+
+    for (j = 0; j < i; j++)
+        if (mem->interpreter_cid_get_context(cid[j])->lo == lo)
+            return 0;
+    return 1;
+}
+
+/* the time in microseconds, to report pauses */
+static
+double _xpost_garbage_clock(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000.0 + tv.tv_usec;
+#else
+    return time(NULL) * 1000000.0;
+#endif
+}
+
+/* after a sweep, ask for compaction if enough of the vm is free */
+static
+void _xpost_garbage_check_fragmentation(Xpost_Memory_File *mem)
+{
+    unsigned int sz = xpost_free_get_size(mem);
+
+    if (sz >= XPOST_GARBAGE_COMPACT_MIN &&
+        sz >= mem->used / 100 * XPOST_GARBAGE_COMPACT_PERCENT)
+        mem->compact = 1;
+}
+
+/* write barrier. a stored-to old ent joins the remembered set */
+void xpost_garbage_remember(Xpost_Memory_File *mem,
+                            unsigned int ent)
+{
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return;
+    if (_xpost_garbage_ent_is_old(mem, ent))
+        mem->table.tab[ent].mark |= XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK;
+}
+
+/* the next collection of mem will be a full one */
+void xpost_garbage_request_full(Xpost_Memory_File *mem)
+{
+    mem->minor = XPOST_GARBAGE_FULL_PERIOD;
+}
+
+/* the save level an ent was allocated at */
+static
+unsigned int _xpost_garbage_ent_level(Xpost_Memory_File *mem,
+                                      unsigned int ent)
+{
+    return (mem->table.tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
+}
+
+/* is o an array or dict in mem allocated above save level lev? */
+static
+int _xpost_garbage_object_is_newer(Xpost_Context *ctx,
+                                   Xpost_Memory_File *mem,
+                                   Xpost_Object o,
+                                   unsigned int lev)
+{
+    unsigned int ent;
+
+    if ((xpost_object_get_type(o) != arraytype &&
+         xpost_object_get_type(o) != dicttype) ||
+        xpost_context_select_memory(ctx, o) != mem)
+        return 0;
+    ent = xpost_object_get_ent(o);
+    if (ent < mem->start || ent >= mem->table.nextent)
+        return 0;
+    return _xpost_garbage_ent_level(mem, ent) > lev;
+}
+
+/* does any object on the stack refer above save level lev? */
+static
+int _xpost_garbage_stack_is_newer(Xpost_Context *ctx,
+                                  Xpost_Memory_File *mem,
+                                  unsigned int stackadr,
+                                  unsigned int lev)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    unsigned int i;
+
+    for (i = 0; i < s->top; i++)
+        if (_xpost_garbage_object_is_newer(ctx, mem, XPOST_STACK_DATA(mem, s)[i], lev))
+            return 1;
+    return 0;
+}
+
+/*
+   after a restore to save level lev:
+   if no root of a context using mem refers to an array or dict
+   allocated above lev, none is reachable, since every older one
+   has its contents back. free them all, with the copies and
+   saverec stacks the restore left at those levels (tag 0).
+   a root that does refer to one leaves the arrays and dicts to
+   the collector. strings carry no save level, and are left too.
+ */
+int xpost_garbage_release(Xpost_Memory_File *mem,
+                          unsigned int lev)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int *cid;
+    unsigned int *ents;
+    unsigned int ad;
+    unsigned int i;
+    unsigned int n;
+    int reachable = 0;
+    int sz;
+
+    if (mem->interpreter_get_initializing())
+        return 0;
+    if (!xpost_memory_table_get_addr(mem,
+                                     XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST, &ad))
+    {
+        XPOST_LOG_ERR("cannot load context list");
+        return -1;
+    }
+    cid = (void *)(mem->base + ad);
+    for (i = 0; i < MAXCONTEXT && cid[i] && !reachable; i++)
+    {
+        Xpost_Context *ctx = mem->interpreter_cid_get_context(cid[i]);
+
+        if (ctx->lo != mem)
+            continue;
+        reachable = _xpost_garbage_stack_is_newer(ctx, mem, ctx->os, lev)
+            || _xpost_garbage_stack_is_newer(ctx, mem, ctx->ds, lev)
+            || _xpost_garbage_stack_is_newer(ctx, mem, ctx->es, lev)
+            || _xpost_garbage_stack_is_newer(ctx, mem, ctx->hold, lev)
+            || _xpost_garbage_object_is_newer(ctx, mem, ctx->window_device, lev)
+            || _xpost_garbage_object_is_newer(ctx, mem, ctx->event_handler, lev);
+    }
+
+    ents = malloc((tab->nextent - mem->start) * sizeof *ents);
+    if (!ents)
+    {
+        XPOST_LOG_ERR("cannot allocate release table");
+        return -1;
+    }
+    n = 0;
+    for (i = mem->start; i < tab->nextent; i++)
+    {
+        if (tab->tab[i].sz == 0 || _xpost_garbage_ent_level(mem, i) <= lev)
+            continue;
+        if (tab->tab[i].tag == 0 ||
+            (!reachable &&
+             (tab->tab[i].tag == arraytype || tab->tab[i].tag == dicttype)))
+            ents[n++] = i;
+    }
+    sz = xpost_free_release(mem, ents, n);
+    free(ents);
+    if (sz < 0)
+        return -1;
+
+    /* what was given back need not be collected */
+    if (mem->threshold > INT_MAX - sz)
+        mem->threshold = INT_MAX;
+    else
+        mem->threshold += sz;
+    XPOST_LOG_INFO("restore released %u ents, %d bytes, in %s%s",
+                   n, sz, mem->fname, reachable ? " (arrays and dicts still reachable)" : "");
+    return sz;
+}
+
 /*
    determine GLOBAL/LOCAL
-   clear all marks,
-   mark all root stacks,
-   sweep.
+   LOCAL:
+     determine minor/full,
+     clear all marks (only young marks if minor),
+     prune the remembered set (and mark from it if minor),
+     queue all root stacks,
+     mark, possibly on several threads,
+     sweep, aging survivors.
+   GLOBAL:
+     clear all marks in global vm and every local vm,
+     prune the local remembered sets,
+     queue global roots, then local roots of every context,
+     mark, possibly on several threads,
+     sweep global vm and every local vm.
    return reclaimed size or -1 if error occured.
  */
 int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
@@ -664,12 +1407,17 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
     unsigned int *cid;
     Xpost_Context *ctx = NULL;
     int isglobal;
+    int full;
     unsigned int sz = 0;
+    unsigned int live;
     unsigned int ad;
+    double start;
     int ret;
 
     if (mem->interpreter_get_initializing()) /* do not collect while initializing */
         return 0;
+    start = _xpost_garbage_clock();
+    _xpost_garbage_mark_start();
 
     /* printf("\ncollect:\n"); */
 
@@ -706,127 +1454,109 @@ int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall)
 
     if (isglobal)
     {
-        dosweep = 0;
-        return 0; /* do not perform global collections at this time */
-
+        /* local objects may refer to global ones,
+           so every local vm is marked in full, and may as well be swept */
+        full = 1;
         _xpost_garbage_unmark(mem);
-
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot load save stack for global memory");
-            return -1;
-        }
-        if (!_xpost_garbage_mark_save(ctx, mem, ad))
-            return -1;
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
-        if (!ret)
+        for (i = 0; i < MAXCONTEXT && cid[i]; i++)
         {
-            XPOST_LOG_ERR("cannot load name stack for global memory");
-            return -1;
+            if (!_xpost_garbage_first_local(mem, cid, i))
+                continue;
+            ctx = mem->interpreter_cid_get_context(cid[i]);
+            ctx->lo->minor = 0;
+            _xpost_garbage_unmark(ctx->lo);
+            if (!_xpost_garbage_mark_remembered(ctx, ctx->lo, 1, 0))
+                return -1;
         }
-        if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
+
+        if (!_xpost_garbage_mark_vm(ctx, mem, 1))
             return -1;
 
         for (i = 0; i < MAXCONTEXT && cid[i]; i++)
         {
             ctx = mem->interpreter_cid_get_context(cid[i]);
-            xpost_garbage_collect(ctx->lo, 0, markall);
+            if (_xpost_garbage_first_local(mem, cid, i) &&
+                !_xpost_garbage_mark_vm(ctx, ctx->lo, 1))
+                return -1;
+            if (!_xpost_garbage_mark_context(ctx, ctx->lo, 1))
+                return -1;
         }
-
     }
     else /* local */
     {
         //printf("collect!\n");
-        _xpost_garbage_unmark(mem);
-        if (markall)
-            _xpost_garbage_unmark(ctx->gl);
-
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &ad);
-        if (!ret)
+        /* a mark-only pass must see everything */
+        full = !dosweep || mem->minor >= XPOST_GARBAGE_FULL_PERIOD;
+        if (full)
         {
-            XPOST_LOG_ERR("cannot load save stack for local memory");
-            return -1;
+            mem->minor = 0;
+            _xpost_garbage_unmark(mem);
         }
-        if (!_xpost_garbage_mark_save(ctx, mem, ad))
-            return -1;
-        ret = xpost_memory_table_get_addr(mem,
-                                          XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &ad);
-        if (!ret)
+        else
         {
-            XPOST_LOG_ERR("cannot load name stack for local memory");
-            return -1;
+            ++mem->minor;
+            _xpost_garbage_unmark_young(mem);
         }
-#ifdef DEBUG_GC
-        printf("marking name stack\n");
-#endif
-        if (!_xpost_garbage_mark_names(ctx, mem, ad, markall))
+        if (markall)
+            _xpost_garbage_unmark(ctx->gl);
+        if (!_xpost_garbage_mark_remembered(ctx, mem, markall, !full))
+            return -1;
+
+        if (!_xpost_garbage_mark_vm(ctx, mem, markall))
             return -1;
 
         for (i = 0; i < MAXCONTEXT && cid[i]; i++)
         {
             ctx = mem->interpreter_cid_get_context(cid[i]);
-
-#ifdef DEBUG_GC
-            printf("marking os\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->os, markall))
-                return -1;
-
-#ifdef DEBUG_GC
-            printf("marking ds\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->ds, markall))
+            if (!_xpost_garbage_mark_context(ctx, mem, markall))
                 return -1;
-
-#ifdef DEBUG_GC
-            printf("marking es\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->es, markall))
-                return -1;
-
-#ifdef DEBUG_GC
-            printf("marking hold\n");
-#endif
-            if (!_xpost_garbage_mark_stack(ctx, mem, ctx->hold, markall))
-                return -1;
-#ifdef DEBUG_GC
-            printf("marking window device\n");
-#endif
-            if (!_xpost_garbage_mark_object(ctx, mem, ctx->window_device, markall))
-                return -1;
-#if 0
-#ifdef DEBUG_GC
-            printf("marking event handler\n");
-#endif
-            if (!_xpost_garbage_mark_object(ctx, mem, ctx->event_handler, markall))
-                return -1;
-#endif
         }
     }
 
+    /* the roots are queued. mark what they refer to */
+    if (!_xpost_garbage_drain())
+        return -1;
+
     if (dosweep) {
 #ifdef DEBUG_GC
         printf("sweep\n");
 #endif
         sz += _xpost_garbage_sweep(mem);
+        _xpost_garbage_check_fragmentation(mem);
+        live = xpost_free_schedule(mem);
         if (isglobal)
         {
             for (i = 0; i < MAXCONTEXT && cid[i]; i++)
             {
+                if (!_xpost_garbage_first_local(mem, cid, i))
+                    continue;
 #ifdef DEBUG_GC
-                printf("sweep context(%d)->gl\n", cid[i]);
+                printf("sweep context(%d)->lo\n", cid[i]);
 #endif
                 ctx = mem->interpreter_cid_get_context(cid[i]);
                 sz += _xpost_garbage_sweep(ctx->lo);
+                _xpost_garbage_check_fragmentation(ctx->lo);
+                live += xpost_free_schedule(ctx->lo);
             }
         }
+        XPOST_LOG_INFO("%s collection: %u bytes live, %u bytes reclaimed, "
+                       "%.0f us, next after %d bytes",
+                       isglobal ? "global" : full ? "full local" : "minor local",
+                       live, sz, _xpost_garbage_clock() - start, mem->threshold);
     }
 
-    printf("collect recovered %u bytes\n", sz);
+    return sz;
+}
+
+unsigned int xpost_garbage_compact(Xpost_Memory_File *mem)
+{
+    unsigned int sz;
+
+    if (!mem->compact)
+        return 0;
+    mem->compact = 0;
+    sz = xpost_free_compact(mem);
+    XPOST_LOG_INFO("compact %s returned %u bytes", mem->fname, sz);
     return sz;
 }
 
@@ -980,7 +1710,7 @@ int init_test_garbage(int (*xpost_interpreter_cid_init)(unsigned int *cid),
     /* only need one stack */
     ctx->vmmode = LOCAL;
     xpost_stack_init(ctx->lo, &ctx->hold);
-    ctx->os = ctx->ds = ctx->es = ctx->hold;
+    ctx->os = ctx->ds = ctx->es = ctx->cs = ctx->hold;
 
     ctx->gl->interpreter_set_initializing(0); /* garbage collector won't run otherwise */
 
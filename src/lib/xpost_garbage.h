@@ -38,6 +38,38 @@
  */
 
 
+/**
+ * @brief The number of collections an entity must survive before it
+ * is promoted to the old generation.
+ */
+#define XPOST_GARBAGE_PROMOTION_AGE 2
+
+/**
+ * @brief The number of minor collections of a local vm between full
+ * collections.
+ */
+#define XPOST_GARBAGE_FULL_PERIOD 8
+
+/**
+ * @brief The free space, as a percentage of the used size of a vm,
+ * above which a sweep asks for the vm to be compacted.
+ */
+#define XPOST_GARBAGE_COMPACT_PERCENT 25
+
+/**
+ * @brief The free space in bytes below which a vm is never compacted.
+ */
+#define XPOST_GARBAGE_COMPACT_MIN 65536
+
+/**
+ * @brief The largest number of threads that mark in parallel.
+ *
+ * The number used is read from the environment variable
+ * XPOST_GC_THREADS at the first collection, and defaults to the
+ * number of processors. Without pthreads, marking uses one thread.
+ */
+#define XPOST_GARBAGE_MARKERS_MAX 8
+
 /**
  * @brief  Perform a garbage collection on mfile.
  *
@@ -48,13 +80,63 @@
  * For a local vm, dosweep should be 1 and markall should be 0.
  * For a global vm, dosweep should be 1 and markall should be 1.
  *
- * For a global vm, collect() calls itself recursively upon each
- * associated local vm, with dosweep = 0, markall = 1.
+ * A collection of a global vm also marks and sweeps each associated
+ * local vm.
+ *
+ * A sweep that leaves the vm fragmented sets mem->compact, asking
+ * for xpost_garbage_compact() at the next safe point.
  *
  * returns size collected or -1 if error occured.
  */
 int xpost_garbage_collect(Xpost_Memory_File *mem, int dosweep, int markall);
 
+/**
+ * @brief Make the next collection of mem a full collection.
+ *
+ * A local vm is collected generationally: a minor collection marks
+ * and sweeps only young entities, treating every old entity as live
+ * and the remembered set as roots. Every #XPOST_GARBAGE_FULL_PERIOD
+ * collections, or after this call, the whole vm is collected.
+ */
+void xpost_garbage_request_full(Xpost_Memory_File *mem);
+
+/**
+ * @brief Write barrier: note a store of a composite object into ent.
+ *
+ * If ent is old, it joins the remembered set, so that minor
+ * collections find the young entities it may now refer to. Called by
+ * xpost_array_put_memory(), xpost_dict_put_memory() and restore.
+ */
+void xpost_garbage_remember(Xpost_Memory_File *mem, unsigned int ent);
+
+/**
+ * @brief Free what a restore to save level lev left behind, without
+ * a collection.
+ *
+ * Called by restore once the save objects above lev are popped. The
+ * arrays and dicts allocated above lev are freed, unless a root of a
+ * context using mem still refers to one, which leaves them to the
+ * collector. The copies and saverec stacks of the restored levels
+ * are always freed. Storage at the end of the memory file is given
+ * back to it (see xpost_free_release()), and the bytes freed are
+ * allowed again before the next automatic collection.
+ *
+ * returns size freed or -1 if error occured.
+ */
+int xpost_garbage_release(Xpost_Memory_File *mem, unsigned int lev);
+
+/**
+ * @brief Compact mem if a sweep asked for it.
+ *
+ * Live entities are moved down over the free space, and the free
+ * space at the end of the memory file is returned to the system (see
+ * xpost_free_compact()). Entity addresses change, so this is called
+ * by the interpreter between objects, never from an allocation.
+ *
+ * returns the number of bytes returned.
+ */
+unsigned int xpost_garbage_compact(Xpost_Memory_File *mem);
+
 #if 0
 /**
  * @brief perform a short functionality test
@@ -0,0 +1,503 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+# include <unistd.h>  /* close */
+#endif
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_compat.h"  /* XPOST_PATH_MAX */
+#include "xpost_memory.h"  /* an image holds memory files and their tables */
+#include "xpost_object.h"
+#include "xpost_stack.h"  /* the save stacks must be empty */
+#include "xpost_context.h"
+#include "xpost_file.h"  /* open files cannot be saved */
+#include "xpost_operator.h"  /* an image holds the operator count */
+#include "xpost_oplib.h"  /* loading rebinds the operators */
+
+#include "xpost_image.h"  /* double-check prototypes */
+
+#define XPOST_IMAGE_MAGIC "XPOSTIMG"
+#define XPOST_IMAGE_FORMAT 2
+#define XPOST_IMAGE_DEVICE_MAX 64
+
+/* file header. the contents follow:
+   the context record, then a memory record and its table entries
+   for local then global vm, then the used bytes of local then
+   global vm, each starting on a page so that it can be mapped. */
+typedef struct
+{
+    char magic[8];
+    unsigned int format;
+    int version[3];
+    unsigned int sizes[5]; /* void *, Xpost_Object, table entry, Xpost_Context, page */
+    unsigned int nops; /* operators in the optab */
+    unsigned int cid;
+    char initps[XPOST_PATH_MAX];
+    long initps_size;
+    long initps_mtime;
+    char device[XPOST_IMAGE_DEVICE_MAX]; /* device made with graphics, or "" */
+    unsigned int sum[2]; /* checksum of all but the used bytes */
+} Xpost_Image_Header;
+
+typedef struct
+{
+    Xpost_Object currentobject;
+    Xpost_Object event_handler;
+    Xpost_Object window_device;
+    unsigned int os, es, ds, hold, cs;
+    unsigned int vmmode;
+    unsigned int state;
+    unsigned long rand_next;
+} Xpost_Image_Context;
+
+typedef struct
+{
+    unsigned int used;
+    unsigned int start;
+    int compact;
+    int threshold;
+    int vmthreshold;
+    int autocollect;
+    unsigned int minor;
+    unsigned int nextent;
+    unsigned int tabmax;
+} Xpost_Image_Memory;
+
+/* add n bytes to a Fletcher-style checksum of 32-bit words.
+   a short last word is padded with zeros. */
+static
+void _xpost_image_sum(unsigned int *sum, const void *p, size_t n)
+{
+    const unsigned char *c = p;
+    unsigned int a = sum[0];
+    unsigned int b = sum[1];
+    unsigned int w;
+
+    for ( ; n >= sizeof w; c += sizeof w, n -= sizeof w)
+    {
+        memcpy(&w, c, sizeof w);
+        a += w;
+        b += a;
+    }
+    if (n)
+    {
+        w = 0;
+        memcpy(&w, c, n);
+        a += w;
+        b += a;
+    }
+    sum[0] = a;
+    sum[1] = b;
+}
+
+static
+int _xpost_image_write(FILE *f, unsigned int *sum, const void *p, size_t n)
+{
+    _xpost_image_sum(sum, p, n);
+    return fwrite(p, 1, n, f) == n;
+}
+
+static
+int _xpost_image_read(FILE *f, unsigned int *sum, void *p, size_t n)
+{
+    if (fread(p, 1, n, f) != n)
+        return 0;
+    _xpost_image_sum(sum, p, n);
+    return 1;
+}
+
+/* fill the parts of the header that identify this library and init.ps */
+static
+int _xpost_image_header(Xpost_Image_Header *h, Xpost_Context *ctx, const char *initps)
+{
+    struct stat sb;
+
+    memset(h, 0, sizeof *h);
+    memcpy(h->magic, XPOST_IMAGE_MAGIC, sizeof h->magic);
+    h->format = XPOST_IMAGE_FORMAT;
+    xpost_version_get(&h->version[0], &h->version[1], &h->version[2]);
+    h->sizes[0] = sizeof(void *);
+    h->sizes[1] = sizeof(Xpost_Object);
+    h->sizes[2] = sizeof *ctx->lo->table.tab;
+    h->sizes[3] = sizeof(Xpost_Context);
+    h->sizes[4] = (unsigned int)xpost_memory_page_size;
+    h->cid = ctx->id;
+    if (strlen(initps) >= sizeof h->initps || stat(initps, &sb) != 0)
+    {
+        XPOST_LOG_ERR("cannot stat %s", initps);
+        return 0;
+    }
+    strcpy(h->initps, initps);
+    h->initps_size = (long)sb.st_size;
+    h->initps_mtime = (long)sb.st_mtime;
+    return 1;
+}
+
+/* check that mem can be saved: no saves, no open files */
+static
+int _xpost_image_check_memory(Xpost_Memory_File *mem)
+{
+    unsigned int vs;
+    unsigned int i;
+
+    xpost_memory_table_get_addr(mem, XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
+    if (xpost_stack_count(mem, vs) != 0)
+    {
+        XPOST_LOG_ERR("cannot write an image with a save in effect");
+        return 0;
+    }
+    for (i = mem->start; i < mem->table.nextent; i++)
+    {
+        Xpost_Object f;
+
+        if (mem->table.tab[i].tag != filetype || mem->table.tab[i].sz == 0)
+            continue;
+        f.tag = filetype;
+        f.mark_.padw = i;
+        if (xpost_file_get_file_pointer(mem, f))
+        {
+            XPOST_LOG_ERR("cannot write an image with file %u open", i);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static
+int _xpost_image_save_table(FILE *f, unsigned int *sum, Xpost_Memory_File *mem)
+{
+    Xpost_Image_Memory m;
+
+    memset(&m, 0, sizeof m);
+    m.used = mem->used;
+    m.start = mem->start;
+    m.compact = mem->compact;
+    m.threshold = mem->threshold;
+    m.vmthreshold = mem->vmthreshold;
+    m.autocollect = mem->autocollect;
+    m.minor = mem->minor;
+    m.nextent = mem->table.nextent;
+    m.tabmax = mem->table.max;
+    return _xpost_image_write(f, sum, &m, sizeof m)
+        && _xpost_image_write(f, sum, mem->table.tab, m.nextent * sizeof *mem->table.tab);
+}
+
+/* round n up to a page */
+static
+size_t _xpost_image_round(size_t n)
+{
+    return (n + xpost_memory_page_size - 1)
+        / xpost_memory_page_size * xpost_memory_page_size;
+}
+
+/* create a new file next to filename, its name in tmpname */
+static
+FILE *_xpost_image_create(const char *filename, char *tmpname, size_t size)
+{
+#ifndef _WIN32
+    FILE *f;
+    int fd;
+#endif
+
+    if (strlen(filename) + sizeof ".XXXXXX" > size)
+        return NULL;
+    strcpy(tmpname, filename);
+    strcat(tmpname, ".XXXXXX");
+#ifdef _WIN32
+    return _mktemp(tmpname) ? fopen(tmpname, "wb") : NULL;
+#else
+    fd = mkstemp(tmpname);
+    if (fd == -1)
+        return NULL;
+    f = fchmod(fd, 0644) == 0 ? fdopen(fd, "wb") : NULL;
+    if (!f)
+    {
+        close(fd);
+        remove(tmpname);
+    }
+    return f;
+#endif
+}
+
+/* write zeros up to the next page */
+static
+int _xpost_image_pad(FILE *f)
+{
+    long pos = ftell(f);
+
+    if (pos < 0)
+        return 0;
+    for ( ; pos % xpost_memory_page_size; pos++)
+        if (fputc(0, f) == EOF)
+            return 0;
+    return 1;
+}
+
+int xpost_image_save(Xpost_Context *ctx, const char *filename, const char *initps,
+                     const char *device)
+{
+    Xpost_Image_Header h;
+    Xpost_Image_Context c;
+    char tmpname[XPOST_PATH_MAX];
+    FILE *f;
+    int ret;
+
+    if (!_xpost_image_check_memory(ctx->lo) || !_xpost_image_check_memory(ctx->gl))
+        return 0;
+    if (!_xpost_image_header(&h, ctx, initps))
+        return 0;
+    if (strlen(device) >= sizeof h.device)
+    {
+        XPOST_LOG_ERR("device %s is too long for an image", device);
+        return 0;
+    }
+    strcpy(h.device, device);
+    h.nops = xpost_operator_count();
+
+    memset(&c, 0, sizeof c);
+    c.currentobject = ctx->currentobject;
+    c.event_handler = ctx->event_handler;
+    c.window_device = ctx->window_device;
+    c.os = ctx->os;
+    c.es = ctx->es;
+    c.ds = ctx->ds;
+    c.hold = ctx->hold;
+    c.cs = ctx->cs;
+    c.vmmode = ctx->vmmode;
+    c.state = ctx->state;
+    c.rand_next = ctx->rand_next;
+
+    /* processes may map the image being replaced, and see the
+       pages they have not touched yet change with it: write a new
+       file and rename it over the old one, which they keep */
+    f = _xpost_image_create(filename, tmpname, sizeof(tmpname));
+    if (!f)
+    {
+        XPOST_LOG_ERR("cannot create a file next to %s", filename);
+        return 0;
+    }
+    /* the header goes first, and again once the checksum is known */
+    ret = fwrite(&h, sizeof h, 1, f) == 1
+        && _xpost_image_write(f, h.sum, &c, sizeof c)
+        && _xpost_image_save_table(f, h.sum, ctx->lo)
+        && _xpost_image_save_table(f, h.sum, ctx->gl)
+        && _xpost_image_pad(f)
+        && fwrite(ctx->lo->base, 1, ctx->lo->used, f) == ctx->lo->used
+        && _xpost_image_pad(f)
+        && fwrite(ctx->gl->base, 1, ctx->gl->used, f) == ctx->gl->used
+        && _xpost_image_pad(f)
+        && fseek(f, 0, SEEK_SET) == 0
+        && fwrite(&h, sizeof h, 1, f) == 1;
+    if (fclose(f) != 0)
+        ret = 0;
+#ifdef _WIN32
+    if (ret)
+        remove(filename); /* rename() does not replace a file */
+#endif
+    if (!ret || rename(tmpname, filename) != 0)
+    {
+        XPOST_LOG_ERR("cannot write %s", filename);
+        remove(tmpname);
+        return 0;
+    }
+    XPOST_LOG_INFO("wrote image %s: local %u bytes, global %u bytes",
+                   filename, ctx->lo->used, ctx->gl->used);
+    return 1;
+}
+
+static
+int _xpost_image_load_table(FILE *f, unsigned int *sum, Xpost_Memory_File *mem,
+                            Xpost_Image_Memory *m)
+{
+    void *tab;
+
+    if (!_xpost_image_read(f, sum, m, sizeof *m))
+        return 0;
+    if (m->nextent > m->tabmax || m->start > m->nextent || m->used < 64)
+        return 0;
+    tab = malloc(m->tabmax * sizeof *mem->table.tab);
+    if (!tab)
+        return 0;
+    if (!_xpost_image_read(f, sum, tab, m->nextent * sizeof *mem->table.tab))
+    {
+        free(tab);
+        return 0;
+    }
+    free(mem->table.tab);
+    mem->table.tab = tab;
+    mem->table.nextent = m->nextent;
+    mem->table.max = m->tabmax;
+    return 1;
+}
+
+/* map the used bytes of mem from the page at *offset, or read them
+   if mem cannot map, and move *offset past them */
+static
+int _xpost_image_load_contents(FILE *f, size_t *offset, Xpost_Memory_File *mem,
+                               const Xpost_Image_Memory *m)
+{
+    unsigned int used = mem->used;
+
+    if (!xpost_memory_file_map_private(mem, fileno(f), *offset, m->used))
+    {
+        if (m->used >= mem->max
+            && !xpost_memory_file_grow(mem, m->used - mem->max))
+            return 0;
+        if (fseek(f, (long)*offset, SEEK_SET) != 0
+            || fread(mem->base, 1, m->used, f) != m->used)
+            return 0;
+    }
+    if (used > m->used) /* allocation expects zeros past the cursor */
+        memset(mem->base + m->used, 0, used - m->used);
+    mem->used = m->used;
+    mem->start = m->start;
+    mem->compact = m->compact;
+    mem->threshold = m->threshold;
+    mem->vmthreshold = m->vmthreshold;
+    mem->autocollect = m->autocollect;
+    mem->minor = m->minor;
+    *offset += _xpost_image_round(m->used);
+    return 1;
+}
+
+int xpost_image_load(Xpost_Context *ctx, const char *filename, const char *initps,
+                     const char *device)
+{
+    Xpost_Image_Header h;
+    Xpost_Image_Header here;
+    Xpost_Image_Context c;
+    Xpost_Image_Memory lo;
+    Xpost_Image_Memory gl;
+    unsigned int sum[2] = { 0, 0 };
+    struct stat sb;
+    size_t offset;
+    long pos;
+    FILE *f;
+    int ret;
+
+    if (!_xpost_image_header(&here, ctx, initps))
+        return 0;
+    f = fopen(filename, "rb");
+    if (!f)
+    {
+        XPOST_LOG_ERR("cannot open image %s", filename);
+        return 0;
+    }
+    if (fread(&h, sizeof h, 1, f) != 1
+        || memcmp(h.magic, here.magic, sizeof h.magic) != 0
+        || h.format != here.format)
+    {
+        XPOST_LOG_ERR("%s is not an image", filename);
+        fclose(f);
+        return 0;
+    }
+    if (memcmp(h.version, here.version, sizeof h.version) != 0
+        || memcmp(h.sizes, here.sizes, sizeof h.sizes) != 0
+        || h.cid != here.cid
+        || h.nops >= MAXOPS)
+    {
+        XPOST_LOG_ERR("image %s was made by another build", filename);
+        fclose(f);
+        return 0;
+    }
+    if (strcmp(h.initps, here.initps) != 0
+        || h.initps_size != here.initps_size
+        || h.initps_mtime != here.initps_mtime)
+    {
+        XPOST_LOG_ERR("image %s was made from another %s", filename, initps);
+        fclose(f);
+        return 0;
+    }
+
+    h.device[sizeof h.device - 1] = '\0';
+    if (h.device[0] && strcmp(h.device, device) != 0)
+    {
+        XPOST_LOG_ERR("image %s was made for device %s", filename, h.device);
+        fclose(f);
+        return 0;
+    }
+
+    ret = _xpost_image_read(f, sum, &c, sizeof c)
+        && _xpost_image_load_table(f, sum, ctx->lo, &lo)
+        && _xpost_image_load_table(f, sum, ctx->gl, &gl)
+        && sum[0] == h.sum[0] && sum[1] == h.sum[1]
+        && (pos = ftell(f)) > 0;
+    /* the contents must all be there before any is mapped */
+    if (ret)
+    {
+        offset = _xpost_image_round((size_t)pos);
+        ret = fstat(fileno(f), &sb) == 0
+            && (size_t)sb.st_size == offset
+               + _xpost_image_round(lo.used) + _xpost_image_round(gl.used)
+            && _xpost_image_load_contents(f, &offset, ctx->lo, &lo)
+            && _xpost_image_load_contents(f, &offset, ctx->gl, &gl);
+    }
+    fclose(f);
+    if (!ret)
+    {
+        XPOST_LOG_ERR("image %s is damaged", filename);
+        return 0;
+    }
+
+    ctx->currentobject = c.currentobject;
+    ctx->event_handler = c.event_handler;
+    ctx->window_device = c.window_device;
+    ctx->os = c.os;
+    ctx->es = c.es;
+    ctx->ds = c.ds;
+    ctx->hold = c.hold;
+    ctx->cs = c.cs;
+    ctx->vmmode = c.vmmode;
+    ctx->state = c.state;
+    ctx->rand_next = c.rand_next;
+
+    /* rebinding leans on the access checks that
+       initialization suspends, see xpost_oplib_rebind_ops */
+    ctx->gl->interpreter_set_initializing(0);
+    if (!xpost_oplib_rebind_ops(ctx, h.nops))
+    {
+        XPOST_LOG_ERR("image %s does not match the operators of this build", filename);
+        return 0;
+    }
+    XPOST_LOG_INFO("loaded image %s: local %u bytes, global %u bytes",
+                   filename, ctx->lo->used, ctx->gl->used);
+    return 1;
+}
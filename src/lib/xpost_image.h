@@ -0,0 +1,108 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef XPOST_IMAGE_H
+#define XPOST_IMAGE_H
+
+/**
+ *  @file xpost_image.h
+ *  @brief save and load the state of a newly created context.
+ *
+ *  An image holds the contents and tables of the local and global
+ *  memory files of a context as xpost_create() leaves them,
+ *  and the context's stacks and few scalars.
+ *  Loading an image into a fresh context replaces running
+ *  the operator initialization and init.ps.
+ *
+ *  Everything else a context needs is per process:
+ *  the function pointers in the operator signatures
+ *  and the names and opcodes cached by the operator modules.
+ *  Loading binds them by running the operator initialization
+ *  in rebind mode (see xpost_oplib_rebind_ops()), which also checks
+ *  that every signature in the image matches this library.
+ *
+ *  An image may also hold the graphics procedures and the device
+ *  of a context, when the device is one written in PostScript;
+ *  it then records the device it was made with and only loads
+ *  into a context created with the same one.
+ *
+ *  The memory contents start on page boundaries in the file and
+ *  are mapped copy-on-write into the reserved range of each memory
+ *  file, so loading reads only the pages a job touches.
+ *  Where mapping is not available they are read.
+ *
+ *  The image is also checked against the library version,
+ *  the sizes of the structures it holds, the init.ps it was
+ *  made from (path, size and time), and a checksum of everything
+ *  but the memory contents, which are only checked for their size.
+ *  A stale image is refused and the caller initializes as usual.
+ *
+ *  The image is written in the native byte order and layout;
+ *  it is meant to be made on the machine that uses it.
+ *
+ * @{
+ */
+
+/**
+ * @brief write the state of ctx to filename.
+ *
+ * ctx must be as xpost_create() left it:
+ * no saves and no open files.
+ * initps is the path of the init.ps file ctx was initialized with.
+ * device is the device ctx holds with its graphics,
+ * or "" if the graphics are not loaded.
+ * The image is written to a new file renamed over filename,
+ * so processes mapping an older image there keep it intact.
+ * Returns 1 on success, 0 on failure.
+ */
+int xpost_image_save(Xpost_Context *ctx, const char *filename, const char *initps,
+                     const char *device);
+
+/**
+ * @brief replace the memory files of a fresh context with an image.
+ *
+ * ctx must come straight from xpost_context_init().
+ * initps is the path of the init.ps file a normal
+ * initialization would load, device the device ctx is created with.
+ * An image holding a device is refused for any other device.
+ * Also rebinds the operators, which turns initialization off,
+ * as xpost_create() does before loading init.ps.
+ * Returns 1 on success, 0 if the image is missing,
+ * damaged or stale, leaving ctx to be destroyed.
+ */
+int xpost_image_load(Xpost_Context *ctx, const char *filename, const char *initps,
+                     const char *device);
+
+/**
+ * @}
+ */
+
+#endif
@@ -60,6 +60,9 @@
 #include "xpost_garbage.h"  /*  test gc, install collect() in context's memory files */
 #include "xpost_operator.h"  /* eval functions call operators */
 #include "xpost_oplib.h"
+#include "xpost_image.h"  /* create a context from an image */
+#include "xpost_op_control.h"  /* loop frames */
+#include "xpost_dev_generic.h"  /* name the output of a batch job */
 
 static
 Xpost_Object namedollarerror; /* cached result of xpost_name_cons(ctx, "$error")
@@ -73,6 +76,27 @@ static int _initializing = 1;  /* garbage collect does not run while _initializi
                                   for the gc to access this global without #include'ing interpreter.h
                                   which would create a circular dependency. */
 
+static const char *_xpost_interpreter_image = NULL;  /* image file for xpost_create, or NULL */
+static char _xpost_interpreter_device[64];  /* device of xpost_create an image can hold, or "" */
+
+/* the devices: name, operator loading it (none for the devices
+   written in PostScript, which live in vm), constructor */
+static const char *device_strings[][3] =
+{
+    { "pgm",     "",                 "newPGMIMAGEdevice" },
+    { "ppm",     "",                 "newPPMIMAGEdevice" },
+    { "null",    "",                 "newnulldevice"     },
+    { "xcb",     "loadxcbdevice",    "newxcbdevice"      },
+    { "gdi",     "loadwin32device",  "newwin32device"    },
+    { "gl",      "loadwin32device",  "newwin32device"    },
+    { "bgr",     "loadbgrdevice",    "newbgrdevice"      },
+    { "raster",  "loadrasterdevice", "newrasterdevice"   },
+    { "pdfwrite","",                 "newPDFWRITEdevice" },
+    { "png",     "loadpngdevice",    "newpngdevice"      },
+    { "jpeg",    "loadjpegdevice",   "newjpegdevice"      },
+    { NULL, NULL, NULL }
+};
+
 int eval(Xpost_Context *ctx);
 int mainloop(Xpost_Context *ctx);
 void init(void);
@@ -331,25 +355,40 @@ int evalpush(Xpost_Context *ctx)
     return 0;
 }
 
-/* load executable name */
+/* load executable name, already removed from es */
 static
-int evalload(Xpost_Context *ctx)
+int _eval_name(Xpost_Context *ctx, Xpost_Object name)
 {
     int ret;
-    if (_xpost_interpreter_is_tracing)
+    Xpost_Object value;
+    unsigned int generation;
+
+    if (xpost_context_name_cache_get(ctx, name, &value))
     {
-        Xpost_Object s = xpost_name_get_string(ctx, xpost_stack_topdown_fetch(ctx->lo, ctx->es, 0));
-        XPOST_LOG_DUMP("evalload <name \"%*s\">", s.comp_.sz, xpost_string_get_pointer(ctx, s));
+        if (xpost_object_is_exe(value))
+        {
+            if (!xpost_stack_push(ctx->lo, ctx->es, value))
+                return execstackoverflow;
+        }
+        else
+        {
+            if (!xpost_stack_push(ctx->lo, ctx->os, value))
+                return stackoverflow;
+        }
+        return 0;
     }
 
-    if (!xpost_stack_push(ctx->lo, ctx->os,
-            xpost_stack_pop(ctx->lo, ctx->es)))
+    if (!xpost_stack_push(ctx->lo, ctx->os, name))
         return stackoverflow;
     assert(ctx->gl->base);
+    generation = ctx->name_cache.generation;
     /*xpost_operator_exec(ctx, xpost_operator_cons(ctx, "load", NULL,0,0).mark_.padw); */
     ret = xpost_operator_exec(ctx, ctx->opcode_shortcuts.load);
     if (ret)
         return ret;
+    xpost_context_name_cache_put(ctx, name,
+                                 xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0),
+                                 generation);
     if (xpost_object_is_exe(xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0)))
     {
         Xpost_Object q;
@@ -362,6 +401,19 @@ int evalload(Xpost_Context *ctx)
     return 0;
 }
 
+/* load executable name */
+static
+int evalload(Xpost_Context *ctx)
+{
+    if (_xpost_interpreter_is_tracing)
+    {
+        Xpost_Object s = xpost_name_get_string(ctx, xpost_stack_topdown_fetch(ctx->lo, ctx->es, 0));
+        XPOST_LOG_DUMP("evalload <name \"%*s\">", s.comp_.sz, xpost_string_get_pointer(ctx, s));
+    }
+
+    return _eval_name(ctx, xpost_stack_pop(ctx->lo, ctx->es));
+}
+
 /* execute operator */
 static
 int evaloperator(Xpost_Context *ctx)
@@ -537,11 +589,16 @@ void initevaltype(void)
    underlying Window System, process one or more of them,
    and then return 0.
    it should leave all stacks undisturbed.
+   between objects no vm address is held,
+   so this is also where fragmented vm is compacted.
  */
 int idleproc (Xpost_Context *ctx)
 {
     int ret;
 
+    (void) xpost_garbage_compact(ctx->lo);
+    (void) xpost_garbage_compact(ctx->gl);
+
     if ((xpost_object_get_type(ctx->event_handler) == operatortype) &&
         (xpost_object_get_type(ctx->window_device) == dicttype))
     {
@@ -650,6 +707,246 @@ int eval(Xpost_Context *ctx)
     return ret;
 }
 
+/*
+   number of objects executed by _eval_run() between calls
+   to idleproc(). larger values cost the window device
+   some responsiveness.
+ */
+#define XPOST_INTERPRETER_IDLE_BUDGET 1024
+
+/*
+   dispatch on object type to the labels in _eval_run(),
+   with computed goto where the compiler supports it.
+ */
+#ifdef __GNUC__
+# define AS_EVALLABEL(_) __extension__ && eval_ ## _ ,
+# define EVAL_DISPATCH(type) __extension__ ({ goto *evaljump[type]; })
+#else
+# define AS_EVALCASE(_) case _ ## type : goto eval_ ## _ ;
+# define EVAL_DISPATCH(type) \
+    switch (type) { XPOST_OBJECT_TYPES(AS_EVALCASE) default: goto eval_invalid; }
+#endif
+
+/*
+   take or skip a jump in a compiled proc (see compile),
+   whose remainder is on top of es, starting at the count.
+   returns 0 without changing anything if the operands are
+   not as expected, so that the operator may report the error.
+ */
+static
+int _eval_jump(Xpost_Context *ctx,
+               int conditional)
+{
+    Xpost_Stack *os = (Xpost_Stack *)(ctx->lo->base + ctx->os);
+    Xpost_Stack *es = (Xpost_Stack *)(ctx->lo->base + ctx->es);
+    Xpost_Object *c;
+    Xpost_Object n;
+    integer skip = 1;
+
+    if (es->top == 0)
+        return 0;
+    c = &XPOST_STACK_DATA(ctx->lo, es)[es->top - 1];
+    if ((c->tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) != arraytype || c->comp_.sz == 0)
+        return 0;
+    n = xpost_array_get(ctx, *c, 0);
+    if ((n.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) != integertype)
+        return 0;
+    if (conditional)
+    {
+        Xpost_Object b;
+
+        if (os->top == 0)
+            return 0;
+        b = XPOST_STACK_DATA(ctx->lo, os)[os->top - 1];
+        if ((b.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK) != booleantype)
+            return 0;
+        if (!b.int_.val)
+            skip += n.int_.val;
+    }
+    else
+        skip += n.int_.val;
+    if (skip < 1 || skip > c->comp_.sz)
+        return 0;
+
+    if (conditional)
+        --os->top;
+    if (skip == c->comp_.sz)
+        --es->top;
+    else
+    {
+        c->comp_.off += skip;
+        c->comp_.sz -= skip;
+    }
+    return 1;
+}
+
+/*
+   the central loop for the non-tracing case.
+   executes objects from es until an operator returns an error code,
+   ctx->quit is set, or tracing is switched on.
+   a procedure on top of es is used as a cursor: its head is removed
+   in place, and a head name or operator is executed directly
+   instead of taking a trip through es. jumps in compiled procs
+   move the cursor.
+   events are polled every XPOST_INTERPRETER_IDLE_BUDGET objects.
+ */
+static
+int _eval_run(Xpost_Context *ctx)
+{
+#ifdef __GNUC__
+    static const void *const evaljump[XPOST_OBJECT_NTYPES] = {
+        XPOST_OBJECT_TYPES(AS_EVALLABEL)
+    };
+#endif
+    Xpost_Stack *es;
+    Xpost_Object t;
+    unsigned int type;
+    int budget = XPOST_INTERPRETER_IDLE_BUDGET;
+    int ret;
+
+    if (!validate_context(ctx))
+        return unregistered;
+
+next:
+    if (ctx->quit || _xpost_interpreter_is_tracing)
+        return 0;
+    if (--budget == 0)
+    {
+        budget = XPOST_INTERPRETER_IDLE_BUDGET;
+        ret = idleproc(ctx);
+        if (ret)
+            return ret;
+    }
+
+    es = (Xpost_Stack *)(ctx->lo->base + ctx->es);
+    if (es->top == 0)
+        return unregistered;
+    t = XPOST_STACK_DATA(ctx->lo, es)[es->top - 1];
+    ctx->currentobject = t;
+    type = t.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK;
+    if (type >= XPOST_OBJECT_NTYPES)
+        return unregistered;
+    if (t.tag & XPOST_OBJECT_TAG_DATA_FLAG_LIT)
+        goto eval_push;
+    EVAL_DISPATCH(type);
+
+eval_invalid:
+    return unregistered;
+
+eval_extended:
+eval_magic:
+    ++ctx->quit;
+    goto next;
+
+eval_null:
+    --es->top;
+    goto next;
+
+eval_mark:
+eval_integer:
+eval_real:
+eval_dict:
+eval_save:
+eval_boolean:
+eval_context:
+eval_glob:
+eval_push:
+    --es->top;
+    if (!xpost_stack_push(ctx->lo, ctx->os, t))
+        return stackoverflow;
+    goto next;
+
+eval_operator:
+    if (t.mark_.padw == (dword)ctx->opcode_shortcuts.contfor
+            || t.mark_.padw == (dword)ctx->opcode_shortcuts.contrepeat
+            || t.mark_.padw == (dword)ctx->opcode_shortcuts.contforall
+            || t.mark_.padw == (dword)ctx->opcode_shortcuts.contloop)
+    {
+        /* next iteration of the loop frame, which stays in place */
+        ret = xpost_op_control_loop_step(ctx);
+        if (ret)
+            return ret;
+        goto next;
+    }
+    --es->top;
+    ret = xpost_operator_exec(ctx, t.mark_.padw);
+    if (ret)
+        return ret;
+    goto next;
+
+eval_name:
+    --es->top;
+    ret = _eval_name(ctx, t);
+    if (ret)
+        return ret;
+    goto next;
+
+eval_string:
+    ret = evalstring(ctx);
+    if (ret)
+        return ret;
+    goto next;
+
+eval_file:
+    ret = evalfile(ctx);
+    if (ret)
+        return ret;
+    goto next;
+
+eval_array:
+    {
+        Xpost_Object b;
+
+        if (t.comp_.sz == 0)
+        {
+            --es->top;
+            goto next;
+        }
+        b = xpost_array_get(ctx, t, 0);
+        if (t.comp_.sz == 1)
+            --es->top;
+        else
+        {
+            ++t.comp_.off;
+            --t.comp_.sz;
+            XPOST_STACK_DATA(ctx->lo, es)[es->top - 1] = t;
+        }
+
+        type = b.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK;
+        if (type == arraytype || (b.tag & XPOST_OBJECT_TAG_DATA_FLAG_LIT))
+        {
+            if (!xpost_stack_push(ctx->lo, ctx->os, b))
+                return stackoverflow;
+        }
+        else if (type == operatortype)
+        {
+            ctx->currentobject = b;
+            if (b.mark_.padw == (dword)ctx->opcode_shortcuts.jumpunless
+                    && _eval_jump(ctx, 1))
+                goto next;
+            if (b.mark_.padw == (dword)ctx->opcode_shortcuts.jump
+                    && _eval_jump(ctx, 0))
+                goto next;
+            ret = xpost_operator_exec(ctx, b.mark_.padw);
+            if (ret)
+                return ret;
+        }
+        else if (type == nametype)
+        {
+            ctx->currentobject = b;
+            ret = _eval_name(ctx, b);
+            if (ret)
+                return ret;
+        }
+        else
+        {
+            if (!xpost_stack_push(ctx->lo, ctx->es, b))
+                return execstackoverflow;
+        }
+    }
+    goto next;
+}
+
 /* called by mainloop() after propagated error codes.
    pushes postscript-level error procedures
    and resumes normal execution.
@@ -802,15 +1099,25 @@ Xpost_Context *_switch_context(Xpost_Context *ctx)
  */
 int mainloop(Xpost_Context *ctx)
 {
+    Xpost_Context *next;
     int ret;
 
 ctxswitch:
-    xpost_ctx = ctx = _switch_context(ctx);
+    next = _switch_context(ctx);
+    if (next != ctx)
+    {
+        /* other contexts may have changed dicts in shared vm */
+        xpost_context_name_cache_flush(next);
+    }
+    xpost_ctx = ctx = next;
     itpdata->cid = ctx->id;
 
     while(!ctx->quit)
     {
-        ret = eval(ctx);
+        if (_xpost_interpreter_is_tracing)
+            ret = eval(ctx);
+        else
+            ret = _eval_run(ctx);
         if (ret)
             switch (ret)
             {
@@ -914,21 +1221,6 @@ void setlocalconfig(Xpost_Context *ctx,
                     int width,
                     int height)
 {
-    const char *device_strings[][3] =
-    {
-        { "pgm",     "",                 "newPGMIMAGEdevice" },
-        { "ppm",     "",                 "newPPMIMAGEdevice" },
-        { "null",    "",                 "newnulldevice"     },
-        { "xcb",     "loadxcbdevice",    "newxcbdevice"      },
-        { "gdi",     "loadwin32device",  "newwin32device"    },
-        { "gl",      "loadwin32device",  "newwin32device"    },
-        { "bgr",     "loadbgrdevice",    "newbgrdevice"      },
-        { "raster",  "loadrasterdevice", "newrasterdevice"   },
-        { "pdfwrite","",                 "newPDFWRITEdevice" },
-        { "png",     "loadpngdevice",    "newpngdevice"      },
-        { "jpeg",    "loadjpegdevice",   "newjpegdevice"      },
-        { NULL, NULL, NULL }
-    };
     const char *strtemplate = "currentglobal false setglobal "
                         "%s userdict /DEVICE %s %s put "
                         "setglobal";
@@ -1010,31 +1302,83 @@ void setlocalconfig(Xpost_Context *ctx,
 }
 
 /*
-   load init.ps (which also loads err.ps) while systemdict is writeable
-   ignore invalidaccess errors.
+   describe the device setlocalconfig makes as "name[:mode] width height"
+   into buf, if it is written in PostScript and so can be held by an image.
+   otherwise, or if buf is too small, leave buf empty.
  */
 static
-void loadinitps(Xpost_Context *ctx)
+void deviceconfig(char *buf,
+                  size_t size,
+                  const char *device,
+                  Xpost_Set_Size set_size,
+                  int width,
+                  int height)
+{
+    size_t len;
+    int i;
+    int ret;
+
+    buf[0] = '\0';
+    len = strcspn(device, ":");
+    for (i = 0; device_strings[i][0]; i++)
+    {
+        if (strlen(device_strings[i][0]) == len
+            && strncmp(device, device_strings[i][0], len) == 0)
+            break;
+    }
+    if (!device_strings[i][0] || device_strings[i][1][0])
+        return;
+    if (set_size != XPOST_USE_SIZE)
+    {
+        width = 612;
+        height = 792;
+    }
+    ret = snprintf(buf, size, "%s %d %d", device, width, height);
+    if (ret < 0 || (size_t)ret >= size)
+        buf[0] = '\0';
+}
+
+/*
+   remove the definitions made by setlocalconfig and the QUIET flag,
+   so a context loaded from an image can be configured anew.
+ */
+static
+void clearlocalconfig(Xpost_Context *ctx,
+                      Xpost_Object sd)
+{
+    const char *names[] =
+    {
+        "newdefaultdevice", "ShowpageSemantics", "SUBDEVICE",
+        "OutputFileName", "OutputBufferIn", "OutputBufferOut", "QUIET",
+        NULL
+    };
+    int i;
+
+    ctx->vmmode = GLOBAL;
+    for (i = 0; names[i]; i++)
+    {
+        xpost_dict_undef(ctx, sd, xpost_name_cons(ctx, names[i]));
+    }
+    ctx->vmmode = LOCAL;
+}
+
+/*
+   find init.ps, writing its path into path_init_ps.
+   return the directory it was found in, or NULL.
+ */
+static
+char *findinitps(char *path_init_ps, size_t size)
 {
-    char buf[1024];
-    char path_init_ps[XPOST_PATH_MAX];
     struct stat statbuf;
-    char *path_init;
     char *path;
-    int n;
-
-    assert(ctx->gl->base);
-    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
-    ctx->ignoreinvalidaccess = 1;
 
 #define XPOST_PATH_INIT \
     do \
     { \
-        snprintf(path_init_ps, sizeof(path_init_ps), "%s/init.ps", path); \
+        snprintf(path_init_ps, size, "%s/init.ps", path); \
         if (stat(path_init_ps, &statbuf) == 0) \
         { \
-            path_init = path; \
-            goto load_init_ps; \
+            return path; \
         } \
         else \
             XPOST_LOG_DBG("init.ps not present in", path_init_ps); \
@@ -1076,9 +1420,32 @@ void loadinitps(Xpost_Context *ctx)
 
     XPOST_LOG_ERR("init.ps can not be found");
 
-    return;
+    return NULL;
+}
+
+/*
+   load init.ps (which also loads err.ps) while systemdict is writeable
+   ignore invalidaccess errors.
+ */
+static
+void loadinitps(Xpost_Context *ctx)
+{
+    char buf[1024];
+    char path_init_ps[XPOST_PATH_MAX];
+    char *path_init;
+#ifdef _WIN32
+    char *path;
+#endif
+    int n;
+
+    assert(ctx->gl->base);
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
+    ctx->ignoreinvalidaccess = 1;
+
+    path_init = findinitps(path_init_ps, sizeof(path_init_ps));
+    if (!path_init)
+        return;
 
-  load_init_ps:
     /* backslashes are not supported in path because they are inserted in
     * PostScript files, and PostScript */
 #ifdef _WIN32
@@ -1099,6 +1466,69 @@ void loadinitps(Xpost_Context *ctx)
 }
 
 
+/*
+   allocate global itpdata and its first context as initalldata does,
+   but fill the context's memory files from an image
+   instead of initializing them.
+   return 1 on success, 0 on failure, with nothing left allocated
+ */
+static
+int initimagedata(const char *device, const char *image)
+{
+    char path_init_ps[XPOST_PATH_MAX];
+    Xpost_Context *ctx;
+    int ret;
+
+    if (!findinitps(path_init_ps, sizeof(path_init_ps)))
+        return 0;
+
+    initevaltype();
+    xpost_object_install_dict_get_access(xpost_dict_get_access);
+    xpost_object_install_dict_set_access(xpost_dict_set_access);
+
+    null = xpost_object_cvlit(null);
+    itpdata = malloc(sizeof*itpdata);
+    if (!itpdata)
+    {
+        XPOST_LOG_ERR("itpdata=malloc failed");
+        return 0;
+    }
+    memset(itpdata, 0, sizeof*itpdata);
+
+    ctx = &itpdata->ctab[0];
+    ret = xpost_context_init(ctx,
+                             xpost_interpreter_cid_init,
+                             xpost_interpreter_cid_get_context,
+                             xpost_interpreter_get_initializing,
+                             xpost_interpreter_set_initializing,
+                             xpost_interpreter_alloc_local_memory,
+                             xpost_interpreter_alloc_global_memory,
+                             xpost_garbage_collect);
+    if (ret && !xpost_image_load(ctx, image, path_init_ps, _xpost_interpreter_device))
+    {
+        free(ctx->lo->table.tab);
+        free(ctx->gl->table.tab);
+        xpost_context_exit(ctx);
+        ret = 0;
+    }
+    if (!ret)
+    {
+        free(itpdata);
+        itpdata = NULL;
+        nextid = 0;
+        xpost_interpreter_set_initializing(1);
+        return 0;
+    }
+
+    namedollarerror = xpost_name_cons(ctx, "$error");
+    nameerrordict = xpost_name_cons(ctx, "errordict");
+    ctx->device_str = device;
+    itpdata->cid = ctx->id;
+    xpost_ctx = ctx;
+
+    return 1;
+}
+
 /* copy userdict names to systemdict
     Problem: This is clearly an invalidaccess,
     and yet is required by the PLRM. Discussion:
@@ -1192,6 +1622,29 @@ XPAPI Xpost_Context *xpost_create(const char *device,
 
     nextid = 0; /*reset process counter */
 
+    deviceconfig(_xpost_interpreter_device, sizeof(_xpost_interpreter_device),
+                 device, set_size, width, height);
+
+    /* Start from the image, if there is one that fits,
+       and configure it as setlocalconfig would before init.ps. */
+    if (_xpost_interpreter_image && initimagedata(device, _xpost_interpreter_image))
+    {
+        sd = xpost_stack_bottomup_fetch(xpost_ctx->lo, xpost_ctx->ds, 0);
+        xpost_interpreter_set_initializing(1);
+        clearlocalconfig(xpost_ctx, sd);
+        setlocalconfig(xpost_ctx, sd,
+                       device, outfile, bufferin, bufferout,
+                       semantics, set_size, width, height);
+        if (quiet)
+        {
+            xpost_dict_put(xpost_ctx, sd,
+                           xpost_name_cons(xpost_ctx, "QUIET"),
+                           null);
+        }
+        xpost_interpreter_set_initializing(0);
+        return xpost_ctx;
+    }
+
     /* Allocate and initialize all interpreter data structures. */
     ret = initalldata(device);
     if (!ret)
@@ -1242,6 +1695,11 @@ XPAPI Xpost_Context *xpost_create(const char *device,
     return xpost_ctx;
 }
 
+XPAPI void xpost_image_use(const char *filename)
+{
+    _xpost_interpreter_image = filename;
+}
+
 static
 Xpost_Object get_token(Xpost_Context *ctx, char *str){
     Xpost_Object o;
@@ -1288,11 +1746,125 @@ XPAPI int xpost_add_definitions(Xpost_Context *ctx, int cnt, char *defs[])
     return 1;
 }
 
+XPAPI int xpost_output_file_set(Xpost_Context *ctx, const char *filename)
+{
+    Xpost_Object sd;
+    Xpost_Object str;
+    unsigned int vmmode;
+    int ret;
+
+    if (!ctx || !filename) return 0;
+
+    sd = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0);
+    vmmode = ctx->vmmode;
+    ctx->vmmode = GLOBAL;
+    str = xpost_string_cons(ctx, strlen(filename), filename);
+    ret = xpost_object_get_type(str) == stringtype;
+    if (ret)
+    {
+        xpost_interpreter_set_initializing(1);
+        ret = !xpost_dict_put(ctx, sd,
+                              xpost_name_cons(ctx, "OutputFileName"),
+                              xpost_object_cvlit(str));
+        xpost_interpreter_set_initializing(0);
+    }
+    ctx->vmmode = vmmode;
+    return ret;
+}
+
+/* execute a procedure to completion, with quit beneath it */
+static
+void execproc(Xpost_Context *ctx, Xpost_Object proc)
+{
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
+    xpost_stack_push(ctx->lo, ctx->es, proc);
+
+    ctx->quit = 0;
+    mainloop(ctx);
+}
+
+/* the device dict from userdict, calling DEVICE if it is a procedure */
+static
+Xpost_Object currentdevice(Xpost_Context *ctx)
+{
+    Xpost_Object device;
+
+    device = xpost_dict_get(ctx,
+            xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
+            xpost_name_cons(ctx, "DEVICE"));
+    XPOST_LOG_INFO("device type=%s", xpost_object_type_names[xpost_object_get_type(device)]);
+    /*xpost_operator_dump(ctx, 1); // is this pointer value constant? */
+    if (xpost_object_get_type(device) == arraytype){
+        XPOST_LOG_INFO("running proc");
+        execproc(ctx, device);
+
+        device = xpost_stack_pop(ctx->lo, ctx->os);
+    }
+    return device;
+}
+
+static
+void destroydevice(Xpost_Context *ctx)
+{
+    Xpost_Object device;
+
+    XPOST_LOG_INFO("destroying device");
+    device = currentdevice(ctx);
+    if (xpost_object_get_type(device) == dicttype)
+    {
+        Xpost_Object Destroy;
+        XPOST_LOG_INFO("destroying device dict");
+        Destroy = xpost_dict_get(ctx, device, xpost_name_cons(ctx, "Destroy"));
+        if (xpost_object_get_type(Destroy) == operatortype)
+        {
+            int res;
+            xpost_stack_push(ctx->lo, ctx->os, device);
+            res = xpost_operator_exec(ctx, Destroy.mark_.padw);
+            if (res)
+                XPOST_LOG_ERR("%s error destroying device", errorname[res]);
+            else
+                XPOST_LOG_INFO("destroyed device");
+        }
+	if (xpost_object_get_type(Destroy) == arraytype)
+	{
+	    XPOST_LOG_INFO("running Destroy proc");
+	    xpost_stack_push(ctx->lo, ctx->os, device);
+	    execproc(ctx, Destroy);
+	}
+    }
+}
+
+/*
+   give the device the output file name of systemdict, or none,
+   as it would have had if it were made by this job.
+ */
+static
+void syncoutputfile(Xpost_Context *ctx)
+{
+    Xpost_Object device;
+    Xpost_Object name;
+    Xpost_Object outfile;
+
+    device = currentdevice(ctx);
+    if (xpost_object_get_type(device) != dicttype)
+        return;
+    name = xpost_name_cons(ctx, "OutputFileName");
+    outfile = xpost_dict_get(ctx,
+                             xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0),
+                             name);
+    if (xpost_object_get_type(outfile) == stringtype)
+        xpost_dict_put(ctx, device, name, outfile);
+    else
+        xpost_dict_undef(ctx, device, name);
+}
+
 /*
    execute ps program until quit, fall-through to quit,
    SHOWPAGE_RETURN semantic, or error (default action: message, purge and quit).
+   keepdevice leaves the device alive for the next job of a batch.
  */
-XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr, size_t set_size)
+static
+int runjob(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr, size_t set_size, int keepdevice)
 {
     Xpost_Object lsav = null;
     int llev = 0;
@@ -1301,7 +1873,6 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
     const char *ps_file = NULL;
     const FILE *ps_file_ptr = NULL;
     int ret;
-    Xpost_Object device;
     Xpost_Object semantic;
 
     switch(input_type)
@@ -1311,12 +1882,8 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
             break;
         case XPOST_INPUT_STRING:
             ps_str = inputptr;
-            ps_file_ptr = tmpfile();
-            if (set_size)
-                fwrite(ps_str, 1, set_size, (FILE*)ps_file_ptr);
-            else
-                fwrite(ps_str, 1, strlen(ps_str), (FILE*)ps_file_ptr);
-            rewind((FILE*)ps_file_ptr);
+            if (!set_size)
+                set_size = strlen(ps_str);
             break;
         case XPOST_INPUT_FILEPTR:
             ps_file_ptr = inputptr;
@@ -1325,6 +1892,14 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
             goto run;
     }
 
+    /* graphics loaded from an image come with a device
+       made before this context's output file was set */
+    if (!keepdevice
+        && xpost_dict_known_key(ctx, ctx->lo,
+                                xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
+                                xpost_name_cons(ctx, "GRAPHICS_LOADED")))
+        syncoutputfile(ctx);
+
     /* prime the exec stack
        so it starts with a 'start*' procedure,
        and if it ever gets to the bottom, it quits.
@@ -1343,10 +1918,22 @@ XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void
     */
     if (ps_file)
     {
+        Xpost_Object f;
+
         /*printf("ps_file\n"); */
-        xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvlit(xpost_string_cons(ctx, strlen(ps_file), ps_file)));
+        /* map the file so the scanner reads it in place,
+           otherwise let startfilename open (and report on) the name */
+        if (xpost_file_open_mapped(ctx->lo, ps_file, &f) == 0)
+            xpost_stack_push(ctx->lo, ctx->os, f);
+        else
+            xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvlit(xpost_string_cons(ctx, strlen(ps_file), ps_file)));
         xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "startfilename")));
     }
+    else if (ps_str)
+    {
+        xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvlit(xpost_file_cons_mapped(ctx->lo, (const unsigned char *)ps_str, set_size)));
+        xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvx(xpost_name_cons(ctx, "startfile")));
+    }
     else if (ps_file_ptr)
     {
         xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvlit(xpost_file_cons(ctx->lo, ps_file_ptr)));
@@ -1375,47 +1962,8 @@ run:
     if (semantic.int_.val == XPOST_SHOWPAGE_RETURN)
         return ret == 1 ? yieldtocaller : 0;
 
-    XPOST_LOG_INFO("destroying device");
-    device = xpost_dict_get(ctx,
-            xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
-            xpost_name_cons(ctx, "DEVICE"));
-    XPOST_LOG_INFO("device type=%s", xpost_object_type_names[xpost_object_get_type(device)]);
-    /*xpost_operator_dump(ctx, 1); // is this pointer value constant? */
-    if (xpost_object_get_type(device) == arraytype){
-        XPOST_LOG_INFO("running proc");
-        xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "quit", NULL,0,0));
-        xpost_stack_push(ctx->lo, ctx->es, device);
-
-        ctx->quit = 0;
-        mainloop(ctx);
-
-        device = xpost_stack_pop(ctx->lo, ctx->os);
-    }
-    if (xpost_object_get_type(device) == dicttype)
-    {
-        Xpost_Object Destroy;
-        XPOST_LOG_INFO("destroying device dict");
-        Destroy = xpost_dict_get(ctx, device, xpost_name_cons(ctx, "Destroy"));
-        if (xpost_object_get_type(Destroy) == operatortype)
-        {
-            int res;
-            xpost_stack_push(ctx->lo, ctx->os, device);
-            res = xpost_operator_exec(ctx, Destroy.mark_.padw);
-            if (res)
-                XPOST_LOG_ERR("%s error destroying device", errorname[res]);
-            else
-                XPOST_LOG_INFO("destroyed device");
-        }
-	if (xpost_object_get_type(Destroy) == arraytype)
-	{
-	    XPOST_LOG_INFO("running Destroy proc");
-	    xpost_stack_push(ctx->lo, ctx->os, device);
-	    xpost_stack_push(ctx->lo, ctx->es, Destroy);
-
-	    ctx->quit = 0;
-	    mainloop(ctx);
-	}
-    }
+    if (!keepdevice)
+        destroydevice(ctx);
 
     xpost_save_restore_snapshot(ctx->gl);
     xpost_memory_table_get_addr(ctx->lo,
@@ -1430,9 +1978,142 @@ run:
         }
     }
 
+    /* leave the stacks as the next job expects them,
+       whatever this one left behind */
+    xpost_stack_clear(ctx->lo, ctx->os);
+    xpost_stack_clear(ctx->lo, ctx->es);
+    llev = xpost_stack_count(ctx->lo, ctx->ds);
+    if (llev > 3)
+        (void)xpost_stack_pop_n(ctx->lo, ctx->ds, llev - 3);
+    xpost_context_name_cache_flush(ctx);
+
     return noerror;
 }
 
+XPAPI int xpost_run(Xpost_Context *ctx, Xpost_Input_Type input_type, const void *inputptr, size_t set_size)
+{
+    return runjob(ctx, input_type, inputptr, set_size, 0);
+}
+
+/* accept only a template with a single integer conversion, like out%04d.png */
+static
+int checktemplate(const char *template)
+{
+    int conversions = 0;
+    const char *p;
+
+    for (p = strchr(template, '%'); p; p = strchr(p, '%'))
+    {
+        ++p;
+        if (*p == '%')
+        {
+            ++p;
+            continue;
+        }
+        p += strspn(p, "0-+ #");
+        p += strspn(p, "0123456789");
+        if (*p != 'd' && *p != 'i' && *p != 'u')
+            return 0;
+        ++conversions;
+    }
+    return conversions == 1;
+}
+
+XPAPI int xpost_run_batch(Xpost_Context *ctx, int cnt, const char *files[], const char *output_template)
+{
+    Xpost_Object device;
+    char filename[XPOST_PATH_MAX];
+    int ret;
+    int i;
+
+    if (!ctx || cnt < 1 || !files) return 0;
+    if (output_template && !checktemplate(output_template))
+    {
+        XPOST_LOG_ERR("output template %s needs a single integer conversion",
+                      output_template);
+        return 0;
+    }
+
+    /* load graphics and create the device before any job's save,
+       so the restore ending each job leaves them for the next */
+    execproc(ctx, xpost_object_cvx(xpost_name_cons(ctx, "loadgraphics")));
+    if (!xpost_dict_known_key(ctx, ctx->lo,
+                              xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
+                              xpost_name_cons(ctx, "GRAPHICS_LOADED")))
+    {
+        XPOST_LOG_ERR("unable to load graphics");
+        return 0;
+    }
+    xpost_stack_clear(ctx->lo, ctx->os);
+    xpost_stack_clear(ctx->lo, ctx->es);
+    device = currentdevice(ctx);
+
+    for (i = 0; i < cnt; i++)
+    {
+        if (output_template && xpost_object_get_type(device) == dicttype)
+        {
+            ret = snprintf(filename, sizeof(filename), output_template, i + 1);
+            if (ret < 0 || (size_t)ret >= sizeof(filename))
+            {
+                XPOST_LOG_ERR("output file name too long");
+                break;
+            }
+            if (xpost_device_set_filename(ctx, device, filename))
+            {
+                XPOST_LOG_ERR("cannot set output file name %s", filename);
+                break;
+            }
+        }
+
+        /* the page buffer of a C device is outside vm,
+           so a restore does not clear what the last job drew */
+        execproc(ctx, xpost_object_cvx(xpost_name_cons(ctx, "erasepage")));
+        xpost_stack_clear(ctx->lo, ctx->os);
+        xpost_stack_clear(ctx->lo, ctx->es);
+
+        ret = runjob(ctx, XPOST_INPUT_FILENAME, files[i], 0, 1);
+        while (ret == yieldtocaller)
+            ret = runjob(ctx, XPOST_INPUT_RESUME, NULL, 0, 1);
+    }
+
+    destroydevice(ctx);
+    xpost_stack_clear(ctx->lo, ctx->os);
+    xpost_stack_clear(ctx->lo, ctx->es);
+
+    return i == cnt;
+}
+
+XPAPI int xpost_image_write(Xpost_Context *ctx, const char *filename)
+{
+    char path_init_ps[XPOST_PATH_MAX];
+
+    if (!ctx) return 0;
+    if (!findinitps(path_init_ps, sizeof(path_init_ps)))
+        return 0;
+
+    /* a device written in PostScript lives in vm, so the image
+       can hold it, and the graphics, for the jobs to start with */
+    if (_xpost_interpreter_device[0])
+    {
+        execproc(ctx, xpost_object_cvx(xpost_name_cons(ctx, "loadgraphics")));
+        xpost_stack_clear(ctx->lo, ctx->os);
+        xpost_stack_clear(ctx->lo, ctx->es);
+        if (!xpost_dict_known_key(ctx, ctx->lo,
+                                  xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 2),
+                                  xpost_name_cons(ctx, "GRAPHICS_LOADED")))
+        {
+            XPOST_LOG_ERR("unable to load graphics");
+            return 0;
+        }
+    }
+    else
+    {
+        XPOST_LOG_INFO("device %s is not in vm, the image holds no graphics",
+                       ctx->device_str);
+    }
+    return xpost_image_save(ctx, filename, path_init_ps, _xpost_interpreter_device);
+}
+
 /*
    destroy the given context and associated memory files (if not in use by a shared context)
    exit interpreter if all contexts are destroyed.
@@ -1445,6 +2126,8 @@ XPAPI void xpost_destroy(Xpost_Context *ctx)
         printf("bye!\n");
         fflush(NULL);
     }
+    XPOST_LOG_INFO("name cache: %lu hits, %lu misses",
+                   ctx->name_cache.hits, ctx->name_cache.misses);
     /*xpost_garbage_collect(itpdata->ctab->gl, 1, 1); */
     /*xpost_garbage_collect(itpdata->ctab->lo, 1, 1); */
 #if 0
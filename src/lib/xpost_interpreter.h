@@ -72,8 +72,8 @@ Xpost_Context *xpost_interpreter_cid_get_context(unsigned int cid);
 /**
  * The event-handler handler.
 
- * In a multi-threaded configuration, this may not execute at in every eval()
- * but by a superior strategy.
+ * Called by eval() for every object when tracing, otherwise
+ * once per XPOST_INTERPRETER_IDLE_BUDGET objects.
  */
 int idleproc(Xpost_Context *ctx);
 
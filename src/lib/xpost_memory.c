@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <ctype.h> /* isprint */
 #include <errno.h>
+#include <stdint.h> /* SIZE_MAX */
 #include <stdlib.h> /* free malloc realloc */
 #include <stdio.h> /* remove puts */
 #include <string.h> /* memset strerror */
@@ -47,7 +48,7 @@
 #endif
 
 #ifdef HAVE_SYS_MMAN_H
-# include <sys/mman.h> /* mmap munmap mremap */
+# include <sys/mman.h> /* mmap munmap mremap mprotect */
 #endif
 
 #ifdef _WIN32
@@ -75,7 +76,69 @@
 /* FIXME: use xpost_log instead */
 
 
-size_t xpost_memory_page_size;
+XPCHECKAPI size_t xpost_memory_page_size;
+
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+
+/*
+   address range reserved for each memory file, so that it grows in
+   place and its base never moves. vm addresses are unsigned int, so
+   a memory file cannot outgrow 4GiB anyway. define to 0 to map only
+   what is used and let the mapping move as it grows.
+ */
+# ifndef XPOST_MEMORY_RESERVE
+#  if SIZE_MAX > 0xffffffffUL
+#   define XPOST_MEMORY_RESERVE 0xffff0000UL
+#  else
+#   define XPOST_MEMORY_RESERVE 0
+#  endif
+# endif
+
+# ifndef MAP_NORESERVE
+#  define MAP_NORESERVE 0
+# endif
+
+/*
+   map the first sz bytes of the memory file,
+   at the bottom of a reserved range if one can be had.
+   the range maps the file (or anonymous memory) without access,
+   so growing is an mprotect of the pages added.
+ */
+static void *
+_xpost_memory_file_map(Xpost_Memory_File *mem, int fd, size_t sz)
+{
+# if XPOST_MEMORY_RESERVE > 0
+    if (sz % xpost_memory_page_size == 0 && sz < XPOST_MEMORY_RESERVE)
+    {
+        void *base;
+
+        base = mmap(NULL, XPOST_MEMORY_RESERVE,
+                    PROT_NONE,
+                    (fd == -1 ? MAP_PRIVATE   : MAP_SHARED) |
+                    (fd == -1 ? MAP_ANONYMOUS : 0) |
+                    MAP_NORESERVE,
+                    fd, 0);
+        if (base != MAP_FAILED)
+        {
+            if (mprotect(base, sz, PROT_READ | PROT_WRITE) == 0)
+            {
+                mem->reserved = XPOST_MEMORY_RESERVE;
+                return base;
+            }
+            munmap(base, XPOST_MEMORY_RESERVE);
+        }
+        XPOST_LOG_INFO("cannot reserve address range (error: %s)",
+                       strerror(errno));
+    }
+# endif
+    return mmap(NULL, sz,
+                PROT_READ | PROT_WRITE,
+                (fd == -1 ? MAP_PRIVATE   : MAP_SHARED) |
+                (fd == -1 ? MAP_ANONYMOUS : 0),
+                fd, 0);
+}
+
+#endif
 
 /*
    initialize the global extern page_size variable
@@ -136,6 +199,7 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
     mem->interpreter_cid_get_context = xpost_interpreter_cid_get_context;
     mem->interpreter_get_initializing = xpost_interpreter_get_initializing;
     mem->interpreter_set_initializing = xpost_interpreter_set_initializing;
+    mem->reserved = 0;
 
     if(fname)
     {
@@ -158,7 +222,7 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
                 if (fd != -1)
                 {
                     if (ftruncate(fd, sz) == -1)
-                        XPOST_LOG_ERR("ftruncate(%d, %d) returned -1 (error: %s)",
+                        XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1 (error: %s)",
                                       fd, sz, strerror(errno));
                 }
 #endif
@@ -199,12 +263,7 @@ xpost_memory_file_init(Xpost_Memory_File *mem,
     if (!mem->base)
     {
 #elif defined (HAVE_MMAP)
-    mem->base = (unsigned char *)mmap(NULL,
-                                      sz,
-                                      PROT_READ | PROT_WRITE,
-                                      (fd == -1 ? MAP_PRIVATE   : MAP_SHARED) |
-                                      (fd == -1 ? MAP_ANONYMOUS : 0),
-                                      fd, 0);
+    mem->base = (unsigned char *)_xpost_memory_file_map(mem, fd, sz);
     if (mem->base == MAP_FAILED)
     { /* . */
 #else
@@ -254,7 +313,7 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
 #ifdef _WIN32
     UnmapViewOfFile(mem->base);
 #elif defined (HAVE_MMAP)
-    munmap((void *)mem->base, mem->max);
+    munmap((void *)mem->base, mem->reserved ? mem->reserved : mem->max);
 #else
     if (mem->fd != -1)
     {
@@ -268,6 +327,7 @@ xpost_memory_file_exit(Xpost_Memory_File *mem)
     mem->base = NULL;
     mem->used = 0;
     mem->max = 0;
+    mem->reserved = 0;
 
     if (mem->fd != -1)
     {
@@ -297,7 +357,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     HANDLE fm;
 #endif
     void *tmp;
-    int ret = 1;
+    size_t least;
 
     if (!mem)
     {
@@ -315,9 +375,23 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
         sz = xpost_memory_page_size;
     else
         sz = (sz / xpost_memory_page_size + 1) * xpost_memory_page_size;
+    least = mem->max + sz;
     sz += mem->max * 1.5;
+    sz = (sz + xpost_memory_page_size - 1) / xpost_memory_page_size * xpost_memory_page_size;
+    if (mem->reserved)
+    {
+        /* the range may not hold the whole 1.5x, but must hold what was asked */
+        if (sz > mem->reserved)
+            sz = mem->reserved;
+        if (sz < least)
+        {
+            XPOST_LOG_ERR("%d memory file cannot grow past its reserved size %zu",
+                          VMerror, mem->reserved);
+            return 0;
+        }
+    }
 
-    XPOST_LOG_INFO("grow memory file%s%s (old: %d  new: %d)",
+    XPOST_LOG_INFO("grow memory file%s%s (old: %u  new: %zu)",
                    mem->fname ? " for " : "", mem->fname ? mem->fname : "",
                    mem->max, sz);
 
@@ -326,7 +400,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     {
         if (ftruncate(mem->fd, sz) == -1)
         {
-            XPOST_LOG_ERR("ftruncate(%d, %d) returned -1", mem->fd, sz);
+            XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1", mem->fd, sz);
             XPOST_LOG_ERR("strerror: %s", strerror(errno));
         }
     }
@@ -370,9 +444,19 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
     if (mem->fd != -1)
     {
         if (ftruncate(mem->fd, sz) == -1)
-            XPOST_LOG_ERR("ftruncate(%d, %d) returned -1 (error: %s)",
+            XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1 (error: %s)",
                           mem->fd, sz, strerror(errno));
     }
+    if (mem->reserved)
+    {
+        /* open the new pages in place, the base does not move */
+        tmp = mem->base;
+        if (mprotect((void *)(mem->base + mem->max), sz - mem->max,
+                     PROT_READ | PROT_WRITE) == -1)
+            tmp = MAP_FAILED;
+    }
+    else
+    {
 # ifdef HAVE_MREMAP
     tmp = mremap(mem->base, mem->max, sz, MREMAP_MAYMOVE);
 # else
@@ -382,7 +466,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
         munmap((void *)mem->base, mem->max);
         lseek(mem->fd, 0, SEEK_SET);
         if (ftruncate(mem->fd, sz) == -1)
-            XPOST_LOG_ERR("ftruncate(%d, %d) returned -1 (error: %s)",
+            XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1 (error: %s)",
                           mem->fd, sz, strerror(errno));
 
         tmp = mmap(NULL, sz,
@@ -402,6 +486,7 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
         }
     }
 # endif
+    }
     if (tmp == MAP_FAILED)
     { /* hanging error case */
 #else
@@ -413,14 +498,237 @@ xpost_memory_file_grow(Xpost_Memory_File *mem,
 #endif
         /* common error case closes the three possible hanging error cases */
         XPOST_LOG_ERR("%d unable to grow memory", VMerror);
-        ret = 0;
+        return 0;
     }
     mem->base = (unsigned char *)tmp;
     mem->max = sz;
 
-    return ret;
+    return 1;
 }
 
+/* shrink memory file to its used size, rounded up to the nearest system page size.
+   return 1 on success, 0 on failure.
+ */
+XPCHECKAPI int
+xpost_memory_file_shrink(Xpost_Memory_File *mem)
+{
+    size_t sz;
+
+    if (!mem)
+    {
+        XPOST_LOG_ERR("%d mem pointer is NULL", VMerror);
+        return 0;
+    }
+
+    if (mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem->base is NULL", VMerror);
+        return 0;
+    }
+
+    sz = (mem->used / xpost_memory_page_size + 1) * xpost_memory_page_size;
+    if (sz >= mem->max)
+        return 1;
+
+    XPOST_LOG_INFO("shrink memory file%s%s (old: %u  new: %zu)",
+                   mem->fname ? " for " : "", mem->fname ? mem->fname : "",
+                   mem->max, sz);
+
+#ifdef _WIN32
+    /* the view keeps its size */
+#elif defined (HAVE_MMAP)
+    if (mem->reserved)
+    {
+        /* close the pages again, and release them */
+        if (mprotect((void *)(mem->base + sz), mem->max - sz, PROT_NONE) == -1)
+        {
+            XPOST_LOG_ERR("%d unable to shrink memory (error: %s)",
+                          VMerror, strerror(errno));
+            return 0;
+        }
+        if (mem->fd != -1)
+        {
+            if (ftruncate(mem->fd, sz) == -1)
+                XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1 (error: %s)",
+                              mem->fd, sz, strerror(errno));
+        }
+# ifdef MADV_DONTNEED
+        else if (madvise((void *)(mem->base + sz), mem->max - sz, MADV_DONTNEED) == -1)
+            XPOST_LOG_ERR("madvise returned -1 (error: %s)", strerror(errno));
+# endif
+        mem->max = sz;
+        return 1;
+    }
+# ifdef HAVE_MREMAP
+    /* shrinking in place never moves the mapping */
+    if (mremap(mem->base, mem->max, sz, 0) == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to shrink memory (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    if (mem->fd != -1)
+    {
+        if (ftruncate(mem->fd, sz) == -1)
+            XPOST_LOG_ERR("ftruncate(%d, %zu) returned -1 (error: %s)",
+                          mem->fd, sz, strerror(errno));
+    }
+    mem->max = sz;
+# elif defined (MADV_DONTNEED)
+    /* keep the mapping, release its pages */
+    if (madvise((void *)(mem->base + sz), mem->max - sz, MADV_DONTNEED) == -1)
+        XPOST_LOG_ERR("madvise returned -1 (error: %s)", strerror(errno));
+# endif
+#else
+    {
+        void *tmp = realloc(mem->base, sz);
+        if (tmp == NULL)
+        {
+            XPOST_LOG_ERR("%d unable to shrink memory", VMerror);
+            return 0;
+        }
+        mem->base = (unsigned char *)tmp;
+        mem->max = sz;
+    }
+#endif
+
+    return 1;
+}
+
+/* move memory file into anonymous private memory and remove its file,
+   so a fork() shares the pages copy-on-write.
+   return 1 on success, 0 on failure.
+ */
+XPCHECKAPI int
+xpost_memory_file_detach(Xpost_Memory_File *mem)
+{
+    if (!mem)
+    {
+        XPOST_LOG_ERR("%d mem pointer is NULL", VMerror);
+        return 0;
+    }
+
+    if (mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem->base is NULL", VMerror);
+        return 0;
+    }
+
+    if (mem->fd == -1)
+        return 1;
+
+    XPOST_LOG_INFO("detach memory file %s", mem->fname);
+
+#ifdef _WIN32
+    XPOST_LOG_ERR("cannot detach a memory file on this system");
+    return 0;
+#elif defined (HAVE_MMAP)
+    {
+        void *tmp;
+
+        tmp = mmap(NULL, mem->max,
+                   PROT_READ | PROT_WRITE,
+                   MAP_ANONYMOUS | MAP_PRIVATE,
+                   -1, 0);
+        if (tmp == MAP_FAILED)
+        {
+            XPOST_LOG_ERR("%d unable to detach memory (error: %s)",
+                          VMerror, strerror(errno));
+            return 0;
+        }
+        memcpy(tmp, mem->base, mem->used);
+        if (mem->reserved)
+        {
+            /* keep the base, put a private reserved range under it */
+            if (mmap((void *)mem->base, mem->reserved,
+                     PROT_NONE,
+                     MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED,
+                     -1, 0) == MAP_FAILED ||
+                mprotect((void *)mem->base, mem->max,
+                         PROT_READ | PROT_WRITE) == -1)
+            {
+                XPOST_LOG_ERR("%d unable to detach memory (error: %s)",
+                              VMerror, strerror(errno));
+                munmap(tmp, mem->max);
+                return 0;
+            }
+            memcpy(mem->base, tmp, mem->used);
+            munmap(tmp, mem->max);
+        }
+        else
+        {
+            munmap((void *)mem->base, mem->max);
+            mem->base = (unsigned char *)tmp;
+        }
+    }
+#endif
+    /* without mmap the memory is already private */
+
+    close(mem->fd);
+    mem->fd = -1;
+    if (mem->fname[0] != '\0')
+    {
+        remove(mem->fname);
+        mem->fname[0] = '\0';
+    }
+
+    return 1;
+}
+
+
+/* map the contents of a file over the bottom of the reserved range,
+   copy-on-write, instead of reading them.
+   return 1 on success, 0 if the memory file cannot map them.
+ */
+XPCHECKAPI int
+xpost_memory_file_map_private(Xpost_Memory_File *mem,
+                              int fd,
+                              size_t offset,
+                              unsigned int sz)
+{
+#if defined (HAVE_MMAP) && !defined (_WIN32)
+    size_t len;
+
+    if (!mem)
+    {
+        XPOST_LOG_ERR("%d mem pointer is NULL", VMerror);
+        return 0;
+    }
+
+    if (mem->base == NULL)
+    {
+        XPOST_LOG_ERR("%d mem->base is NULL", VMerror);
+        return 0;
+    }
+
+    len = (sz + xpost_memory_page_size - 1) / xpost_memory_page_size * xpost_memory_page_size;
+    if (!mem->reserved || offset % xpost_memory_page_size != 0 || len > mem->reserved)
+        return 0;
+    if (len > mem->max && !xpost_memory_file_grow(mem, len - mem->max))
+        return 0;
+
+    XPOST_LOG_INFO("map %u bytes privately at offset %zu%s%s",
+                   sz, offset,
+                   mem->fname[0] ? " for " : "", mem->fname);
+    if (mmap((void *)mem->base, len,
+             PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED,
+             fd, (off_t)offset) == MAP_FAILED)
+    {
+        XPOST_LOG_ERR("%d unable to map memory (error: %s)",
+                      VMerror, strerror(errno));
+        return 0;
+    }
+    mem->used = sz;
+    return 1;
+#else
+    (void)mem;
+    (void)fd;
+    (void)offset;
+    (void)sz;
+    return 0;
+#endif
+}
 
 /*
    allocate data linearly from the memory file
@@ -597,7 +905,9 @@ _xpost_memory_table_alloc_new(Xpost_Memory_File *mem,
 
     mem->table.tab[ent].adr = adr;
     mem->table.tab[ent].sz = sz;
+    mem->table.tab[ent].mark = 0;
     mem->table.tab[ent].tag = tag;
+    mem->table.tab[ent].save = 0;
 
     if (mem->table.nextent == mem->table.max)
     {
@@ -818,15 +1128,17 @@ xpost_memory_table_dump_ent(Xpost_Memory_File *mem,
     XPOST_LOG_DUMP("ent %d (%d): "
             "adr %u 0x%04x, "
             "sz [%u], "
-            "mark %s rfct %d llev %d tlev %d\n",
+            "mark %s age %d%s llev %d tlev %d\n",
             e, i,
             mem->table.tab[i].adr, mem->table.tab[i].adr,
             mem->table.tab[i].sz,
             mem->table.tab[i].mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
             (mem->table.tab[i].mark
-                & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
-                >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
+                & XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK)
+                >> XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET,
+            mem->table.tab[i].mark
+                & XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK ? "*" : "",
             (mem->table.tab[i].mark
                 & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
                 >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
@@ -856,15 +1168,17 @@ xpost_memory_table_dump(const Xpost_Memory_File *mem)
         XPOST_LOG_DUMP("ent %d (%d): "
                 "adr %u 0x%04x, "
                 "sz [%u], "
-                "mark %s rfct %d llev %d tlev %d\n",
+                "mark %s age %d%s llev %d tlev %d\n",
                 e, i,
                 mem->table.tab[i].adr, mem->table.tab[i].adr,
                 mem->table.tab[i].sz,
                 mem->table.tab[i].mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK ? "#" : "_",
                 (mem->table.tab[i].mark
-                    & XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK)
-                    >> XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET,
+                    & XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK)
+                    >> XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET,
+                mem->table.tab[i].mark
+                    & XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK ? "*" : "",
                 (mem->table.tab[i].mark
                     & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
                     >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET,
@@ -74,21 +74,27 @@
 /**
  * @typedef Xpost_Memory_Table_Mark_Data
  *
- * There are 4 "virtual" bitfields packed in what is assumed to be a
+ * There are 5 "virtual" bitfields packed in what is assumed to be a
  * 32-bit unsigned field. These values are used in masking and
  * shifting operations to access the fields in a direct, portable
  * manner.
+ *
+ * The AGE field counts the collections an entity has survived, and
+ * the REMEMBERED bit flags an old entity that may refer to young
+ * ones. Both are maintained by the generational collector.
  */
 typedef enum
 {
-    XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK       = 0x7F000000,
-    XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET     =     24,
-    XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_MASK   = 0x00FF0000,
-    XPOST_MEMORY_TABLE_MARK_DATA_REFCOUNT_OFFSET =       16,
-    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK   = 0x0000FF00,
-    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET =         8,
-    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK   = 0x000000FF,
-    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET =           0
+    XPOST_MEMORY_TABLE_MARK_DATA_MARK_MASK         = 0x7F000000,
+    XPOST_MEMORY_TABLE_MARK_DATA_MARK_OFFSET       =     24,
+    XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_MASK   = 0x00800000,
+    XPOST_MEMORY_TABLE_MARK_DATA_REMEMBERED_OFFSET =       23,
+    XPOST_MEMORY_TABLE_MARK_DATA_AGE_MASK          = 0x007F0000,
+    XPOST_MEMORY_TABLE_MARK_DATA_AGE_OFFSET        =       16,
+    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK     = 0x0000FF00,
+    XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET   =         8,
+    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK     = 0x000000FF,
+    XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET   =           0
 } Xpost_Memory_Table_Mark_Data;
 
 /**
@@ -102,7 +108,7 @@ typedef enum
     XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK,
     XPOST_MEMORY_TABLE_SPECIAL_CONTEXT_LIST,
     XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK,
-    XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE,
+    XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH,
     XPOST_MEMORY_TABLE_SPECIAL_BOGUS_NAME,
     XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE
 } Xpost_Memory_Table_Special;
@@ -129,6 +135,7 @@ typedef struct Xpost_Memory_Table
         unsigned int sz; /**< size of allocation */
         unsigned int mark; /**< garbage collection metadata */
         unsigned int tag; /**< type of object using this allocation, if needed */
+        unsigned int save; /**< chunk directory saving this allocation at its toplevel, or 0 */
     } *tab; /**< table entries */
 } Xpost_Memory_Table;
 
@@ -149,14 +156,19 @@ typedef struct Xpost_Memory_File
     unsigned char *base; /**< pointer to mapped memory */
     unsigned int used;  /**< size used, cursor to free space */
     unsigned int max; /**< size available in memory pointed to by base */
+    size_t reserved; /**< size of the address range reserved at base,
+                          or 0 if the memory may move as it grows */
 
     struct Xpost_Memory_Table table;
 
     unsigned int start; /**< first 'live' entry in the memory_table. */
         /* the domain of the collector is entries >= start */
 
-    int period;
-    int threshold;
+    int compact; /**< set when a sweep leaves enough free space to compact */
+    int threshold; /**< bytes left to allocate before the next automatic collection */
+    int vmthreshold; /**< least bytes to allocate between automatic collections */
+    int autocollect; /**< 0 if automatic collection is disabled by vmreclaim */
+    unsigned int minor; /**< minor collections since the last full collection */
     int free_list_alloc_is_installed;
     int (*free_list_alloc)(struct Xpost_Memory_File *mem,
                            unsigned sz,
@@ -183,7 +195,7 @@ typedef struct Xpost_Memory_File
  * @var xpost_memory_page_size
  * @brief The 'grain' of the memory-file size.
  */
-extern size_t xpost_memory_page_size;
+extern XPCHECKAPI size_t xpost_memory_page_size;
 
 
 /*
@@ -216,6 +228,10 @@ int xpost_memory_init(void);
  *
  * This function initializes the memory file @p mem, possibly from
  * file specified by the file descriptor @p fd, if not -1.
+ *
+ * Where mmap() is available, a large range of addresses is reserved
+ * without access, and the memory file is mapped at its bottom. If
+ * the range cannot be reserved, only the memory in use is mapped.
  */
 XPCHECKAPI int xpost_memory_file_init(Xpost_Memory_File *mem,
                                       const char *fname,
@@ -245,10 +261,74 @@ XPCHECKAPI int xpost_memory_file_exit(Xpost_Memory_File *mem);
  * @return 1 on success, 0 on failure.
  *
  * This function increases the memory used by @p mem by @p sz bites.
+ *
+ * If the memory file has a reserved range, the new pages are committed
+ * in place: nothing is copied and @c mem->base does not move, so
+ * pointers into the memory stay valid. Otherwise the memory may move,
+ * which is why callers recalculate their pointers from @c mem->base
+ * after any allocation; they must keep doing so, as the reservation
+ * is not available on every system. A memory file at the size of its
+ * reserved range cannot grow. On failure, @p mem is left unchanged.
  */
 XPCHECKAPI int xpost_memory_file_grow(Xpost_Memory_File *mem,
                                       size_t sz);
 
+/**
+ * @brief Return the pages of the given memory file above its used
+ * size to the system.
+ *
+ * @param[in,out] mem The memory file.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function shrinks the mapping of @p mem to its used size,
+ * rounded up to the next system page size, with mremap() where
+ * available. Otherwise the pages are released with madvise() and the
+ * mapping keeps its size. If the memory file has a reserved range, the
+ * pages go back to it. The memory is not moved.
+ */
+XPCHECKAPI int xpost_memory_file_shrink(Xpost_Memory_File *mem);
+
+/**
+ * @brief Move the given memory file out of its file into private
+ * memory.
+ *
+ * @param[in,out] mem The memory file.
+ * @return 1 on success, 0 on failure.
+ *
+ * This function copies the contents of @p mem into an anonymous
+ * private mapping and removes the file given to
+ * xpost_memory_file_init(). A process forked afterwards then shares
+ * the pages with its parent copy-on-write, instead of writing through
+ * to a file the parent still uses. The memory may be moved, unless
+ * it has a reserved range.
+ */
+XPCHECKAPI int xpost_memory_file_detach(Xpost_Memory_File *mem);
+
+/**
+ * @brief Map the contents of a file over the given memory file,
+ * copy-on-write.
+ *
+ * @param[in,out] mem The memory file.
+ * @param[in] fd The file holding the contents.
+ * @param[in] offset The offset of the contents in @p fd, a multiple
+ * of the page size.
+ * @param[in] sz The size of the contents.
+ * @return 1 on success, 0 otherwise.
+ *
+ * This function maps @p sz bytes of @p fd from @p offset privately
+ * over the bottom of the reserved range of @p mem, and sets its used
+ * size to @p sz. Pages are read when first touched, and copied when
+ * first written, so the file is never changed and processes mapping
+ * the same file share the pages they only read. The rest of the last
+ * page comes from the file too. The file must not change while it is
+ * mapped. A memory file without a reserved range cannot map: on
+ * failure the caller reads the contents instead.
+ */
+XPCHECKAPI int xpost_memory_file_map_private(Xpost_Memory_File *mem,
+                                             int fd,
+                                             size_t offset,
+                                             unsigned int sz);
+
 /**
  * @brief Allocate memory in the given memory file and return offset.
  *
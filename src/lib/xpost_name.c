@@ -46,6 +46,7 @@
 #include "xpost_context.h"
 //#include "xpost_interpreter.h"  // initialize interpreter to test
 #include "xpost_error.h"
+#include "xpost_free.h"  // old hash tables are returned to the free list
 #include "xpost_string.h"  // access string objects
 #include "xpost_name.h"  // double-check prototypes
 
@@ -79,7 +80,43 @@ void xpost_name_dump_names(Xpost_Context *ctx)
     }
 }
 
-/* initialize the name special entities XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, NAME_TREE */
+/* hash the bytes of a name string (FNV-1a) */
+static
+unsigned int _xpost_name_hash(const char *s,
+                              unsigned int len)
+{
+    unsigned int h = 2166136261U;
+    while (len--)
+    {
+        h ^= (unsigned char)*s++;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+/* allocate and clear an empty hash table of XPOST_NAME_HASH_INIT slots */
+static
+int _xpost_name_hash_init(Xpost_Memory_File *mem)
+{
+    unsigned int sz = sizeof(Xpost_Name_Hash) + XPOST_NAME_HASH_INIT * sizeof(Xpost_Name_Slot);
+    unsigned int adr;
+    Xpost_Name_Hash *h;
+
+    if (!xpost_memory_file_alloc(mem, sz, &adr))
+    {
+        XPOST_LOG_ERR("cannot allocate name hash table");
+        return 0;
+    }
+    memset(mem->base + adr, 0, sz);
+    h = (void *)(mem->base + adr);
+    h->mask = XPOST_NAME_HASH_INIT - 1;
+    h->count = 0;
+    mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr = adr;
+    mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].sz = sz;
+    return 1;
+}
+
+/* initialize the name special entities XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, NAME_HASH */
 int xpost_name_init(Xpost_Context *ctx)
 {
     Xpost_Memory_Table *tab;
@@ -99,19 +136,20 @@ int xpost_name_init(Xpost_Context *ctx)
     //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK);
     if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK)
         XPOST_LOG_ERR("Warning: name stack is not in special position");
-    ret = xpost_memory_table_alloc(ctx->gl, 0, 0, &ent); //gl:NAMET
+    ret = xpost_memory_table_alloc(ctx->gl, 0, 0, &ent); //gl:NAMEH
     if (!ret)
     {
         return 0;
     }
-    //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE);
-    if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)
-        XPOST_LOG_ERR("Warning: name tree is not in special position");
+    //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH);
+    if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH)
+        XPOST_LOG_ERR("Warning: name hash is not in special position");
 
     xpost_stack_init(ctx->gl, &t);
     tab = &ctx->gl->table; //recalc pointer
     tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    if (!_xpost_name_hash_init(ctx->gl))
+        return 0;
     xpost_memory_table_get_addr(ctx->gl,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->gl, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -126,19 +164,20 @@ int xpost_name_init(Xpost_Context *ctx)
     //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK);
     if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK)
         XPOST_LOG_ERR("Warning: name stack is not in special position");
-    ret = xpost_memory_table_alloc(ctx->lo, 0, 0, &ent); //lo:NAMET
+    ret = xpost_memory_table_alloc(ctx->lo, 0, 0, &ent); //lo:NAMEH
     if (!ret)
     {
         return 0;
     }
-    //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE);
-    if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE)
-        XPOST_LOG_ERR("Warning: name tree is not in special position");
+    //assert(ent == XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH);
+    if (ent != XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH)
+        XPOST_LOG_ERR("Warning: name hash is not in special position");
 
     xpost_stack_init(ctx->lo, &t);
     tab = &ctx->lo->table; //recalc pointer
     tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK].adr = t;
-    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = 0;
+    if (!_xpost_name_hash_init(ctx->lo))
+        return 0;
     xpost_memory_table_get_addr(ctx->lo,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
     xpost_stack_push(ctx->lo, nstk, xpost_string_cons(ctx, CNT_STR("_not_a_name_")));
@@ -151,161 +190,218 @@ int xpost_name_init(Xpost_Context *ctx)
     return 1;
 }
 
-/* perform a search using the ternary search tree */
+/* perform a search in the hash table of mem.
+   returns the name-stack index, or 0 if not found */
 static
-unsigned int tstsearch(Xpost_Memory_File *mem,
-                       unsigned int tadr,
-                       const char *s)
+unsigned int _xpost_name_hash_search(Xpost_Memory_File *mem,
+                                     const char *s,
+                                     unsigned int len,
+                                     unsigned int hash)
 {
-    while (tadr) {
-        tst *p = (void *)(mem->base + tadr);
-        if ((unsigned int)*s < p->val) {
-            tadr = p->lo;
-        } else if ((unsigned int)*s == p->val) {
-            if (*s++ == 0) return p->eq; /* payload when val == '\0' */
-            tadr = p->eq;
-        } else {
-            tadr = p->hi;
-        }
+    Xpost_Name_Hash *h;
+    Xpost_Name_Slot *slot;
+    unsigned int names;
+    unsigned int i;
+    unsigned int ad;
+    Xpost_Object str;
+
+    h = (void *)(mem->base + mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr);
+    slot = (void *)(h + 1);
+    xpost_memory_table_get_addr(mem,
+            XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &names);
+    for (i = hash & h->mask; slot[i].index; i = (i + 1) & h->mask)
+    {
+        if (slot[i].hash != hash)
+            continue;
+        str = xpost_stack_bottomup_fetch(mem, names, slot[i].index);
+        if (str.comp_.sz != len)
+            continue;
+        xpost_memory_table_get_addr(mem, xpost_object_get_ent(str), &ad);
+        if (memcmp(mem->base + ad + str.comp_.off, s, len) == 0)
+            return slot[i].index;
     }
     return 0;
 }
 
-/* add a string to the ternary search tree */
+/* place an index in the first empty slot of its probe sequence */
 static
-int tstinsert(Xpost_Memory_File *mem,
-              unsigned int tadr,
-              const char *s,
-              unsigned int *retval)
+void _xpost_name_hash_place(Xpost_Name_Hash *h,
+                            unsigned int hash,
+                            unsigned int index)
 {
-    tst *p;
-    unsigned int t; //temporary
-    unsigned int nstk;
-    int ret;
+    Xpost_Name_Slot *slot = (void *)(h + 1);
+    unsigned int i;
 
-    if (!tadr) {
-        if (!xpost_memory_file_alloc(mem, sizeof(tst), &tadr))
-        {
-            XPOST_LOG_ERR("cannot allocate tree node");
-            return VMerror;
-        }
-        p = (void *)(mem->base + tadr);
-        p->val = *s;
-        p->lo = p->eq = p->hi = 0;
-    }
-    p = (void *)(mem->base + tadr);
-    if ((unsigned int)*s < p->val) {
-        ret = tstinsert(mem, p->lo, s, &t);
-        if (ret)
-            return ret;
-        p = (void *)(mem->base + tadr); //recalc pointer
-        p->lo = t;
-    } else if ((unsigned int)*s == p->val) {
-        if (*s) {
-            ret = tstinsert(mem, p->eq, ++s, &t);
-            if (ret)
-                return ret;
-            p = (void *)(mem->base + tadr); //recalc pointer
-            p->eq = t;
-        }else {
-            xpost_memory_table_get_addr(mem,
-                    XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &nstk);
-            p->eq = xpost_stack_count(mem, nstk); /* payload when val == '\0' */
-        }
-    } else {
-        ret = tstinsert(mem, p->hi, s, &t);
-        if (ret)
-            return ret;
-        p = (void *)(mem->base + tadr); //recalc pointer
-        p->hi = t;
+    for (i = hash & h->mask; slot[i].index; i = (i + 1) & h->mask)
+        ;
+    slot[i].hash = hash;
+    slot[i].index = index;
+}
+
+/* double the hash table of mem.
+   the new table takes the address of a fresh allocation,
+   the old one is handed back to the free list */
+static
+int _xpost_name_hash_grow(Xpost_Memory_File *mem)
+{
+    Xpost_Memory_Table *tab;
+    Xpost_Name_Hash *old;
+    Xpost_Name_Hash *h;
+    Xpost_Name_Slot *slot;
+    unsigned int oldadr;
+    unsigned int oldsz;
+    unsigned int newsz;
+    unsigned int newadr;
+    unsigned int ent;
+    unsigned int i;
+
+    tab = &mem->table;
+    oldadr = tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr;
+    oldsz = tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].sz;
+    old = (void *)(mem->base + oldadr);
+    newsz = sizeof(Xpost_Name_Hash) + 2 * (old->mask + 1) * sizeof(Xpost_Name_Slot);
+
+    if (!xpost_memory_table_alloc(mem, newsz, 0, &ent))
+    {
+        XPOST_LOG_ERR("cannot grow name hash table");
+        return 0;
     }
-    //return tadr;
-    *retval = tadr;
-    return 0;
+    tab = &mem->table; //recalc pointers
+    newadr = tab->tab[ent].adr;
+    old = (void *)(mem->base + oldadr);
+    h = (void *)(mem->base + newadr);
+    memset(h, 0, newsz);
+    h->mask = 2 * (old->mask + 1) - 1;
+    h->count = old->count;
+    slot = (void *)(old + 1);
+    for (i = 0; i <= old->mask; i++)
+        if (slot[i].index)
+            _xpost_name_hash_place(h, slot[i].hash, slot[i].index);
+
+    /* steal its adr, stash old adr, free it */
+    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr = newadr;
+    tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].sz = newsz;
+    tab->tab[ent].adr = oldadr;
+    tab->tab[ent].sz = oldsz;
+    (void) xpost_free_memory_ent(mem, ent);
+    return 1;
 }
 
-/* add the name to the name stack, return index */
+/* add the name to the name stack and the hash table, return index */
 static
 unsigned int addname(Xpost_Context *ctx,
-                     const char *s)
+                     const char *s,
+                     unsigned int len,
+                     unsigned int hash)
 {
     Xpost_Memory_File *mem = ctx->vmmode==GLOBAL?ctx->gl:ctx->lo;
+    Xpost_Name_Hash *h;
     unsigned int names;
     unsigned int u;
     Xpost_Object str;
 
+    h = (void *)(mem->base + mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr);
+    if ((h->count + 1) * 4 > (h->mask + 1) * 3)
+    {
+        if (!_xpost_name_hash_grow(mem))
+            return 0;
+    }
+
     xpost_memory_table_get_addr(mem,
             XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK, &names);
     u = xpost_stack_count(mem, names);
 
-    //xpost_memory_file_dump(ctx->gl);
-    //dumpmtab(ctx->gl, 0);
-    //unsigned int vmmode = ctx->vmmode;
-    //ctx->vmmode = GLOBAL;
-    str = xpost_string_cons(ctx, strlen(s), s);
+    str = xpost_string_cons(ctx, len, s);
     if (xpost_object_get_type(str) == nulltype)
     {
         XPOST_LOG_ERR("cannot allocate name string");
         return 0;
     }
-    xpost_stack_push(mem, names, str);
-    //ctx->vmmode = vmmode;
+    if (!xpost_stack_push(mem, names, str))
+    {
+        XPOST_LOG_ERR("cannot push name string");
+        return 0;
+    }
+
+    h = (void *)(mem->base + mem->table.tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_HASH].adr);
+    _xpost_name_hash_place(h, hash, u);
+    ++h->count;
     return u;
 }
 
-/* construct a name object from a string
+/* is s inside the memory of mem? */
+static
+int _xpost_name_in_memory(Xpost_Memory_File *mem,
+                          const char *s)
+{
+    return (const unsigned char *)s >= mem->base &&
+           (const unsigned char *)s < mem->base + mem->max;
+}
+
+/* construct a name object from a string of len bytes
    searches and if necessary installs string
-   in ternary search tree,
+   in the hash table,
    adding string to stack if so.
    returns a generic object with
        nametype tag with FBANK flag,
        mark_.pad0 set to zero
        mark_.padw contains XPOST_MEMORY_TABLE_SPECIAL_NAME_STACK stack index
+   or invalid if the name could not be installed.
  */
-Xpost_Object xpost_name_cons(Xpost_Context *ctx,
-                             const char *s)
+Xpost_Object xpost_name_cons_bytes(Xpost_Context *ctx,
+                                   unsigned int len,
+                                   const char *s)
 {
+    unsigned int hash;
     unsigned int u;
-    unsigned int t;
     Xpost_Object o;
-    unsigned int tstk;
-    int ret;
 
-    xpost_memory_table_get_addr(ctx->lo,
-            XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE, &tstk);
-    u = tstsearch(ctx->lo, tstk, s);
-    if (!u) {
-        xpost_memory_table_get_addr(ctx->gl,
-                XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE, &tstk);
-        u = tstsearch(ctx->gl, tstk, s);
-        if (!u) {
-            Xpost_Memory_File *mem = ctx->vmmode==GLOBAL?ctx->gl:ctx->lo;
-            Xpost_Memory_Table *tab = &mem->table;
-            ret = tstinsert(mem, tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr, s, &t);
-            if (ret)
-            {
-                //this can only be a VMerror
-                return invalid;
-            }
-            tab = &mem->table; //recalc pointer
-            tab->tab[XPOST_MEMORY_TABLE_SPECIAL_NAME_TREE].adr = t;
-            u = addname(ctx, s); // obeys vmmode
-            o.mark_.tag = nametype | (ctx->vmmode==GLOBAL?XPOST_OBJECT_TAG_DATA_FLAG_BANK:0);
-            o.mark_.pad0 = 0;
-            o.mark_.padw = u;
-        } else {
-            o.mark_.tag = nametype | XPOST_OBJECT_TAG_DATA_FLAG_BANK; // global
-            o.mark_.pad0 = 0;
-            o.mark_.padw = u;
-        }
-    } else {
+    hash = _xpost_name_hash(s, len);
+    o.mark_.pad0 = 0;
+
+    u = _xpost_name_hash_search(ctx->lo, s, len, hash);
+    if (u)
+    {
         o.mark_.tag = nametype; // local
-        o.mark_.pad0 = 0;
         o.mark_.padw = u;
-        }
+        return o;
+    }
+    u = _xpost_name_hash_search(ctx->gl, s, len, hash);
+    if (u)
+    {
+        o.mark_.tag = nametype | XPOST_OBJECT_TAG_DATA_FLAG_BANK; // global
+        o.mark_.padw = u;
+        return o;
+    }
+
+    if (_xpost_name_in_memory(ctx->lo, s) || _xpost_name_in_memory(ctx->gl, s))
+    { /* s may move when vm grows: install a copy */
+        char *t = malloc(len + 1);
+        if (!t)
+            return invalid;
+        memcpy(t, s, len);
+        u = addname(ctx, t, len, hash); // obeys vmmode
+        free(t);
+    }
+    else
+        u = addname(ctx, s, len, hash); // obeys vmmode
+    if (!u)
+    {
+        //this can only be a VMerror
+        return invalid;
+    }
+    o.mark_.tag = nametype | (ctx->vmmode==GLOBAL?XPOST_OBJECT_TAG_DATA_FLAG_BANK:0);
+    o.mark_.padw = u;
     return o;
 }
 
+/* construct a name object from a nul-terminated string */
+Xpost_Object xpost_name_cons(Xpost_Context *ctx,
+                             const char *s)
+{
+    return xpost_name_cons_bytes(ctx, strlen(s), s);
+}
+
 /* yield the string object from the name string stack
     */
 Xpost_Object xpost_name_get_string(Xpost_Context *ctx,
@@ -36,23 +36,46 @@
  * @brief array functions
  *
  * The name mechanism associates strings with integers
- * using a ternary search tree
+ * using an open-addressing hash table
  * and a stack of string objects.
  *
+ * Each memory file has its own table and stack.
+ * A name is searched in the local table, then the global one,
+ * and installed in the memory selected by the vmmode.
+ * The table holds the hash of the string with the stack index,
+ * so the string itself is only compared when the hashes match.
+ * The table is kept at most 3/4 full, and doubles when it grows.
+ *
  * @{
  */
 
-typedef struct tst
+/**
+ * @brief initial number of slots in a name hash table
+ */
+#define XPOST_NAME_HASH_INIT 256
+
+/**
+ * @brief name hash table header, followed by mask+1 slots
+ */
+typedef struct Xpost_Name_Hash
+{
+    unsigned int mask;  /* number of slots - 1 */
+    unsigned int count; /* number of names in the table */
+} Xpost_Name_Hash;
+
+/**
+ * @brief name hash table slot, index 0 denotes an empty slot
+ */
+typedef struct Xpost_Name_Slot
 {
-    unsigned val,
-             lo,
-             eq,
-             hi;
-} tst;
+    unsigned int hash;  /* hash of the name string */
+    unsigned int index; /* index of the name string in the name stack */
+} Xpost_Name_Slot;
 
 void xpost_name_dump_names(Xpost_Context *ctx);
 int xpost_name_init(Xpost_Context *ctx);
 Xpost_Object xpost_name_cons(Xpost_Context *ctx, const char *s);
+Xpost_Object xpost_name_cons_bytes(Xpost_Context *ctx, unsigned int len, const char *s);
 Xpost_Object xpost_name_get_string(Xpost_Context *ctx, Xpost_Object n);
 
 /**
@@ -50,6 +50,7 @@
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
 #include "xpost_op_stack.h"
+#include "xpost_op_control.h"
 #include "xpost_op_array.h"
 
 
@@ -272,42 +273,7 @@ int xpost_op_array_proc_forall(Xpost_Context *ctx,
                                Xpost_Object A,
                                Xpost_Object P)
 {
-    Xpost_Object interval;
-    Xpost_Object element;
-    if (A.comp_.sz == 0)
-        return 0;
-
-    assert(ctx->gl->base);
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                xpost_operator_cons_opcode(ctx->opcode_shortcuts.forall)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
-        return execstackoverflow;
-
-    /* update array descriptor before push for next iteration */
-    interval = xpost_object_get_interval(A, 1, A.comp_.sz - 1);
-    if (xpost_object_get_type(interval) == invalidtype)
-        return rangecheck;
-
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(interval)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
-        return execstackoverflow;
-    element = xpost_array_get(ctx, A, 0);
-    /*
-    if (xpost_object_is_exe(element)) {
-        if (!xpost_stack_push(ctx->lo, ctx->es,
-                    xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-            return execstackoverflow;
-    }
-    */
-    if (!xpost_stack_push(ctx->lo, ctx->os, element))
-        return stackoverflow;
-
-    return 0;
+    return xpost_op_control_forall(ctx, A, P);
 }
 
 int xpost_oper_init_array_ops (Xpost_Context *ctx,
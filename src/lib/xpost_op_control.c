@@ -46,6 +46,7 @@
 #include "xpost_context.h"
 #include "xpost_error.h"
 #include "xpost_name.h"
+#include "xpost_string.h"
 #include "xpost_array.h"
 #include "xpost_dict.h"
 
@@ -53,6 +54,9 @@
 #include "xpost_operator.h"
 #include "xpost_op_control.h"
 
+/* nesting of procs beyond which compile gives up with limitcheck */
+#define XPOST_OP_CONTROL_COMPILE_DEPTH 64
+
 /* any  exec  -
    execute arbitrary object */
 static
@@ -103,45 +107,291 @@ int xpost_op_bool_proc_proc_ifelse (Xpost_Context *ctx,
     return 0;
 }
 
-/* initial increment limit proc  for  -
-   execute proc with values from initial by steps
-   of increment to limit */
+/*
+   control frames.
+   the es height of each loop or stopped marker is kept on cs,
+   so exit and stop can cut es back to their frame directly.
+   entries are not removed when a frame ends: heights on cs always
+   increase, and an entry is live only while es still holds the
+   marker at that height.
+ */
+
+/* record a frame whose marker is about to be pushed on es */
 static
-int xpost_op_int_int_int_proc_for (Xpost_Context *ctx,
-                                   Xpost_Object init,
-                                   Xpost_Object incr,
-                                   Xpost_Object lim,
-              Xpost_Object P)
+int _xpost_op_control_frame(Xpost_Context *ctx)
 {
-    integer i = init.int_.val;
-    integer j = incr.int_.val;
-    integer n = lim.int_.val;
-    int up = j > 0;
-    if (up? i > n : i < n) return 0;
-    assert(ctx->gl->base);
+    Xpost_Stack *cs = (Xpost_Stack *)(ctx->lo->base + ctx->cs);
+    int h = xpost_stack_count(ctx->lo, ctx->es);
+
+    /* drop frames which have ended */
+    while (cs->top > 0 &&
+           XPOST_STACK_DATA(ctx->lo, cs)[cs->top - 1].int_.val >= h)
+        --cs->top;
+    if (!xpost_stack_push(ctx->lo, ctx->cs, xpost_int_cons(h)))
+        return execstackoverflow;
+    return 0;
+}
 
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.opfor)))
-            return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
+static
+int _xpost_op_control_is_loop(Xpost_Context *ctx,
+                              Xpost_Object x)
+{
+    return xpost_object_get_type(x) == operatortype &&
+        (x.mark_.padw == (dword)ctx->opcode_shortcuts.opfor ||
+         x.mark_.padw == (dword)ctx->opcode_shortcuts.repeat ||
+         x.mark_.padw == (dword)ctx->opcode_shortcuts.loop ||
+         x.mark_.padw == (dword)ctx->opcode_shortcuts.forall);
+}
+
+static
+int _xpost_op_control_is_stopped(Xpost_Object x)
+{
+    return xpost_object_get_type(x) == booleantype && !x.int_.val;
+}
+
+/* cut es back to the innermost live loop frame, or stopped frame,
+   removing its marker. return 0 if there is none. */
+static
+int _xpost_op_control_unwind(Xpost_Context *ctx,
+                             int stopped)
+{
+    Xpost_Stack *cs = (Xpost_Stack *)(ctx->lo->base + ctx->cs);
+    Xpost_Stack *es = (Xpost_Stack *)(ctx->lo->base + ctx->es);
+    Xpost_Object *c = XPOST_STACK_DATA(ctx->lo, cs);
+    Xpost_Object *e = XPOST_STACK_DATA(ctx->lo, es);
+    unsigned int h;
+    int i;
+
+    for (i = (int)cs->top - 1; i >= 0; i--)
+    {
+        h = c[i].int_.val;
+        if (h >= es->top)
+            continue;
+        if (stopped ? _xpost_op_control_is_stopped(e[h])
+                    : _xpost_op_control_is_loop(ctx, e[h]))
+        {
+            cs->top = i;
+            return xpost_stack_pop_n(ctx->lo, ctx->es, es->top - h);
+        }
+    }
+    return 0;
+}
+
+/*
+   loop frames.
+   a loop keeps its state in place on es, between the loop operator,
+   which marks the frame for exit, and a continuation operator on top,
+   which runs the next iteration when the body returns to it:
+
+       for P limit incr next contfor
+       repeat P count contrepeat
+       loop P contloop
+       forall P rest contforall
+
+   where rest is the remainder of an array or string,
+   or a dict with the table slot to resume from in comp_.off.
+ */
+
+/* push a loop frame and run its first iteration */
+static
+int _xpost_op_control_loop_begin(Xpost_Context *ctx,
+                                 int marker,
+                                 Xpost_Object P,
+                                 int n,
+                                 const Xpost_Object *state,
+                                 int cont)
+{
+    int i;
+    int ret;
+
+    ret = _xpost_op_control_frame(ctx);
+    if (ret)
+        return ret;
+    if (!xpost_stack_reserve(ctx->lo, ctx->es, n + 3))
         return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(marker));
+    xpost_stack_push(ctx->lo, ctx->es, P);
+    for (i = 0; i < n; i++)
+        xpost_stack_push(ctx->lo, ctx->es, state[i]);
+    xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(cont));
+    return xpost_op_control_loop_step(ctx);
+}
+
+/*
+   run the next iteration of the loop frame on top of es,
+   or remove the frame if the loop is done.
+   f[0] is the continuation, f[-1] the state nearest to it.
+ */
+int xpost_op_control_loop_step(Xpost_Context *ctx)
+{
+    Xpost_Stack *es = (Xpost_Stack *)(ctx->lo->base + ctx->es);
+    Xpost_Object *f;
+    Xpost_Object P;
+    Xpost_Object o[2];
+    int no = 0;
+    int size = 0; /* of the frame */
+    dword cont;
+
+    if (es->top < 3)
+        return execstackunderflow;
+    f = XPOST_STACK_DATA(ctx->lo, es) + es->top - 1;
+    cont = f[0].mark_.padw;
+
+    if (cont == (dword)ctx->opcode_shortcuts.contfor)
+    {
+        size = 6;
+        if (es->top < 6)
+            return execstackunderflow;
+        P = f[-4];
+        o[no++] = f[-1];
+        if (xpost_object_get_type(f[-1]) == integertype)
+        {
+            integer i = f[-1].int_.val;
+            integer j = f[-2].int_.val;
+            integer n = f[-3].int_.val;
+            if (j > 0 ? i > n : i < n)
+                goto done;
+            f[-1].int_.val = i + j;
+        }
+        else
+        {
+            real i = f[-1].real_.val;
+            real j = f[-2].real_.val;
+            real n = f[-3].real_.val;
+            if (j > 0 ? i > n : i < n)
+                goto done;
+            f[-1].real_.val = i + j;
+        }
+    }
+    else if (cont == (dword)ctx->opcode_shortcuts.contrepeat)
+    {
+        size = 4;
+        if (es->top < 4)
+            return execstackunderflow;
+        P = f[-2];
+        if (f[-1].int_.val <= 0)
+            goto done;
+        --f[-1].int_.val;
+    }
+    else if (cont == (dword)ctx->opcode_shortcuts.contloop)
+    {
+        P = f[-1];
+    }
+    else if (cont == (dword)ctx->opcode_shortcuts.contforall)
+    {
+        size = 4;
+        if (es->top < 4)
+            return execstackunderflow;
+        P = f[-2];
+        switch (xpost_object_get_type(f[-1]))
+        {
+            case arraytype:
+                if (f[-1].comp_.sz == 0)
+                    goto done;
+                o[no++] = xpost_array_get(ctx, f[-1], 0);
+                ++f[-1].comp_.off;
+                --f[-1].comp_.sz;
+                break;
+            case stringtype:
+            {
+                integer val;
+                int ret;
+
+                if (f[-1].comp_.sz == 0)
+                    goto done;
+                ret = xpost_string_get(ctx, f[-1], 0, &val);
+                if (ret)
+                    return ret;
+                o[no++] = xpost_int_cons(val);
+                ++f[-1].comp_.off;
+                --f[-1].comp_.sz;
+                break;
+            }
+            case dicttype:
+                if (!xpost_dict_next_pair(ctx, &f[-1], &o[0], &o[1]))
+                    goto done;
+                no = 2;
+                break;
+            default:
+                return unregistered;
+        }
+    }
+    else
+        return unregistered;
+
+    /* f is invalid after these pushes */
+    if (no > 0 && !xpost_stack_push(ctx->lo, ctx->os, o[0]))
+        return stackoverflow;
+    if (no > 1 && !xpost_stack_push(ctx->lo, ctx->os, o[1]))
+        return stackoverflow;
+    if (!xpost_stack_push(ctx->lo, ctx->es, P))
         return execstackoverflow;
+    return 0;
+
+done:
+    if (!xpost_stack_pop_n(ctx->lo, ctx->es, size))
+        return execstackunderflow;
+    return 0;
+}
 
-    if (!xpost_stack_push(ctx->lo, ctx->es, lim))
+/* -  contfor  -
+   continue the loop frame beneath, when executed as an operator */
+static
+int xpost_op_contfor (Xpost_Context *ctx)
+{
+    if (!xpost_stack_push(ctx->lo, ctx->es,
+            xpost_operator_cons_opcode(ctx->opcode_shortcuts.contfor)))
         return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, incr))
+    return xpost_op_control_loop_step(ctx);
+}
+
+/* -  contrepeat  - */
+static
+int xpost_op_contrepeat (Xpost_Context *ctx)
+{
+    if (!xpost_stack_push(ctx->lo, ctx->es,
+            xpost_operator_cons_opcode(ctx->opcode_shortcuts.contrepeat)))
         return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_int_cons(i + j)))
+    return xpost_op_control_loop_step(ctx);
+}
+
+/* -  contloop  - */
+static
+int xpost_op_contloop (Xpost_Context *ctx)
+{
+    if (!xpost_stack_push(ctx->lo, ctx->es,
+            xpost_operator_cons_opcode(ctx->opcode_shortcuts.contloop)))
         return execstackoverflow;
+    return xpost_op_control_loop_step(ctx);
+}
 
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
+/* -  contforall  - */
+static
+int xpost_op_contforall (Xpost_Context *ctx)
+{
+    if (!xpost_stack_push(ctx->lo, ctx->es,
+            xpost_operator_cons_opcode(ctx->opcode_shortcuts.contforall)))
         return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->os, init))
-        return stackoverflow;
+    return xpost_op_control_loop_step(ctx);
+}
 
-    return 0;
+/* initial increment limit proc  for  -
+   execute proc with values from initial by steps
+   of increment to limit */
+static
+int xpost_op_int_int_int_proc_for (Xpost_Context *ctx,
+                                   Xpost_Object init,
+                                   Xpost_Object incr,
+                                   Xpost_Object lim,
+                                   Xpost_Object P)
+{
+    Xpost_Object state[3];
+
+    state[0] = lim;
+    state[1] = incr;
+    state[2] = init;
+    return _xpost_op_control_loop_begin(ctx, ctx->opcode_shortcuts.opfor,
+            P, 3, state, ctx->opcode_shortcuts.contfor);
 }
 
 /* same as IIIPfor but for reals */
@@ -152,30 +402,13 @@ int xpost_op_real_real_real_proc_for (Xpost_Context *ctx,
                                       Xpost_Object lim,
                                       Xpost_Object P)
 {
-    real i = init.real_.val;
-    real j = incr.real_.val;
-    real n = lim.real_.val;
-    int up = j > 0;
-    if (up? i > n : i < n) return 0;
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "for", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.opfor)))
-        return execstackoverflow;
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "cvx", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, lim))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, incr))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_real_cons(i + j)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->os, init))
-        return stackoverflow;
-    return 0;
+    Xpost_Object state[3];
+
+    state[0] = lim;
+    state[1] = incr;
+    state[2] = init;
+    return _xpost_op_control_loop_begin(ctx, ctx->opcode_shortcuts.opfor,
+            P, 3, state, ctx->opcode_shortcuts.contfor);
 }
 
 /* int proc  repeat  -
@@ -185,23 +418,8 @@ int xpost_op_int_proc_repeat (Xpost_Context *ctx,
                               Xpost_Object n,
                               Xpost_Object P)
 {
-    if (n.int_.val <= 0) return 0;
-
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.repeat)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es,
-                          xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
-        return execstackoverflow;
-
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_int_cons(n.int_.val - 1)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
-        return execstackoverflow;
-
-    return 0;
+    return _xpost_op_control_loop_begin(ctx, ctx->opcode_shortcuts.repeat,
+            P, 1, &n, ctx->opcode_shortcuts.contrepeat);
 }
 
 /* proc  loop  -
@@ -210,17 +428,19 @@ static
 int xpost_op_proc_loop (Xpost_Context *ctx,
                         Xpost_Object P)
 {
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "loop", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.loop)))
-        return execstackoverflow;
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "cvx", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
-        return execstackoverflow;
-    return 0;
+    return _xpost_op_control_loop_begin(ctx, ctx->opcode_shortcuts.loop,
+            P, 0, NULL, ctx->opcode_shortcuts.contloop);
+}
+
+/* run proc for each element of array or string C,
+   or each pair of dict C */
+int xpost_op_control_forall(Xpost_Context *ctx,
+                            Xpost_Object C,
+                            Xpost_Object P)
+{
+    C = xpost_object_cvlit(C);
+    return _xpost_op_control_loop_begin(ctx, ctx->opcode_shortcuts.forall,
+            P, 1, &C, ctx->opcode_shortcuts.contforall);
 }
 
 /* -  exit  -
@@ -228,75 +448,53 @@ int xpost_op_proc_loop (Xpost_Context *ctx,
 static
 int xpost_op_exit (Xpost_Context *ctx)
 {
-    //Xpost_Object opfor = xpost_operator_cons(ctx, "for", NULL,0,0);
-    Xpost_Object opfor = xpost_operator_cons_opcode(ctx->opcode_shortcuts.opfor);
-    //Xpost_Object oprepeat = xpost_operator_cons(ctx, "repeat", NULL,0,0);
-    Xpost_Object oprepeat = xpost_operator_cons_opcode(ctx->opcode_shortcuts.repeat);
-    //Xpost_Object oploop = xpost_operator_cons(ctx, "loop", NULL,0,0);
-    Xpost_Object oploop = xpost_operator_cons_opcode(ctx->opcode_shortcuts.loop);
-    //Xpost_Object opforall = xpost_operator_cons(ctx, "forall", NULL,0,0);
-    Xpost_Object opforall = xpost_operator_cons_opcode(ctx->opcode_shortcuts.forall);
     Xpost_Object x;
 
-#if 0
-    printf("\nexit\n");
-    xpost_object_dump(opfor);
-    xpost_object_dump(oprepeat);
-    xpost_object_dump(oploop);
-    xpost_object_dump(opforall);
-
-    xpost_stack_dump(ctx->lo, ctx->os);
-    xpost_stack_dump(ctx->lo, ctx->es);
-    printf("\n");
-#endif
+    if (_xpost_op_control_unwind(ctx, 0))
+        return 0;
 
+    /* no frame recorded: search es for the marker */
     while (1) {
         x = xpost_stack_pop(ctx->lo, ctx->es);
         if (xpost_object_get_type(x) == invalidtype)
             return execstackunderflow;
-        //xpost_object_dump(x);
-        if ((xpost_dict_compare_objects(ctx, x, opfor)    == 0) ||
-            (xpost_dict_compare_objects(ctx, x, oprepeat) == 0) ||
-            (xpost_dict_compare_objects(ctx, x, oploop)   == 0) ||
-            (xpost_dict_compare_objects(ctx, x, opforall) == 0))
-        {
+        if (_xpost_op_control_is_loop(ctx, x))
             break;
-        }
     }
-
-#if 0
-    printf("result:");
-    xpost_stack_dump(ctx->lo, ctx->es);
-#endif
     return 0;
 }
 
 /* The stopped context is a boolean 'false' on the exec stack,
    so normal execution simply falls through and pushes the
-   false onto the operand stack. 'stop' then merely has to
-   search for 'false' and push a 'true', popping as it goes.  */
+   false onto the operand stack. 'stop' then cuts es back to
+   the innermost one and pushes a 'true'.  */
 
 /* -  stop  -
    terminate stopped context */
 static
 int xpost_op_stop(Xpost_Context *ctx)
 {
-    Xpost_Object f = xpost_bool_cons(0);
-    int c = xpost_stack_count(ctx->lo, ctx->es);
+    int c;
     Xpost_Object x;
-    while (c--)
+
+    if (!_xpost_op_control_unwind(ctx, 1))
     {
-        x = xpost_stack_pop(ctx->lo, ctx->es);
-        if (xpost_object_get_type(x) == invalidtype)
-            return execstackunderflow;
-        if(xpost_dict_compare_objects(ctx, f, x) == 0) {
-            if (!xpost_stack_push(ctx->lo, ctx->os, xpost_bool_cons(1)))
-                return stackoverflow;
-            return 0;
+        c = xpost_stack_count(ctx->lo, ctx->es);
+        while (c--)
+        {
+            x = xpost_stack_pop(ctx->lo, ctx->es);
+            if (_xpost_op_control_is_stopped(x))
+                break;
+        }
+        if (c < 0)
+        {
+            XPOST_LOG_ERR("no stopped context in 'stop'");
+            return unregistered;
         }
     }
-    XPOST_LOG_ERR("no stopped context in 'stop'");
-    return unregistered;
+    if (!xpost_stack_push(ctx->lo, ctx->os, xpost_bool_cons(1)))
+        return stackoverflow;
+    return 0;
 }
 
 /* any  stopped  bool
@@ -305,6 +503,11 @@ static
 int xpost_op_any_stopped(Xpost_Context *ctx,
                          Xpost_Object o)
 {
+    int ret;
+
+    ret = _xpost_op_control_frame(ctx);
+    if (ret)
+        return ret;
     if (!xpost_stack_push(ctx->lo, ctx->es, xpost_bool_cons(0)))
         return execstackoverflow;
     if (!xpost_stack_push(ctx->lo, ctx->es, o))
@@ -346,6 +549,294 @@ int xpost_op_array_execstack(Xpost_Context *ctx,
     return 0;
 }
 
+/*
+   jumps in a compiled proc.
+   the jump operator is followed by an integer count of
+   instructions to skip. when the jump runs, the remainder of
+   the compiled proc is on top of es, starting at the count.
+ */
+static
+int _xpost_op_jump(Xpost_Context *ctx,
+                   int taken)
+{
+    Xpost_Object c;
+    Xpost_Object n;
+    integer skip;
+
+    c = xpost_stack_topdown_fetch(ctx->lo, ctx->es, 0);
+    if (xpost_object_get_type(c) != arraytype || c.comp_.sz == 0)
+        return unregistered;
+    n = xpost_array_get(ctx, c, 0);
+    if (xpost_object_get_type(n) != integertype)
+        return unregistered;
+    skip = taken ? 1 + n.int_.val : 1;
+    if (skip < 1 || skip > c.comp_.sz)
+        return rangecheck;
+    if (skip == c.comp_.sz)
+    {
+        (void)xpost_stack_pop(ctx->lo, ctx->es);
+        return 0;
+    }
+    c.comp_.off += skip;
+    c.comp_.sz -= skip;
+    if (!xpost_stack_topdown_replace(ctx->lo, ctx->es, 0, c))
+        return execstackunderflow;
+    return 0;
+}
+
+/* -  jump  -
+   skip the instructions counted by the following integer */
+static
+int xpost_op_jump (Xpost_Context *ctx)
+{
+    return _xpost_op_jump(ctx, 1);
+}
+
+/* bool  jumpunless  -
+   skip the instructions counted by the following integer
+   if bool is false */
+static
+int xpost_op_bool_jumpunless (Xpost_Context *ctx,
+                              Xpost_Object B)
+{
+    return _xpost_op_jump(ctx, !B.int_.val);
+}
+
+/* replace an executable name with the operator it names, as bind does */
+static
+Xpost_Object _xpost_op_compile_resolve(Xpost_Context *ctx,
+                                       Xpost_Object t)
+{
+    Xpost_Object d;
+    int j, z;
+
+    if (xpost_object_get_type(t) != nametype || !xpost_object_is_exe(t))
+        return t;
+    z = xpost_stack_count(ctx->lo, ctx->ds);
+    for (j = 0; j < z; j++)
+    {
+        d = xpost_stack_topdown_fetch(ctx->lo, ctx->ds, j);
+        if (xpost_dict_known_key(ctx, xpost_context_select_memory(ctx, d), d, t))
+        {
+            d = xpost_dict_get(ctx, d, t);
+            if (xpost_object_get_type(d) == operatortype)
+                return d;
+            break;
+        }
+    }
+    return t;
+}
+
+static
+int _xpost_op_compile_is_proc(Xpost_Object t)
+{
+    return xpost_object_get_type(t) == arraytype && xpost_object_is_exe(t);
+}
+
+static
+int _xpost_op_compile_is_op(Xpost_Object t,
+                            int opcode)
+{
+    return xpost_object_get_type(t) == operatortype
+        && t.mark_.padw == (dword)opcode;
+}
+
+/* store o at a[*n] and advance *n, or only count it if a is invalid */
+static
+int _xpost_op_compile_put(Xpost_Context *ctx,
+                          Xpost_Object a,
+                          unsigned int *n,
+                          Xpost_Object o)
+{
+    int ret;
+
+    if (xpost_object_get_type(a) == arraytype)
+    {
+        ret = xpost_array_put(ctx, a, *n, o);
+        if (ret)
+            return ret;
+    }
+    ++*n;
+    return 0;
+}
+
+/* emit a jump operator and a count to be patched, at *at */
+static
+int _xpost_op_compile_put_jump(Xpost_Context *ctx,
+                               Xpost_Object a,
+                               unsigned int *n,
+                               int opcode,
+                               unsigned int *at)
+{
+    int ret;
+
+    ret = _xpost_op_compile_put(ctx, a, n, xpost_operator_cons_opcode(opcode));
+    if (ret)
+        return ret;
+    *at = *n;
+    return _xpost_op_compile_put(ctx, a, n, xpost_int_cons(0));
+}
+
+/* set the count at a[at] to skip up to a[to] */
+static
+int _xpost_op_compile_patch(Xpost_Context *ctx,
+                            Xpost_Object a,
+                            unsigned int at,
+                            unsigned int to)
+{
+    if (xpost_object_get_type(a) != arraytype)
+        return 0;
+    return xpost_array_put(ctx, a, at, xpost_int_cons(to - at - 1));
+}
+
+static
+int _xpost_op_compile(Xpost_Context *ctx,
+                      Xpost_Object p,
+                      int depth,
+                      Xpost_Object *c);
+
+/*
+   emit the instructions for the elements of proc p into a,
+   starting at a[*n], or only count them if a is invalid.
+   `{..} if` and `{..} {..} ifelse` are lowered to jumps around
+   bodies emitted in line:
+       jumpunless n <then>
+       jumpunless n <then> jump m <else>
+   other procs are compiled separately.
+ */
+static
+int _xpost_op_compile_emit(Xpost_Context *ctx,
+                           Xpost_Object p,
+                           Xpost_Object a,
+                           unsigned int *n,
+                           int depth)
+{
+    Xpost_Object t, u, v;
+    unsigned int at, at2;
+    int i;
+    int ret;
+
+    if (depth > XPOST_OP_CONTROL_COMPILE_DEPTH)
+        return limitcheck;
+
+    for (i = 0; i < p.comp_.sz; i++)
+    {
+        t = _xpost_op_compile_resolve(ctx, xpost_array_get(ctx, p, i));
+        if (_xpost_op_compile_is_proc(t) && i + 1 < p.comp_.sz)
+        {
+            u = _xpost_op_compile_resolve(ctx, xpost_array_get(ctx, p, i + 1));
+            if (_xpost_op_compile_is_op(u, ctx->opcode_shortcuts.opif))
+            {
+                ret = _xpost_op_compile_put_jump(ctx, a, n,
+                        ctx->opcode_shortcuts.jumpunless, &at);
+                if (ret)
+                    return ret;
+                ret = _xpost_op_compile_emit(ctx, t, a, n, depth + 1);
+                if (ret)
+                    return ret;
+                ret = _xpost_op_compile_patch(ctx, a, at, *n);
+                if (ret)
+                    return ret;
+                ++i;
+                continue;
+            }
+            if (_xpost_op_compile_is_proc(u) && i + 2 < p.comp_.sz)
+            {
+                v = _xpost_op_compile_resolve(ctx, xpost_array_get(ctx, p, i + 2));
+                if (_xpost_op_compile_is_op(v, ctx->opcode_shortcuts.ifelse))
+                {
+                    ret = _xpost_op_compile_put_jump(ctx, a, n,
+                            ctx->opcode_shortcuts.jumpunless, &at);
+                    if (ret)
+                        return ret;
+                    ret = _xpost_op_compile_emit(ctx, t, a, n, depth + 1);
+                    if (ret)
+                        return ret;
+                    ret = _xpost_op_compile_put_jump(ctx, a, n,
+                            ctx->opcode_shortcuts.jump, &at2);
+                    if (ret)
+                        return ret;
+                    ret = _xpost_op_compile_emit(ctx, u, a, n, depth + 1);
+                    if (ret)
+                        return ret;
+                    ret = _xpost_op_compile_patch(ctx, a, at, at2 + 1);
+                    if (ret)
+                        return ret;
+                    ret = _xpost_op_compile_patch(ctx, a, at2, *n);
+                    if (ret)
+                        return ret;
+                    i += 2;
+                    continue;
+                }
+            }
+        }
+        if (_xpost_op_compile_is_proc(t) && xpost_object_get_type(a) == arraytype)
+        {
+            ret = _xpost_op_compile(ctx, t, depth + 1, &t);
+            if (ret)
+                return ret;
+        }
+        ret = _xpost_op_compile_put(ctx, a, n, t);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+/* compile proc p into a new read-only proc c */
+static
+int _xpost_op_compile(Xpost_Context *ctx,
+                      Xpost_Object p,
+                      int depth,
+                      Xpost_Object *c)
+{
+    Xpost_Object a;
+    unsigned int n = 0;
+    unsigned int vmmode;
+    int ret;
+
+    ret = _xpost_op_compile_emit(ctx, p, invalid, &n, depth);
+    if (ret)
+        return ret;
+    if (n > 0xffff) /* comp_.sz is a word */
+        return limitcheck;
+
+    /* allocate in the same vm as p, which can hold everything p holds */
+    vmmode = ctx->vmmode;
+    ctx->vmmode = (p.tag & XPOST_OBJECT_TAG_DATA_FLAG_BANK) ? GLOBAL : LOCAL;
+    a = xpost_array_cons(ctx, n);
+    ctx->vmmode = vmmode;
+    if (xpost_object_get_type(a) == nulltype)
+        return VMerror;
+    n = 0;
+    ret = _xpost_op_compile_emit(ctx, p, a, &n, depth);
+    if (ret)
+        return ret;
+    *c = xpost_object_set_access(ctx, xpost_object_cvx(a),
+                                 XPOST_OBJECT_TAG_ACCESS_READ_ONLY);
+    return 0;
+}
+
+/* proc  compile  proc
+   return a compiled copy of proc, in the same vm:
+   names of operators are replaced with the operators,
+   literal procs before if and ifelse become jumps,
+   and other procs within are compiled in turn */
+static
+int xpost_op_proc_compile (Xpost_Context *ctx,
+                           Xpost_Object P)
+{
+    Xpost_Object c;
+    int ret;
+
+    ret = _xpost_op_compile(ctx, P, 0, &c);
+    if (ret)
+        return ret;
+    if (!xpost_stack_push(ctx->lo, ctx->os, c))
+        return stackoverflow;
+    return 0;
+}
+
 /* -  quit  -
    terminate interpreter */
 static
@@ -374,8 +865,16 @@ int xpost_oper_init_control_ops (Xpost_Context *ctx,
     INSTALL;
     op = xpost_operator_cons(ctx, "if", (Xpost_Op_Func)xpost_op_bool_proc_if, 0, 2, booleantype, proctype);
     INSTALL;
+    ctx->opcode_shortcuts.opif = op.mark_.padw;
     op = xpost_operator_cons(ctx, "ifelse", (Xpost_Op_Func)xpost_op_bool_proc_proc_ifelse, 0, 3, booleantype, proctype, proctype);
     INSTALL;
+    ctx->opcode_shortcuts.ifelse = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "jump", (Xpost_Op_Func)xpost_op_jump, 0, 0);
+    ctx->opcode_shortcuts.jump = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "jumpunless", (Xpost_Op_Func)xpost_op_bool_jumpunless, 0, 1, booleantype);
+    ctx->opcode_shortcuts.jumpunless = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "compile", (Xpost_Op_Func)xpost_op_proc_compile, 1, 1, proctype);
+    INSTALL;
     op = xpost_operator_cons(ctx, "for", (Xpost_Op_Func)xpost_op_int_int_int_proc_for, 0, 4, \
                              integertype, integertype, integertype, proctype);
     INSTALL;
@@ -389,6 +888,14 @@ int xpost_oper_init_control_ops (Xpost_Context *ctx,
     op = xpost_operator_cons(ctx, "loop", (Xpost_Op_Func)xpost_op_proc_loop, 0, 1, proctype);
     INSTALL;
     ctx->opcode_shortcuts.loop = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "contfor", (Xpost_Op_Func)xpost_op_contfor, 0, 0);
+    ctx->opcode_shortcuts.contfor = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "contrepeat", (Xpost_Op_Func)xpost_op_contrepeat, 0, 0);
+    ctx->opcode_shortcuts.contrepeat = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "contloop", (Xpost_Op_Func)xpost_op_contloop, 0, 0);
+    ctx->opcode_shortcuts.contloop = op.mark_.padw;
+    op = xpost_operator_cons(ctx, "contforall", (Xpost_Op_Func)xpost_op_contforall, 0, 0);
+    ctx->opcode_shortcuts.contforall = op.mark_.padw;
     op = xpost_operator_cons(ctx, "exit", (Xpost_Op_Func)xpost_op_exit, 0, 0);
     INSTALL;
     op = xpost_operator_cons(ctx, "stop", (Xpost_Op_Func)xpost_op_stop, 0, 0);
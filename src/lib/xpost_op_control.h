@@ -33,4 +33,10 @@
 
 int xpost_oper_init_control_ops(Xpost_Context *ctx, Xpost_Object sd);
 
+/* run proc over an array, string or dict in a loop frame */
+int xpost_op_control_forall(Xpost_Context *ctx, Xpost_Object C, Xpost_Object P);
+
+/* run the next iteration of the loop frame on top of es */
+int xpost_op_control_loop_step(Xpost_Context *ctx);
+
 #endif
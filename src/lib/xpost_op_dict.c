@@ -51,6 +51,7 @@
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
 #include "xpost_op_stack.h"
+#include "xpost_op_control.h"
 #include "xpost_op_dict.h"
 
 int DEBUGLOAD = 0;
@@ -143,6 +144,7 @@ int xpost_op_dict_begin(Xpost_Context *ctx,
 {
     if (!xpost_stack_push(ctx->lo, ctx->ds, D))
         return dictstackoverflow;
+    xpost_context_name_cache_flush(ctx);
     return 0;
 }
 
@@ -154,6 +156,7 @@ int xpost_op_end(Xpost_Context *ctx)
     if (xpost_stack_count(ctx->lo, ctx->ds) <= 3)
         return dictstackunderflow;
     (void)xpost_stack_pop(ctx->lo, ctx->ds);
+    xpost_context_name_cache_flush(ctx);
     return 0;
 }
 
@@ -280,7 +283,6 @@ int xpost_op_dict_any_undef(Xpost_Context *ctx,
                             Xpost_Object D,
                             Xpost_Object K)
 {
-    XPOST_LOG_WARN("FIXME: undef doesn't adequately fix the chain");
     xpost_dict_undef(ctx, D, K);
     return 0;
 }
@@ -331,14 +333,13 @@ int xpost_op_dict_copy(Xpost_Context *ctx,
                        Xpost_Object S,
                        Xpost_Object D)
 {
-    int i, sz;
+    unsigned i, sz;
     Xpost_Memory_File *mem;
     unsigned ad;
     dicrec *tp;
     int ret;
 
     mem = xpost_context_select_memory(ctx, S);
-    sz = xpost_dict_max_length_memory (mem, S);
     ret = xpost_memory_table_get_addr(mem, xpost_object_get_ent(S), &ad);
     if (!ret)
     {
@@ -346,8 +347,9 @@ int xpost_op_dict_copy(Xpost_Context *ctx,
                 xpost_object_get_ent(S));
         return VMerror;
     }
+    sz = DICTABN((dichead *)(mem->base + ad));
     tp = (void *)(mem->base + ad + sizeof(dichead));
-    for (i = 0; i < DICTABN(sz); i++)
+    for (i = 0; i < sz; i++)
     {
         if (xpost_object_get_type(tp[i].key) != nulltype)
         {
@@ -367,66 +369,7 @@ int xpost_op_dict_proc_forall (Xpost_Context *ctx,
                                Xpost_Object D,
                                Xpost_Object P)
 {
-    Xpost_Memory_File *mem = xpost_context_select_memory(ctx, D);
-    assert(mem->base);
-    D.comp_.sz = xpost_dict_max_length_memory (mem, D); // cache size locally
-    if (D.comp_.off <= D.comp_.sz) // FIXME: not finished?
-    {
-        unsigned ad;
-        dicrec *tp; /* dict Table Pointer */
-        int ret;
-
-        ret = xpost_memory_table_get_addr(mem, xpost_object_get_ent(D), &ad);
-        if (!ret)
-        {
-            XPOST_LOG_ERR("cannot retrieve address for dict ent %u",
-                          xpost_object_get_ent(D));
-            return VMerror;
-        }
-        tp = (void *)(mem->base + ad + sizeof(dichead));
-
-        for ( ; D.comp_.off < DICTABN(D.comp_.sz); ++D.comp_.off) // find next pair
-        {
-            if (xpost_object_get_type(tp[D.comp_.off].key) != nulltype) // found
-            {
-                Xpost_Object k,v;
-
-                k = tp[D.comp_.off].key;
-                if (xpost_object_get_type(k) == extendedtype)
-                    k = xpost_dict_convert_extended_to_number(k);
-                v = tp[D.comp_.off].value;
-
-                if (!xpost_stack_push(ctx->lo, ctx->os, k))
-                    return stackoverflow;
-                if (!xpost_stack_push(ctx->lo, ctx->os, v))
-                    return stackoverflow;
-
-                if (!xpost_stack_push(ctx->lo, ctx->es,
-                                      xpost_operator_cons_opcode(ctx->opcode_shortcuts.forall)))
-                    return execstackoverflow;
-                if (!xpost_stack_push(ctx->lo, ctx->es,
-                                      xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-                    return execstackoverflow;
-                if (!xpost_stack_push(ctx->lo, ctx->es,
-                                      xpost_object_cvlit(P)))
-                    return execstackoverflow;
-
-                ++D.comp_.off; /* update offset in dict
-                                  before push for next iteration */
-                if (!xpost_stack_push(ctx->lo, ctx->es, D))
-                    return execstackoverflow;
-
-                if (!xpost_stack_push(ctx->lo, ctx->es, P))
-                    return execstackoverflow;
-
-                return 0; /* loop continues by ps continuation.
-                             thus, no need to recalc pointer since
-                             this function is re-entered from the
-                             beginning, with a new dict with ++D.comp_.off */
-            }
-        }
-    }
-    return 0;
+    return xpost_op_control_forall(ctx, D, P);
 }
 
 /* -  currentdict  dict
@@ -479,23 +422,9 @@ static
 int xpost_op_cleardictstack(Xpost_Context *ctx)
 {
     int z = xpost_stack_count(ctx->lo, ctx->ds);
-    while (z-- > 3)
-    {
-        (void)xpost_stack_pop(ctx->lo, ctx->ds);
-    }
-    /*
-    Xpost_Stack *ds;
-    unsigned int dsaddr;
-    int ret;
-
-    ret = xpost_memory_table_get_addr(ctx->lo, ctx->ds, &dsaddr);
-    if (!ret) {
-        XPOST_LOG_ERR("cannot retrieve address for dict stack");
-        return VMerror;
-    }
-    ds = (Xpost_Stack *)(ctx->lo->base + dsaddr);
-    ds->top = 3;
-    */
+    if (z > 3)
+        (void)xpost_stack_pop_n(ctx->lo, ctx->ds, z - 3);
+    xpost_context_name_cache_flush(ctx);
     return 0;
 }
 
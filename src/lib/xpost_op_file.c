@@ -158,15 +158,20 @@ int xpost_op_file_write (Xpost_Context *ctx,
 
 const char *hex = "0123456789" "ABCDEF" "abcdef";
 
+/* hex-encoded data is decoded and encoded through a buffer
+   of this many bytes */
+#define XPOST_OP_FILE_HEX_CHUNK 512
+
 static
-int read_hex_digit( Xpost_File *f, int *p )
+int hex_value(int c)
 {
-    int eof = 0;
-    do
-        if ((*p = xpost_file_getc(f)) == EOF)
-            ++eof;
-    while ( !eof && !strchr(hex, *p) );
-    return eof;
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
 }
 
 /* file string  readhexstring  substring true
@@ -177,29 +182,48 @@ int xpost_op_file_readhexstring (Xpost_Context *ctx,
                                  Xpost_Object F,
                                  Xpost_Object S)
 {
-    int n;
-    int c[2];
+    unsigned char buf[XPOST_OP_FILE_HEX_CHUNK];
+    int n, i, got, want;
+    int d, hi = -1;
     int eof = 0;
     Xpost_File *f;
-    char *s;
+    unsigned char *s;
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_readable(ctx,F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
-    s = xpost_string_get_pointer(ctx, S);
+    s = (unsigned char *)xpost_string_get_pointer(ctx, S);
 
-    for (n = 0; n < S.comp_.sz; n++)
+    /* each byte read yields at most one digit, so asking for
+       no more bytes than digits still needed never reads past
+       the end of the hex data */
+    n = 0;
+    while (n < S.comp_.sz)
     {
-        eof = read_hex_digit(f, &c[0]);
-	XPOST_LOG_INFO("read %c", c[0]);
-        if (!eof) eof = read_hex_digit(f, &c[1]);
-        if (eof) break;
-	XPOST_LOG_INFO("read %c", c[1]);
-        s[n] = ((strchr(hex, toupper(c[0])) - hex) << 4)
-             + (strchr(hex, toupper(c[1])) - hex);
+        want = 2 * (S.comp_.sz - n) - (hi >= 0);
+        if (want > (int)sizeof buf)
+            want = sizeof buf;
+        got = xpost_file_read((char *)buf, 1, want, f);
+        for (i = 0; i < got; i++)
+        {
+            d = hex_value(buf[i]);
+            if (d < 0)
+                continue;
+            if (hi < 0)
+                hi = d;
+            else
+            {
+                s[n++] = (hi << 4) | d;
+                hi = -1;
+            }
+        }
+        if (got < want)
+        {
+            eof = 1;
+            break;
+        }
     }
-    fflush(stdout);
     S.comp_.sz = n;
     xpost_stack_push(ctx->lo, ctx->os, S);
     xpost_stack_push(ctx->lo, ctx->os, xpost_bool_cons(!eof));
@@ -213,21 +237,25 @@ int xpost_op_file_writehexstring (Xpost_Context *ctx,
                                   Xpost_Object F,
                                   Xpost_Object S)
 {
-    int n;
+    char buf[XPOST_OP_FILE_HEX_CHUNK];
+    int n, k;
     Xpost_File *f;
-    char *s;
+    unsigned char *s;
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_writeable(ctx, F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
-    s = xpost_string_get_pointer(ctx, S);
+    s = (unsigned char *)xpost_string_get_pointer(ctx, S);
 
-    for (n = 0; n < S.comp_.sz; n++)
+    for (n = 0; n < S.comp_.sz; )
     {
-        if (xpost_file_putc(f, hex[s[n] / 16]) == EOF)
-            return ioerror;
-        if (xpost_file_putc(f, hex[s[n] % 16]) == EOF)
+        for (k = 0; k < (int)sizeof buf && n < S.comp_.sz; n++)
+        {
+            buf[k++] = hex[s[n] >> 4];
+            buf[k++] = hex[s[n] & 0xf];
+        }
+        if (xpost_file_write(buf, 1, k, f) != k)
             return ioerror;
     }
     return 0;
@@ -295,19 +323,39 @@ int xpost_op_file_readline (Xpost_Context *ctx,
 {
     Xpost_File *f;
     char *s;
-    int n, c = ' ';
+    unsigned char *nl;
+    int n, avail, c = ' ';
     if (!xpost_file_get_status(ctx->lo, F))
         return ioerror;
     if (!xpost_object_is_readable(ctx,F))
         return invalidaccess;
     f = xpost_file_get_file_pointer(ctx->lo, F);
     s = xpost_string_get_pointer(ctx, S);
-    for (n = 0; n < S.comp_.sz; n++)
+    n = 0;
+    while (n < S.comp_.sz)
     {
+        /* copy from the read window up to the newline */
+        avail = f->read_limit - f->read_next;
+        if (avail)
+        {
+            if (avail > S.comp_.sz - n)
+                avail = S.comp_.sz - n;
+            nl = memchr(f->read_next, '\n', avail);
+            if (nl)
+                avail = nl - f->read_next;
+            memcpy(s + n, f->read_next, avail);
+            n += avail;
+            f->read_next += avail;
+            if (!nl)
+                continue;
+            ++f->read_next;
+            c = '\n';
+            break;
+        }
         c = xpost_file_getc(f);
         if (c == EOF || c == '\n')
             break;
-        s[n] = c;
+        s[n++] = c;
     }
     if (n == S.comp_.sz && c != '\n')
         return rangecheck;
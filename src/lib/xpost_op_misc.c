@@ -272,6 +272,51 @@ int Odumpnames(Xpost_Context *ctx)
     return 0;
 }
 
+/* -  namecachestatus  hits misses
+   return the counts of executable name lookups
+   satisfied by and missing the name cache */
+static
+int namecachestatus(Xpost_Context *ctx)
+{
+    unsigned long hits = ctx->name_cache.hits;
+    unsigned long misses = ctx->name_cache.misses;
+    if (hits > 0x7fffffff) hits = 0x7fffffff; /* saturate */
+    if (misses > 0x7fffffff) misses = 0x7fffffff;
+    if (!xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)hits)))
+        return stackoverflow;
+    if (!xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons((integer)misses)))
+        return stackoverflow;
+    return 0;
+}
+
+/* -  dictprobehistogram  array
+   return the counts of dict lookups by number of table entries examined,
+   the last element counts all longer lookups */
+static
+int dictprobehistogram(Xpost_Context *ctx)
+{
+    const unsigned long *hist = xpost_dict_get_probe_histogram();
+    Xpost_Object a;
+    unsigned long n;
+    int i;
+    int ret;
+
+    a = xpost_array_cons(ctx, XPOST_DICT_PROBE_HIST_SIZE);
+    if (xpost_object_get_type(a) == nulltype)
+        return VMerror;
+    for (i = 0; i < XPOST_DICT_PROBE_HIST_SIZE; i++)
+    {
+        n = hist[i];
+        if (n > 0x7fffffff) n = 0x7fffffff; /* saturate */
+        ret = xpost_array_put(ctx, a, i, xpost_int_cons((integer)n));
+        if (ret)
+            return ret;
+    }
+    if (!xpost_stack_push(ctx->lo, ctx->os, a))
+        return stackoverflow;
+    return 0;
+}
+
 /*
 FIXME: interaction with file dump mechanism ?
 */
@@ -349,6 +394,10 @@ int xpost_oper_init_misc_ops(Xpost_Context *ctx,
     INSTALL;
     op = xpost_operator_cons(ctx, "dumpvm", (Xpost_Op_Func)dumpvm, 0, 0);
     INSTALL;
+    op = xpost_operator_cons(ctx, "namecachestatus", (Xpost_Op_Func)namecachestatus, 2, 0);
+    INSTALL;
+    op = xpost_operator_cons(ctx, "dictprobehistogram", (Xpost_Op_Func)dictprobehistogram, 1, 0);
+    INSTALL;
 
     /* xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
     xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "mark"), mark); */
@@ -46,8 +46,10 @@
 #include "xpost_context.h"
 #include "xpost_name.h"
 #include "xpost_string.h"
+#include "xpost_array.h"
 #include "xpost_dict.h"
 #include "xpost_error.h"
+#include "xpost_free.h"
 
 #include "xpost_garbage.h"
 //#include "xpost_interpreter.h"
@@ -61,16 +63,23 @@ int vmreclaim (Xpost_Context *ctx, Xpost_Object I)
     {
         default: return rangecheck;
         case -2: /* disable automatic collection in local and global vm */
+            ctx->gl->autocollect = 0;
+            ctx->lo->autocollect = 0;
             break;
         case -1: /* disable automatic collection in local vm */
+            ctx->lo->autocollect = 0;
             break;
         case 0: /* enable automatic collection */
+            ctx->gl->autocollect = 1;
+            ctx->lo->autocollect = 1;
             break;
         case 1: /* perform immediate collection in local vm */
+            xpost_garbage_request_full(ctx->lo);
             if (ctx->garbage_collect_function(ctx->lo, 1, 0) == -1)
                 return VMerror;
             break;
-        case 2: /* perform immediate collection in local and global vm */
+        case 2: /* perform immediate collection in global vm,
+                   which sweeps every local vm too */
             if (ctx->garbage_collect_function(ctx->gl, 1, 1) == -1)
                 return VMerror;
             break;
@@ -78,6 +87,24 @@ int vmreclaim (Xpost_Context *ctx, Xpost_Object I)
     return 0;
 }
 
+/* int  setvmthreshold  -
+   set the least number of bytes to allocate between automatic collections,
+   in both local and global vm. -1 restores the default.
+   a vm with more live data waits longer (see xpost_free_schedule). */
+static
+int setvmthreshold (Xpost_Context *ctx, Xpost_Object I)
+{
+    int threshold = I.int_.val;
+
+    if (threshold == -1)
+        threshold = XPOST_GARBAGE_COLLECTION_THRESHOLD;
+    else if (threshold < 0)
+        return rangecheck;
+    xpost_free_set_threshold(ctx->gl, threshold);
+    xpost_free_set_threshold(ctx->lo, threshold);
+    return 0;
+}
+
 static
 int vmstatus (Xpost_Context *ctx)
 {
@@ -91,7 +118,9 @@ int vmstatus (Xpost_Context *ctx)
         return VMerror;
     }
     lev = xpost_stack_count(ctx->lo, vstk);
-    used = ctx->gl->used + ctx->lo->used;
+    /* memory on the free lists is available, not used */
+    used = ctx->gl->used - xpost_free_get_size(ctx->gl)
+        + ctx->lo->used - xpost_free_get_size(ctx->lo);
     max = ctx->gl->max + ctx->lo->max;
 
     if (!xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(lev)))
@@ -128,6 +157,43 @@ int globalvmstatus (Xpost_Context *ctx)
     return 0;
 }
 
+/* -  vmbinstatus  array
+   return an array of [size count bytes reused] for each free list
+   of local vm that holds or has served any allocation.
+   size is the smallest size on the list, count and bytes describe
+   the ents it holds, reused the allocations it has served. */
+static
+int vmbinstatus (Xpost_Context *ctx)
+{
+    Xpost_Object a, e;
+    unsigned int st[XPOST_FREE_BINS][4];
+    int i, j, n;
+    int ret;
+
+    /* take the statistics before allocating, which may change them */
+    for (i = n = 0; i < XPOST_FREE_BINS
+             && xpost_free_get_bin_stats(ctx->lo, i, &st[n][0], &st[n][1], &st[n][2], &st[n][3]); i++)
+        if (st[n][1] || st[n][3])
+            ++n;
+    a = xpost_array_cons(ctx, n);
+    if (xpost_object_get_type(a) == nulltype)
+        return VMerror;
+    for (i = 0; i < n; i++)
+    {
+        e = xpost_array_cons(ctx, 4);
+        if (xpost_object_get_type(e) == nulltype)
+            return VMerror;
+        for (j = 0; j < 4; j++)
+            xpost_array_put(ctx, e, j, xpost_int_cons(st[i][j]));
+        ret = xpost_array_put(ctx, a, i, e);
+        if (ret)
+            return ret;
+    }
+
+    if (!xpost_stack_push(ctx->lo, ctx->os, a))
+        return stackoverflow;
+    return 0;
+}
 
 int xpost_oper_init_param_ops(Xpost_Context *ctx,
                               Xpost_Object sd)
@@ -142,10 +208,14 @@ int xpost_oper_init_param_ops(Xpost_Context *ctx,
 
     op = xpost_operator_cons(ctx, "vmreclaim", (Xpost_Op_Func)vmreclaim, 0, 1, integertype);
     INSTALL;
+    op = xpost_operator_cons(ctx, "setvmthreshold", (Xpost_Op_Func)setvmthreshold, 0, 1, integertype);
+    INSTALL;
     op = xpost_operator_cons(ctx, "vmstatus", (Xpost_Op_Func)vmstatus, 3, 0);
     INSTALL;
     op = xpost_operator_cons(ctx, "globalvmstatus", (Xpost_Op_Func)globalvmstatus, 3, 0);
     INSTALL;
+    op = xpost_operator_cons(ctx, "vmbinstatus", (Xpost_Op_Func)vmbinstatus, 1, 0);
+    INSTALL;
 
     /* xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
     op = xpost_operator_cons(ctx, "save", (Xpost_Op_Func)Zsave, 1, 0);
@@ -48,6 +48,7 @@
 #include "xpost_name.h"
 #include "xpost_string.h"
 #include "xpost_dict.h"
+#include "xpost_garbage.h" /* restore frees what it leaves behind */
 
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
@@ -71,6 +72,7 @@ int Vrestore(Xpost_Context *ctx,
              Xpost_Object V)
 {
     int z;
+    int restored;
     unsigned int vs;
     int ret;
 
@@ -82,11 +84,15 @@ int Vrestore(Xpost_Context *ctx,
         return VMerror;
     }
     z = xpost_stack_count(ctx->lo, vs);
+    restored = z > V.save_.lev;
     while(z > V.save_.lev)
     {
         xpost_save_restore_snapshot(ctx->lo);
         z--;
     }
+    xpost_context_name_cache_flush(ctx);
+    if (restored && xpost_garbage_release(ctx->lo, V.save_.lev) < 0)
+        return VMerror;
     printf("restore\n");
     return 0;
 }
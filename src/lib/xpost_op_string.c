@@ -48,6 +48,7 @@
 
 //#include "xpost_interpreter.h"
 #include "xpost_operator.h"
+#include "xpost_op_control.h"
 #include "xpost_op_string.h"
 
 static
@@ -250,40 +251,7 @@ int Sforall(Xpost_Context *ctx,
             Xpost_Object S,
             Xpost_Object P)
 {
-    Xpost_Object interval;
-    integer val;
-    int ret;
-
-    if (S.comp_.sz == 0) return 0;
-    assert(ctx->gl->base);
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "forall", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.forall)))
-        return execstackoverflow;
-    //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "cvx", NULL,0,0));
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(P)))
-        return execstackoverflow;
-    interval = xpost_object_get_interval(S, 1, S.comp_.sz-1);
-    if (xpost_object_get_type(interval) == invalidtype)
-        return rangecheck;
-    if (!xpost_stack_push(ctx->lo, ctx->es, xpost_object_cvlit(interval)))
-        return execstackoverflow;
-    if (!xpost_stack_push(ctx->lo, ctx->es, P))
-        return execstackoverflow;
-    if (!xpost_object_is_exe(S))
-    {
-        //xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons(ctx, "cvx", NULL,0,0));
-        if (!xpost_stack_push(ctx->lo, ctx->es, xpost_operator_cons_opcode(ctx->opcode_shortcuts.cvx)))
-            return execstackoverflow;
-    }
-
-    ret = xpost_string_get(ctx, S, 0, &val);
-    if (ret)
-        return ret;
-    if (!xpost_stack_push(ctx->lo, ctx->os, xpost_int_cons(val)))
-        return stackoverflow;
-    return 0;
+    return xpost_op_control_forall(ctx, S, P);
 }
 
 // token : see optok.c
@@ -62,493 +62,575 @@
 
 enum { NBUF = 2 * BUFSIZ };
 
-static
-int puff(Xpost_Context *ctx,
-         char *buf,
-         int nbuf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src));
-static
-int toke(Xpost_Context *ctx,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
-         Xpost_Object *retval);
+/*
+   The scanner reads from a contiguous window of bytes,
+   *next up to *limit.
+   For a string source the window is the remaining contents
+   of the string. For a file source it is the file's own read
+   window (see xpost_file.h), so buffered, memory and mapped
+   files are scanned in place. Once a file's window is
+   exhausted, the scanner falls back to the readch method one
+   byte at a time, which refills buffered files.
+
+   A string lives in VM, which may move when allocating.
+   So the string window is re-derived from the object
+   (scanner_load) at the start of each token, and the bytes
+   consumed are written back to the object (scanner_sync)
+   before scanning a nested token.
+ */
+typedef struct
+{
+    Xpost_Context *ctx;
+    Xpost_Object *src;     /* string source, updated by scanner_sync */
+    Xpost_File *file;      /* file source, NULL for a string */
+    unsigned char *start;  /* string window */
+    unsigned char *snext;
+    unsigned char *slimit;
+    unsigned char **next;  /* current window */
+    unsigned char **limit;
+} scanner;
+
+/* character classes */
+enum
+{
+    CC_SPACE = 1,
+    CC_DELIM = 2
+};
+
+static const unsigned char cclass[256] =
+{
+    ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE,
+    ['\f'] = CC_SPACE, ['\r'] = CC_SPACE, [' '] = CC_SPACE,
+    ['('] = CC_DELIM, [')'] = CC_DELIM, ['<'] = CC_DELIM, ['>'] = CC_DELIM,
+    ['['] = CC_DELIM, [']'] = CC_DELIM, ['{'] = CC_DELIM, ['}'] = CC_DELIM,
+    ['/'] = CC_DELIM, ['%'] = CC_DELIM
+};
 
 static
-int ishash(int c)
+int isspc(int c)
 {
-    return c == '#';
+    return c != EOF && (cclass[c & 0xff] & CC_SPACE);
 }
 
 static
-int isdot(int c)
+int isdel(int c)
 {
-    return c == '.';
+    return c != EOF && (cclass[c & 0xff] & CC_DELIM);
 }
 
-/* FIXME: return (c == 'e') || (c = 'E') faster ? */
 static
-int ise(int c)
+int isreg(int c)
 {
-    return strchr("eE", c) != NULL;
+    return c != EOF && !cclass[c & 0xff];
 }
 
-/* FIXME: see FIXME above */
 static
-int issign(int c)
+int isdig(int c)
 {
-    return strchr("+-", c) != NULL;
+    return (unsigned)(c - '0') < 10;
 }
 
-/* FIXME: see FIXME above */
 static
-int isdel(int c)
+int hexval(int c)
 {
-    return strchr("()[]<>{}/%", c) != NULL;
+    if (isdig(c)) return c - '0';
+    if ((unsigned)(c - 'A') < 6) return c - 'A' + 10;
+    if ((unsigned)(c - 'a') < 6) return c - 'a' + 10;
+    return -1;
 }
 
 static
-int isreg(int c)
+void scanner_load(scanner *sc)
 {
-    return (c != EOF) && (!isspace(c)) && (!isdel(c));
+    if (sc->file)
+        return;
+    sc->start = sc->snext =
+        (unsigned char *)xpost_string_get_pointer(sc->ctx, *sc->src);
+    sc->slimit = sc->start + sc->src->comp_.sz;
 }
 
-//int isxdigit (int c) { return strchr("0123456789ABCDEFabcdef", c) != NULL; }
-
-typedef
-struct
-{
-    int (*pred)(int);
-    int y;
-    int n;
-} test;
-
-test fsm_dec[] = {
-    /*  int pred(int), y,  n */
-    /*       -------- --  -- */
-    /* 0 */ { issign,  1,  1 },
-    /* 1 */ { isdigit, 2, -1 },
-    /* 2 */ { isdigit, 2, -1 } };
 static
-int accept_dec(int i)
+void scanner_sync(scanner *sc)
 {
-    return i == 2;
+    unsigned int n;
+
+    if (sc->file)
+        return;
+    n = sc->snext - sc->start;
+    sc->src->comp_.off += n;
+    sc->src->comp_.sz -= n;
+    sc->start = sc->snext;
 }
 
-test fsm_rad[] = {
-    /* 0 */ { isdigit, 1, -1 },
-    /* 1 */ { isdigit, 1,  2 },
-    /* 2 */ { ishash,  3, -1 },
-    /* 3 */ { isalnum, 4, -1 },
-    /* 4 */ { isalnum, 4, -1 } };
 static
-int accept_rad(int i)
+void scanner_init_string(scanner *sc, Xpost_Context *ctx, Xpost_Object *S)
 {
-    return i == 4;
+    sc->ctx = ctx;
+    sc->src = S;
+    sc->file = NULL;
+    sc->next = &sc->snext;
+    sc->limit = &sc->slimit;
 }
 
-test fsm_real[] = {
-    /* 0 */  { issign,  1,   1 },
-    /* 1 */  { isdigit, 2,   4 },
-    /* 2 */  { isdigit, 2,   3 },
-    /* 3 */  { isdot,   6,   7 },
-    /* 4 */  { isdot,   5,  -1 },
-    /* 5 */  { isdigit, 6,  -1 },
-    /* 6 */  { isdigit, 6,   7 },
-    /* 7 */  { ise,     8,  -1 },
-    /* 8 */  { issign,  9,   9 },
-    /* 9 */  { isdigit, 10, -1 },
-    /* 10 */ { isdigit, 10, -1 } };
 static
-int accept_real(int i)
+void scanner_init_file(scanner *sc, Xpost_Context *ctx, Xpost_File *f)
 {
-    switch (i) { //case 2:
-        case 6: case 10: return 1; default: return 0; }
-    //return (i & 3) == 2;  // 2, 6 == 2|4, 10 == 2|8
+    sc->ctx = ctx;
+    sc->src = NULL;
+    sc->file = f;
+    sc->next = &f->read_next;
+    sc->limit = &f->read_limit;
 }
 
 static
-int fsm_check(char *s,
-              int ns,
-              test *fsm,
-              int (*accept)(int final))
+int getch(scanner *sc)
 {
-    int sta = 0;
-    char *sp = s;
-    while (sta != -1 && *sp)
-    {
-        if (sp - s > ns) break;
-        if (fsm[sta].pred(*sp))
-        {
-            sta = fsm[sta].y;
-            ++sp;
-        }
-        else
-        {
-            sta = fsm[sta].n;
-        }
-    }
-    return accept(sta);
+    if (*sc->next < *sc->limit)
+        return *(*sc->next)++;
+    if (sc->file)
+        return sc->file->methods->readch(sc->file);
+    return EOF;
 }
 
+/* put back the character just read */
 static
-int grok(Xpost_Context *ctx,
-         char *s,
-         int ns,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
-         Xpost_Object *retval)
+void backch(scanner *sc, int c)
 {
-    Xpost_Object obj;
-    //printf("grok: %s\n", s);
-
-    if (ns == NBUF)
-    {
-        XPOST_LOG_ERR("buf maxxed");
-        return limitcheck;
-    }
-    s[ns] = '\0';  //fsm_check & xpost_name_cons  terminate on \0
+    if (c == EOF)
+        return;
+    if (sc->file)
+        (void)xpost_file_ungetc(sc->file, c);
+    else
+        --*sc->next;
+}
 
-    if (fsm_check(s, ns, fsm_dec, accept_dec))
+/* classify the token in s as integer, radix number, real or name
+   in a single pass. sets *isnum and *retval for a number. */
+static
+int grok_number(char *s,
+                int ns,
+                int *isnum,
+                Xpost_Object *retval)
+{
+    const char *p = s;
+    const char *end = s + ns;
+    int neg = 0;
+    int ndig = 0;
+    int nfrac = 0;
+    int dot = 0;
+    long val = 0;
+
+    *isnum = 0;
+    if (p < end && (*p == '+' || *p == '-'))
+        neg = *p++ == '-';
+    for ( ; p < end && isdig(*p); ++p, ++ndig)
+        val = val * 10 + (*p - '0');
+
+    if (p == end)
     {
-        long num;
-        num = strtol(s, NULL, 10);
-        if ((num == LONG_MAX || num == LONG_MIN) && errno==ERANGE)
+        if (!ndig)
+            return 0;
+        if (ndig > 9) /* may overflow, let strtol check */
         {
-            XPOST_LOG_ERR("integer out of range");
-            return limitcheck;
+            errno = 0;
+            val = strtol(s, NULL, 10);
+            if ((val == LONG_MAX || val == LONG_MIN) && errno == ERANGE)
+            {
+                XPOST_LOG_ERR("integer out of range");
+                return limitcheck;
+            }
         }
-        //return xpost_int_cons(num);
-        *retval = xpost_int_cons(num);
+        else if (neg)
+            val = -val;
+        *retval = xpost_int_cons(val);
+        *isnum = 1;
         return 0;
     }
 
-    else if (fsm_check(s, ns, fsm_rad, accept_rad))
+    if (*p == '#')
     {
-        long base, num;
-        base = strtol(s, &s, 10);
+        long base;
+        const char *q;
+
+        if (!ndig || s != p - ndig || ++p == end)
+            return 0;
+        for (q = p; q < end; ++q)
+            if (!isalnum((unsigned char)*q))
+                return 0;
+        base = strtol(s, NULL, 10);
         if ((base > 36) || (base < 2))
         {
             XPOST_LOG_ERR("bad radix");
             return limitcheck;
         }
         errno = 0;
-        num = strtol(s + 1, NULL, base);
-        if ((num == LONG_MAX || num == LONG_MIN) && errno == ERANGE)
+        val = strtol(p, NULL, base);
+        if ((val == LONG_MAX || val == LONG_MIN) && errno == ERANGE)
         {
             XPOST_LOG_ERR("radixnumber out of range");
             return limitcheck;
         }
-        //return xpost_int_cons(num);
-        *retval = xpost_int_cons(num);
+        *retval = xpost_int_cons(val);
+        *isnum = 1;
         return 0;
     }
 
-    else if (fsm_check(s, ns, fsm_real, accept_real))
+    if (*p == '.')
+    {
+        dot = 1;
+        for (++p; p < end && isdig(*p); ++p)
+            ++nfrac;
+        if (!ndig && !nfrac)
+            return 0;
+    }
+    else if (!ndig)
+        return 0;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        int nexp = 0;
+
+        ++p;
+        if (p < end && (*p == '+' || *p == '-'))
+            ++p;
+        for ( ; p < end && isdig(*p); ++p)
+            ++nexp;
+        if (!nexp)
+            return 0;
+    }
+    else if (!dot)
+        return 0;
+
+    if (p != end)
+        return 0;
+
     {
         double num;
+
+        errno = 0;
         num = strtod(s, NULL);
         if ((num == HUGE_VAL || num == -HUGE_VAL) && errno == ERANGE)
         {
             XPOST_LOG_ERR("real out of range");
             return limitcheck;
         }
-        //return xpost_real_cons(num);
         *retval = xpost_real_cons((real)num);
-        return 0;
+        *isnum = 1;
     }
+    return 0;
+}
 
-    else
-        switch(*s)
+/* read in a token up to delimiter
+   read into buf any regular characters,
+   if we read one too many, put it back, unless whitespace. */
+static
+int puff(char *buf,
+         int nbuf,
+         scanner *sc)
+{
+    int c;
+    char *s = buf;
+
+    for (;;)
+    {
+        unsigned char *p = *sc->next;
+        unsigned char *lim = *sc->limit;
+
+        /* copy the run of regular characters straight from the window */
+        if (lim - p > nbuf - (s - buf))
+            lim = p + (nbuf - (s - buf));
+        while (p < lim && !cclass[*p])
+            *s++ = *p++;
+        *sc->next = p;
+
+        c = getch(sc);
+        if (!isreg(c))
+            break;
+        if (s - buf >= nbuf) return 0;
+        *s++ = c;
+    }
+    if (!isspc(c) && c != EOF) backch(sc, c);
+    return s - buf;
+}
+
+/* read until a non-whitespace, non-comment char.
+   "prime" the buffer.  */
+static
+int snip(char *buf,
+         scanner *sc)
+{
+    int c;
+    do {
+        c = getch(sc);
+        if (c == '%')
         {
-            case '(':
-            {
-                int c, defer = 1;
-                char *sp = s;
-                while (defer && (c = next(ctx, src)) != EOF)
-                {
-                    switch(c)
-                    {
-                        case '(': ++defer; break;
-                        case ')': --defer; break;
-                        case '\\':
-                            switch(c = next(ctx, src))
-                            {
-                                case '\n': continue;
-                                case 'a': c = '\a'; break;
-                                case 'b': c = '\b'; break;
-                                case 'f': c = '\f'; break;
-                                case 'n': c = '\n'; break;
-                                case 'r': c = '\r'; break;
-                                case 't': c = '\t'; break;
-                                case 'v': c = '\v'; break;
-                                default:
-                                    if (isdigit(c))
-                                    {
-                                        int t = 0, n = 0;
-                                        do {
-                                            t *= 8;
-                                            t += c - '0';
-                                            ++n;
-                                            c = next(ctx, src);
-                                        } while (isdigit(c) && n < 3);
-                                        if (!isdigit(c)) back(ctx, c, src);
-                                        c = t;
-                                    }
-                            }
-                    }
-                    if (!defer) break;
-                    if (sp - s > NBUF)
-                    {
-                        XPOST_LOG_ERR("string exceeds buf");
-                        return limitcheck;
-                    }
-                    else *sp++ = c;
-                }
-                obj = xpost_string_cons(ctx, sp - s, s);
-                if (xpost_object_get_type(obj) == nulltype)
-                    return VMerror;
-                //return xpost_object_cvlit(obj);
-                *retval = xpost_object_cvlit(obj);
-                return 0;
-            }
+            do {
+                c = getch(sc);
+            } while(c != '\n' && c != '\f' && c != EOF);
+        }
+    } while(isspc(c));
+    if (c == EOF) return 0;
+    *buf = c;
+    return 1; // true, and size of buffer
+}
+
+static
+int grok(Xpost_Context *ctx,
+         char *s,
+         int ns,
+         scanner *sc,
+         Xpost_Object *retval)
+{
+    Xpost_Object obj;
+    int isnum;
+    int ret;
+    //printf("grok: %s\n", s);
+
+    if (ns == NBUF)
+    {
+        XPOST_LOG_ERR("buf maxxed");
+        return limitcheck;
+    }
+    s[ns] = '\0';  //strtol & strtod terminate on \0
+
+    if (!isdel((unsigned char)*s))
+    {
+        ret = grok_number(s, ns, &isnum, retval);
+        if (ret || isnum)
+            return ret;
+    }
 
-            case '<':
+    switch(*s)
+    {
+        case '(':
+        {
+            int c, defer = 1;
+            char *sp = s;
+            while (defer)
             {
-                int c;
-                char d;
-                const char *x = "0123456789ABCDEF";
-                char *sp = s;
-                c = next(ctx, src);
-                if (c == '<')
+                unsigned char *p = *sc->next;
+                unsigned char *lim = *sc->limit;
+
+                /* copy the run of plain characters straight from the window */
+                if (lim - p > NBUF - (sp - s))
+                    lim = p + (NBUF - (sp - s));
+                while (p < lim && *p != '(' && *p != ')' && *p != '\\')
+                    *sp++ = *p++;
+                *sc->next = p;
+
+                if ((c = getch(sc)) == EOF)
+                    break;
+                switch(c)
                 {
-                    //return xpost_object_cvx(xpost_name_cons(ctx, "<<"));
-                    *retval = xpost_object_cvx(xpost_name_cons(ctx, "<<"));
-                    return 0;
+                    case '(': ++defer; break;
+                    case ')': --defer; break;
+                    case '\\':
+                        switch(c = getch(sc))
+                        {
+                            case '\n': continue;
+                            case 'a': c = '\a'; break;
+                            case 'b': c = '\b'; break;
+                            case 'f': c = '\f'; break;
+                            case 'n': c = '\n'; break;
+                            case 'r': c = '\r'; break;
+                            case 't': c = '\t'; break;
+                            case 'v': c = '\v'; break;
+                            default:
+                                if (isdig(c))
+                                {
+                                    int t = 0, n = 0;
+                                    do {
+                                        t *= 8;
+                                        t += c - '0';
+                                        ++n;
+                                        c = getch(sc);
+                                    } while (isdig(c) && n < 3);
+                                    backch(sc, c);
+                                    c = t;
+                                }
+                        }
                 }
-                for ( ; c != '>' && c != EOF; c = next(ctx, src))
+                if (!defer) break;
+                if (sp - s >= NBUF)
                 {
-                    if (isspace(c))
-                        continue;
-                    if (isxdigit(c))
-                        c = strchr(x, toupper(c)) - x;
-                    else
-                    {
-                        XPOST_LOG_ERR("non-hex digit in hex string");
-                        return syntaxerror;
-                    }
-                    d = c << 4; // hi nib
-                    while (isspace(c = next(ctx, src)))
-                        /**/;
-                    if (isxdigit(c))
-                        c = strchr(x, toupper(c)) - x;
-                    else if (c == '>')
-                    {
-                        back(ctx, c, src); // pushback for next iter
-                        c = 0;             // pretend it got a 0
-                    }
-                    else
-                    {
-                        XPOST_LOG_ERR("non-hex digit in hex string");
-                        return syntaxerror;
-                    }
-                    d |= c;
-                    if (sp - s > NBUF)
-                    {
-                        XPOST_LOG_ERR("hexstring exceeds buf");
-                        return limitcheck;
-                    }
-                    *sp++ = d;
+                    XPOST_LOG_ERR("string exceeds buf");
+                    return limitcheck;
                 }
-                obj = xpost_string_cons(ctx, sp - s, s);
-                if (xpost_object_get_type(obj) == nulltype)
-                    return VMerror;
-                //return xpost_object_cvlit(obj);
-                *retval = xpost_object_cvlit(obj);
-                return 0;
+                else *sp++ = c;
             }
+            obj = xpost_string_cons(ctx, sp - s, s);
+            if (xpost_object_get_type(obj) == nulltype)
+                return VMerror;
+            *retval = xpost_object_cvlit(obj);
+            return 0;
+        }
 
-            case '>':
+        case '<':
+        {
+            int c, d;
+            char *sp = s;
+            c = getch(sc);
+            if (c == '<')
             {
-                int c;
-                if ((c = next(ctx, src)) == '>')
+                *retval = xpost_object_cvx(xpost_name_cons(ctx, "<<"));
+                return 0;
+            }
+            for ( ; c != '>' && c != EOF; c = getch(sc))
+            {
+                if (isspc(c))
+                    continue;
+                if ((d = hexval(c)) < 0)
                 {
-                    //return xpost_object_cvx(xpost_name_cons(ctx, ">>"));
-                    *retval = xpost_object_cvx(xpost_name_cons(ctx, ">>"));
-                    return 0;
+                    XPOST_LOG_ERR("non-hex digit in hex string");
+                    return syntaxerror;
                 }
+                d <<= 4; // hi nib
+                while (isspc(c = getch(sc)))
+                    /**/;
+                if (hexval(c) >= 0)
+                    d |= hexval(c);
+                else if (c == '>')
+                    backch(sc, c); // pushback for next iter, pretend it got a 0
                 else
                 {
-                    XPOST_LOG_ERR("bare angle bracket");
+                    XPOST_LOG_ERR("non-hex digit in hex string");
                     return syntaxerror;
                 }
-            }
-            return unregistered; //not reached
-
-            case '{':
-            { // This is the one part that makes it a recursive-descent parser
-                int ret;
-                Xpost_Object tail;
-                tail = xpost_name_cons(ctx, "}");
-                xpost_stack_push(ctx->lo, ctx->os, mark);
-                while (1)
+                if (sp - s >= NBUF)
                 {
-                    Xpost_Object t;
-                    ret = toke(ctx, src, next, back, &t);
-                    //printf("grok: x?%d", xpost_object_is_exe(t));
-                    if (ret)
-                        return ret;
-                    if ((xpost_object_get_type(t) == nametype) &&
-                        (xpost_dict_compare_objects(ctx, t, tail) == 0))
-                        break;
-                    xpost_stack_push(ctx->lo, ctx->os, t);
+                    XPOST_LOG_ERR("hexstring exceeds buf");
+                    return limitcheck;
                 }
-                ret = xpost_op_array_to_mark(ctx);  // ie. the /] operator
-                if (ret)
-                    return ret;
-                //return xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
-                *retval = xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
+                *sp++ = d;
+            }
+            obj = xpost_string_cons(ctx, sp - s, s);
+            if (xpost_object_get_type(obj) == nulltype)
+                return VMerror;
+            *retval = xpost_object_cvlit(obj);
+            return 0;
+        }
+
+        case '>':
+        {
+            if (getch(sc) == '>')
+            {
+                *retval = xpost_object_cvx(xpost_name_cons(ctx, ">>"));
                 return 0;
             }
+            else
+            {
+                XPOST_LOG_ERR("bare angle bracket");
+                return syntaxerror;
+            }
+        }
 
-            case '/':
+        case '{':
+        { // This is the one part that makes it a recursive-descent parser
+            /* the '{' in s is consumed, so s is reused
+               for the body, and for any nested bodies */
+            xpost_stack_push(ctx->lo, ctx->os, mark);
+            while (1)
             {
-                *s = next(ctx, src);
-                //ns = puff(ctx, s, NBUF, src, next, back);
-                if (ns && *s == '/')
-                {
-                    Xpost_Object ret;
-                    ns = puff(ctx, s, NBUF, src, next, back);
-                    if (ns == NBUF)
-                    {
-                        XPOST_LOG_ERR("immediate name exceeds buf");
-                        return limitcheck;
-                    }
-                    s[ns] = '\0';
-                    //xpost_stack_push(ctx->lo, ctx->os, xpost_object_cvx(xpost_name_cons(ctx, s)));
-                    //xpost_operator_exec(ctx, xpost_operator_cons(ctx, "load", NULL,0,0).mark_.padw);
-                    if (DEBUGLOAD)
-                        printf("\ntoken: loading immediate name %s\n", s);
-                    xpost_op_any_load(ctx, xpost_object_cvx(xpost_name_cons(ctx, s)));
-                    ret = xpost_stack_pop(ctx->lo, ctx->os);
-                    if (DEBUGLOAD)
-                        xpost_object_dump(ret);
-                    //return ret;
-                    *retval = ret;
-                    return 0;
-                }
-                else
+                Xpost_Object t;
+                scanner_sync(sc);
+                scanner_load(sc);
+                ns = snip(s, sc);
+                if (!ns)
                 {
-                    if ((isspace)(*s))
-                    {
-                        ns = 0;
-                    }
-                    else if (isdel(*s))
-                    {
-                        back(ctx, *s, src);
-                        ns = 0;
-                    }
-                    else
-                    {
-                        ns += puff(ctx, s + 1, NBUF - 1, src, next, back);
-                    }
+                    XPOST_LOG_ERR("unterminated procedure");
+                    return syntaxerror;
                 }
+                if (*s == '}')
+                    break;
+                if (!isdel((unsigned char)*s))
+                    ns += puff(s + 1, NBUF - 1, sc);
+                ret = grok(ctx, s, ns, sc, &t);
+                if (ret)
+                    return ret;
+                xpost_stack_push(ctx->lo, ctx->os, t);
+            }
+            ret = xpost_op_array_to_mark(ctx);  // ie. the /] operator
+            if (ret)
+                return ret;
+            *retval = xpost_object_cvx(xpost_stack_pop(ctx->lo, ctx->os));
+            return 0;
+        }
+
+        case '/':
+        {
+            int c = getch(sc);
+            if (c == '/')
+            {
+                Xpost_Object o;
+                ns = puff(s, NBUF, sc);
                 if (ns == NBUF)
                 {
-                    XPOST_LOG_ERR("name exceeds buf");
+                    XPOST_LOG_ERR("immediate name exceeds buf");
                     return limitcheck;
                 }
-                //printf("grok:/%s\n", s);
-                s[ns] = '\0';
-                //return xpost_object_cvlit(xpost_name_cons(ctx, s));
-                *retval = xpost_object_cvlit(xpost_name_cons(ctx, s));
+                if (DEBUGLOAD)
+                    printf("\ntoken: loading immediate name %.*s\n", ns, s);
+                xpost_op_any_load(ctx, xpost_object_cvx(xpost_name_cons_bytes(ctx, ns, s)));
+                o = xpost_stack_pop(ctx->lo, ctx->os);
+                if (DEBUGLOAD)
+                    xpost_object_dump(o);
+                *retval = o;
                 return 0;
             }
-            default:
+            if (c == EOF || isspc(c))
             {
-                //return xpost_object_cvx(xpost_name_cons(ctx, s));
-                *retval = xpost_object_cvx(xpost_name_cons(ctx, s));
-                return 0;
+                ns = 0;
+            }
+            else if (isdel(c))
+            {
+                backch(sc, c);
+                ns = 0;
+            }
+            else
+            {
+                *s = c;
+                ns = 1 + puff(s + 1, NBUF - 1, sc);
             }
+            if (ns == NBUF)
+            {
+                XPOST_LOG_ERR("name exceeds buf");
+                return limitcheck;
+            }
+            *retval = xpost_object_cvlit(xpost_name_cons_bytes(ctx, ns, s));
+            return 0;
         }
-}
-
-/* read until a non-whitespace, non-comment char.
-   "prime" the buffer.  */
-static
-int snip(Xpost_Context *ctx,
-         char *buf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src))
-{
-    int c;
-    do {
-        c = next(ctx, src);
-        if (c == '%')
+        default:
         {
-            do {
-                c = next(ctx, src);
-            } while(c != '\n' && c != '\f' && c != EOF);
+            *retval = xpost_object_cvx(xpost_name_cons_bytes(ctx, ns, s));
+            return 0;
         }
-    } while(c != EOF && isspace(c));
-    if (c == EOF) return 0;
-    *buf = c;
-    return 1; // true, and size of buffer
-}
-
-/* read in a token up to delimiter
-   read into buf any regular characters,
-   if we read one too many, put it back, unless whitespace. */
-static
-int puff(Xpost_Context *ctx,
-         char *buf,
-         int nbuf,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src))
-{
-    int c;
-    char *s = buf;
-    while (isreg(c = next(ctx, src)))
-    {
-        if (s - buf >= nbuf) return 0;
-        *s++ = c;
     }
-    if (!isspace(c) && c != EOF) back(ctx, c, src);
-    return s - buf;
 }
 
-
+/* scan one token using buf (NBUF bytes) for its text.
+   yields null at end of input. */
 static
 int toke(Xpost_Context *ctx,
-         Xpost_Object *src,
-         int (*next)(Xpost_Context *ctx, Xpost_Object *src),
-         void (*back)(Xpost_Context *ctx, int c, Xpost_Object *src),
+         scanner *sc,
+         char *buf,
          Xpost_Object *retval)
 {
-    char buf[NBUF] = "";
     int sta;  // status, and size
     Xpost_Object o;
     int ret;
 
-    if (!src)
-    {
-        XPOST_LOG_ERR("src is NULL");
-        return unregistered;
-    }
-
-    sta = snip(ctx, buf, src, next);
+    scanner_load(sc);
+    sta = snip(buf, sc);
     if (!sta)
     {
+        scanner_sync(sc);
         *retval = null;
         return 0;
     }
-    if (!isdel(*buf))
-        sta += puff(ctx, buf + 1, NBUF - 1, src, next, back);
-    ret = grok(ctx, buf, sta, src, next, back, &o);
+    if (!isdel((unsigned char)*buf))
+        sta += puff(buf + 1, NBUF - 1, sc);
+    ret = grok(ctx, buf, sta, sc, &o);
+    scanner_sync(sc);
     if (ret)
         return ret;
     *retval = o;
@@ -560,30 +642,22 @@ int toke(Xpost_Context *ctx,
    false
    read token from file */
 static
-int Fnext(Xpost_Context *ctx,
-          Xpost_Object *F)
-{
-    return xpost_file_getc(xpost_file_get_file_pointer(ctx->lo, *F));
-}
-static
-void Fback(Xpost_Context *ctx,
-           int c,
-           Xpost_Object *F)
-{
-    (void)xpost_file_ungetc(xpost_file_get_file_pointer(ctx->lo, *F), c);
-}
-static
 int Ftoken(Xpost_Context *ctx,
            Xpost_Object F)
 {
+    char buf[NBUF]; /* not cleared, grok terminates the token */
     Xpost_Object t;
+    Xpost_File *f;
+    scanner sc;
     int ret;
 
     xpost_stack_push(ctx->lo, ctx->hold, F);
 
-    if (!xpost_file_get_status(ctx->lo, F))
+    f = xpost_file_get_file_pointer(ctx->lo, F);
+    if (!f)
         return ioerror;
-    ret = toke(ctx, &F, Fnext, Fback, &t);
+    scanner_init_file(&sc, ctx, f);
+    ret = toke(ctx, &sc, buf, &t);
     if (ret)
         return ret;
     if (xpost_object_get_type(t) != nulltype)
@@ -602,35 +676,18 @@ int Ftoken(Xpost_Context *ctx,
    false
    read token from string */
 static
-int Snext(Xpost_Context *ctx,
-          Xpost_Object *S)
-{
-    int ret;
-    if (S->comp_.sz == 0) return EOF;
-    ret = xpost_string_get_pointer(ctx, *S)[0];
-    ++S->comp_.off;
-    --S->comp_.sz;
-    return ret;
-}
-static
-void Sback(Xpost_Context *ctx,
-           int c,
-           Xpost_Object *S)
-{
-    --S->comp_.off;
-    ++S->comp_.sz;
-    xpost_string_get_pointer(ctx, *S)[0] = c;
-}
-static
 int Stoken(Xpost_Context *ctx,
            Xpost_Object S)
 {
+    char buf[NBUF]; /* not cleared, grok terminates the token */
     Xpost_Object t;
+    scanner sc;
     int ret;
 
     xpost_stack_push(ctx->lo, ctx->hold, S);
 
-    ret = toke(ctx, &S, Snext, Sback, &t);
+    scanner_init_string(&sc, ctx, &S);
+    ret = toke(ctx, &sc, buf, &t);
     if (ret)
         return ret;
     if (xpost_object_get_type(t) != nulltype)
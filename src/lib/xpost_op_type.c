@@ -212,21 +212,16 @@ static
 int Scvn(Xpost_Context *ctx,
          Xpost_Object s)
 {
-    char *t;
     Xpost_Object name;
 
-    t = xpost_string_allocate_cstring(ctx, s);
-    name = xpost_name_cons(ctx, t);
-    if (xpost_object_get_type(name) == invalidtype){
-        free(t);
+    name = xpost_name_cons_bytes(ctx, s.comp_.sz, xpost_string_get_pointer(ctx, s));
+    if (xpost_object_get_type(name) == invalidtype)
         return VMerror;
-    }
     if (xpost_object_is_exe(s))
         name = xpost_object_cvx(name);
     else
         name = xpost_object_cvlit(name);
     xpost_stack_push(ctx->lo, ctx->os, name);
-    free(t);
     return 0;
 }
 
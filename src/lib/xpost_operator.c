@@ -68,7 +68,7 @@ Xpost_Object _promote_integer_to_real(Xpost_Object o)
    int (*fp)(Xpost_Context *ctx);
    int in;
    unsigned t;
-   int (*checkstack)(Xpost_Context *ctx);
+   unsigned promote;
    int out;
    } Xpost_Signature;
 
@@ -76,6 +76,8 @@ Xpost_Object _promote_integer_to_real(Xpost_Object o)
    unsigned name;
    int n; // number of sigs
    unsigned sigadr;
+   int depth;
+   unsigned match[XPOST_OPERATOR_DISPATCH_DEPTH][XPOST_OPERATOR_DISPATCH_COLUMNS];
    } Xpost_Operator;
 
    enum typepat ( anytype = stringtype + 1,
@@ -88,205 +90,136 @@ Xpost_Object _promote_integer_to_real(Xpost_Object o)
 static
 int _xpost_noops = 0;
 
+/* while rebinding an image, the number of signatures
+   rebound so far for each opcode, otherwise NULL. */
 static
-int _stack_none(Xpost_Context *ctx)
-{
-    (void)ctx;
-    return 0;
-}
+int *_xpost_operator_rebound = NULL;
 
+/* cleared when a rebound signature does not match the image */
 static
-int _stack_int(Xpost_Context *ctx)
-{
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            return 0;
-        default:
-            return typecheck;
-    }
-}
+int _xpost_operator_rebind_ok;
 
+/* dispatch-table column for an object:
+   its type, or the extra column for executable arrays */
 static
-int _stack_real(Xpost_Context *ctx)
+int _xpost_operator_column(Xpost_Object o)
 {
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case realtype:
-            return 0;
-        default:
-            return typecheck;
-    }
+    int t = o.tag & XPOST_OBJECT_TAG_DATA_TYPE_MASK;
+    if (t == arraytype && !(o.tag & XPOST_OBJECT_TAG_DATA_FLAG_LIT))
+        return XPOST_OBJECT_NTYPES;
+    return t;
 }
 
+/* set the bits in the column mask for the columns matched by type-pattern t */
 static
-int _stack_float(Xpost_Context *ctx)
+void _xpost_operator_match_columns(unsigned *col,
+                                   int t,
+                                   unsigned bit)
 {
-    Xpost_Object s0;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
+    int k;
+    switch (t)
     {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            xpost_stack_topdown_replace(ctx->lo, ctx->os, 0, s0 = _promote_integer_to_real(s0));
-        case realtype:
-            return 0;
-        default:
-            return typecheck;
-    }
-}
-
-static
-int _stack_any(Xpost_Context *ctx)
-{
-    if (xpost_stack_count(ctx->lo, ctx->os) >= 1)
-        return 0;
-    return stackunderflow;
-}
-
-static
-int _stack_bool_bool(Xpost_Context *ctx)
-{
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case booleantype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case booleantype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
+        case anytype:
+            for (k = 0; k < XPOST_OPERATOR_DISPATCH_COLUMNS; k++)
+                if (k != invalidtype)
+                    col[k] |= bit;
+            break;
+        case floattype: /* fallthrough */
+        case numbertype:
+            col[integertype] |= bit;
+            col[realtype] |= bit;
+            break;
+        case proctype:
+            col[XPOST_OBJECT_NTYPES] |= bit;
+            break;
+        case arraytype:
+            col[arraytype] |= bit;
+            col[XPOST_OBJECT_NTYPES] |= bit;
+            break;
         default:
-            return typecheck;
+            col[t] |= bit;
+            break;
     }
 }
 
+/* rebuild the dispatch table for an operator from its signatures */
 static
-int _stack_int_int(Xpost_Context *ctx)
+void _xpost_operator_build_dispatch(Xpost_Context *ctx,
+                                    Xpost_Operator *op)
 {
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
+    Xpost_Signature *sp;
+    byte *t;
+    unsigned bit;
+    int i, j, k;
+
+    memset(op->match, 0, sizeof op->match);
+    op->depth = 0;
+    sp = (void *)(ctx->gl->base + op->sigadr);
+    for (i = 0; i < op->n; i++)
     {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype:
-                    return 0;
-                default:
-                    return typecheck;
+        bit = 1U << i;
+        t = (void *)(ctx->gl->base + sp[i].t);
+        sp[i].promote = 0;
+        if (sp[i].in > op->depth)
+            op->depth = sp[i].in;
+        for (j = 0; j < XPOST_OPERATOR_DISPATCH_DEPTH; j++)
+        {
+            if (j >= sp[i].in)
+            { /* position not consumed: anything, even nothing */
+                for (k = 0; k < XPOST_OPERATOR_DISPATCH_COLUMNS; k++)
+                    op->match[j][k] |= bit;
+                continue;
             }
-        default:
-            return typecheck;
+            _xpost_operator_match_columns(op->match[j], t[j], bit);
+            if (t[j] == floattype)
+                sp[i].promote |= 1U << j;
+        }
     }
+    if (op->depth > XPOST_OPERATOR_DISPATCH_DEPTH)
+        op->depth = XPOST_OPERATOR_DISPATCH_DEPTH;
 }
 
+/* check the arguments of signature sp below the positions
+   covered by the dispatch table, promoting ints to reals for floattype */
 static
-int _stack_float_float(Xpost_Context *ctx)
+int _xpost_operator_check_deep(Xpost_Context *ctx,
+                               Xpost_Signature *sp)
 {
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
-    {
-        case invalidtype:
-            return stackunderflow;
-        case integertype:
-            xpost_stack_topdown_replace(ctx->lo, ctx->os, 0, s0 = _promote_integer_to_real(s0));
-        case realtype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
-            {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype:
-                    xpost_stack_topdown_replace(ctx->lo, ctx->os, 1, s1 = _promote_integer_to_real(s1));
-                case realtype:
-                    return 0;
-                default:
-                    return typecheck;
-            }
-        default:
-            return typecheck;
-    }
-}
+    byte *t;
+    int j;
 
-static
-int _stack_number_number(Xpost_Context *ctx)
-{
-    Xpost_Object s0, s1;
-    s0 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 0);
-    switch(xpost_object_get_type(s0))
+    t = (void *)(ctx->gl->base + sp->t);
+    for (j = XPOST_OPERATOR_DISPATCH_DEPTH; j < sp->in; j++)
     {
-        case invalidtype:
-            return stackunderflow;
-        case integertype: /* fallthrough */
-        case realtype:
-            s1 = xpost_stack_topdown_fetch(ctx->lo, ctx->os, 1);
-            switch(xpost_object_get_type(s1))
+        Xpost_Object el = xpost_stack_topdown_fetch(ctx->lo, ctx->os, j);
+        if (t[j] == anytype)
+            continue;
+        if (t[j] == xpost_object_get_type(el))
+            continue;
+        if ((t[j] == numbertype) &&
+            (((xpost_object_get_type(el) == integertype) ||
+              (xpost_object_get_type(el) == realtype))))
+            continue;
+        if (t[j] == floattype)
+        {
+            if (xpost_object_get_type(el) == integertype)
             {
-                case invalidtype:
-                    return stackunderflow;
-                case integertype: /* fallthrough */
-                case realtype:
-                    return 0;
-                default:
-                    return typecheck;
+                if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, j, el = _promote_integer_to_real(el)))
+                    return unregistered;
+                continue;
             }
-        default:
-            return typecheck;
+            if (xpost_object_get_type(el) == realtype)
+                continue;
+        }
+        if ((t[j] == proctype) &&
+            (xpost_object_get_type(el) == arraytype) &&
+            xpost_object_is_exe(el))
+            continue;
+        return typecheck;
     }
+    return 0;
 }
 
-static
-int _stack_any_any(Xpost_Context *ctx)
-{
-    if (xpost_stack_count(ctx->lo, ctx->os) >= 2)
-        return 0;
-    return stackunderflow;
-}
-
-typedef struct {
-    int (*checkstack)(Xpost_Context *ctx);
-    int n;
-    int t[8];
-} Xpost_Check_Stack;
-
-static
-Xpost_Check_Stack _check_stack_funcs[] = {
-    { _stack_none, 0, { 0, 0, 0, 0, 0, 0, 0, 0} },
-    { _stack_int, 1, { integertype } },
-    { _stack_real, 1, { realtype } },
-    { _stack_float, 1, { floattype } },
-    { _stack_any, 1, { anytype } },
-    { _stack_bool_bool, 2, { booleantype, booleantype } },
-    { _stack_int_int, 2, { integertype, integertype } },
-    { _stack_float_float, 2, { floattype, floattype } },
-    { _stack_number_number, 2, { numbertype, numbertype } },
-    { _stack_any_any, 2, { anytype, anytype } }
-};
-
 
 /* allocate the OPTAB structure in VM */
 int xpost_operator_init_optab(Xpost_Context *ctx)
@@ -341,6 +274,59 @@ void xpost_operator_dump(Xpost_Context *ctx,
     XPOST_LOG_DUMP("%*s ", str.comp_.sz, s);
 }
 
+/* count of installed operators, for writing an image */
+int xpost_operator_count(void)
+{
+    return _xpost_noops;
+}
+
+/* enter rebind mode for an image holding nops operators */
+int xpost_operator_rebind_begin(int nops)
+{
+    if (nops < 0 || nops >= MAXOPS)
+        return 0;
+    _xpost_operator_rebound = calloc(MAXOPS, sizeof *_xpost_operator_rebound);
+    if (!_xpost_operator_rebound)
+    {
+        XPOST_LOG_ERR("cannot allocate rebind table");
+        return 0;
+    }
+    _xpost_noops = nops;
+    _xpost_operator_rebind_ok = 1;
+    return 1;
+}
+
+/* leave rebind mode.
+   return 1 if every signature in the image was rebound, in order,
+   by an identical signature, otherwise forget the image's operators
+   and return 0. */
+int xpost_operator_rebind_end(Xpost_Context *ctx)
+{
+    Xpost_Operator *optab;
+    unsigned int optadr;
+    int opcode;
+
+    if (!_xpost_operator_rebound)
+        return 0;
+    xpost_memory_table_get_addr(ctx->gl,
+                                XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
+    optab = (void *)(ctx->gl->base + optadr);
+    for (opcode = 0; opcode < _xpost_noops && _xpost_operator_rebind_ok; opcode++)
+    {
+        if (_xpost_operator_rebound[opcode] != optab[opcode].n)
+        {
+            XPOST_LOG_ERR("operator %d has %d signatures in the image, %d here",
+                          opcode, optab[opcode].n, _xpost_operator_rebound[opcode]);
+            _xpost_operator_rebind_ok = 0;
+        }
+    }
+    free(_xpost_operator_rebound);
+    _xpost_operator_rebound = NULL;
+    if (!_xpost_operator_rebind_ok)
+        _xpost_noops = 0;
+    return _xpost_operator_rebind_ok;
+}
+
 /* create operator object by opcode number */
 Xpost_Object xpost_operator_cons_opcode(int opcode)
 {
@@ -379,7 +365,6 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
     unsigned vmmode;
     Xpost_Signature *sp;
     Xpost_Operator *optab;
-    Xpost_Operator  op;
     unsigned int optadr;
     int ret;
 
@@ -395,13 +380,13 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
     }
     optab = (void *)(ctx->gl->base + optadr);
 
-    if (!(in < XPOST_STACK_SEGMENT_SIZE))
+    if (!(in < XPOST_STACK_INITIAL_SIZE))
     {
-        printf("!(in < XPOST_STACK_SEGMENT_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
-        fprintf(stderr, "!(in < XPOST_STACK_SEGMENT_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
+        printf("!(in < XPOST_STACK_INITIAL_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
+        fprintf(stderr, "!(in < XPOST_STACK_INITIAL_SIZE) in xpost_operator_cons(%s, %d. %d)\n", name, out, in);
         exit(EXIT_FAILURE);
     }
-    //assert(in < XPOST_STACK_SEGMENT_SIZE); // or else xpost_operator_exec can't call it using HOLD
+    //assert(in < XPOST_STACK_INITIAL_SIZE); // or else xpost_operator_exec can't call it using HOLD
 
     vmmode=ctx->vmmode;
     ctx->vmmode = GLOBAL;
@@ -416,8 +401,39 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
         if (opcode == _xpost_noops) break;
     }
 
+    /* rebind the next signature of an operator loaded from an image */
+    if (fp && _xpost_operator_rebound)
+    {
+        va_list args;
+        byte *b;
+
+        if (opcode == _xpost_noops
+            || _xpost_operator_rebound[opcode] == optab[opcode].n)
+        {
+            XPOST_LOG_ERR("operator %s is not in the image", name);
+            _xpost_operator_rebind_ok = 0;
+            return null;
+        }
+        sp = (void *)(ctx->gl->base + optab[opcode].sigadr);
+        sp += _xpost_operator_rebound[opcode]++;
+        b = (void *)(ctx->gl->base + sp->t);
+        if (sp->in != in || sp->out != out)
+            _xpost_operator_rebind_ok = 0;
+        va_start(args, in);
+        for (i = in-1; i >= 0 && _xpost_operator_rebind_ok; i--) {
+            if (b[i] != va_arg(args, int))
+                _xpost_operator_rebind_ok = 0;
+        }
+        va_end(args);
+        if (!_xpost_operator_rebind_ok)
+        {
+            XPOST_LOG_ERR("operator %s does not match the image", name);
+            return null;
+        }
+        sp->fp = (int(*)(Xpost_Context *))fp;
+    }
     /* install a new signature (prototype) */
-    if (fp)
+    else if (fp)
     {
         if (opcode == _xpost_noops)
         { /* a new operator */
@@ -435,15 +451,20 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
                 return null;
             }
             optab = (void *)(ctx->gl->base + optadr); // recalc
-            op.name = nm.mark_.padw;
-            op.n = 1;
-            op.sigadr = adr;
-            optab[opcode] = op;
+            optab[opcode].name = nm.mark_.padw;
+            optab[opcode].n = 1;
+            optab[opcode].sigadr = adr;
             ++_xpost_noops;
             si = 0;
         }
         else
         { /* increase sig table by 1 */
+            if (optab[opcode].n == XPOST_OPERATOR_MAXSIG)
+            {
+                XPOST_LOG_ERR("too many signatures for dispatch table");
+                XPOST_LOG_ERR("operator %s NOT installed", name);
+                return null;
+            }
             t = xpost_free_realloc(ctx->gl,
                                    optab[opcode].sigadr,
                                    optab[opcode].n * sizeof(Xpost_Signature),
@@ -484,33 +505,7 @@ Xpost_Object xpost_operator_cons(Xpost_Context *ctx,
             sp[si].in = in;
             sp[si].out = out;
             sp[si].fp = (int(*)(Xpost_Context *))fp;
-            sp[si].checkstack = NULL;
-            {
-                int j;
-                int k;
-                int pass;
-                for (j = 0; j < (int)(sizeof _check_stack_funcs/sizeof*_check_stack_funcs); j++)
-                {
-                    if (_check_stack_funcs[j].n == sp[si].in)
-                    {
-                        pass = 1;
-                        for (k=0; k < _check_stack_funcs[j].n; k++)
-                        {
-                            if (b[k] != _check_stack_funcs[j].t[k])
-                            {
-                                pass = 0;
-                                break;
-                            }
-                        }
-                        if (pass)
-                        {
-                            sp[si].checkstack = _check_stack_funcs[j].checkstack;
-                            break;
-                        }
-                    }
-                }
-            }
-            //sp[si].checkstack = NULL;
+            _xpost_operator_build_dispatch(ctx, &optab[opcode]);
         }
     }
     else if (opcode == _xpost_noops)
@@ -547,19 +542,15 @@ void _xpost_operator_push_args_to_hold(Xpost_Context *ctx,
                                        unsigned stacadr,
                                        int n)
 {
-    int j;
-
-    assert(n < XPOST_MEMORY_TABLE_SIZE);
-    xpost_stack_clear(ctx->lo, ctx->hold);
-    for (j = n; j--;)
-    {  /* copy */
-        xpost_stack_push(ctx->lo, ctx->hold,
-                         xpost_stack_topdown_fetch(mem, stacadr, j));
-    }
-    for (j = n; j--;)
-    {  /* pop */
-        (void)xpost_stack_pop(mem, stacadr);
-    }
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stacadr);
+    Xpost_Stack *hold = (Xpost_Stack *)(ctx->lo->base + ctx->hold);
+
+    assert((unsigned)n <= hold->max && (unsigned)n <= s->top);
+    memcpy(XPOST_STACK_DATA(ctx->lo, hold),
+           XPOST_STACK_DATA(mem, s) + s->top - n,
+           n * sizeof(Xpost_Object));
+    hold->top = n;
+    s->top -= n;
 }
 
 /* execute an operator function by opcode
@@ -568,94 +559,61 @@ void _xpost_operator_push_args_to_hold(Xpost_Context *ctx,
 int xpost_operator_exec(Xpost_Context *ctx,
                         unsigned opcode)
 {
-    Xpost_Operator *optab;
-    Xpost_Operator op;
+    Xpost_Operator *op;
     Xpost_Signature *sp;
-    int i,j;
-    int pass;
-    int err = unregistered;
+    Xpost_Stack *s;
     Xpost_Stack *hold;
+    Xpost_Object *args;
+    int col[XPOST_OPERATOR_DISPATCH_DEPTH];
+    unsigned cand;
+    int i,j;
     int ct;
-    unsigned int optadr;
     int ret;
 
-    ret = xpost_memory_table_get_addr(ctx->gl,
-                                      XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    if (!ret)
-    {
-        XPOST_LOG_ERR("cannot load optab!");
-        return VMerror;
-    }
-    optab = (void *)(ctx->gl->base + optadr);
-    op = optab[opcode];
-    sp = (void *)(ctx->gl->base + op.sigadr);
-
-    ct = xpost_stack_count(ctx->lo, ctx->os);
-    if (op.n == 0)
+    /* the optab is a special entity: its address is fixed in the table */
+    op = (Xpost_Operator *)(ctx->gl->base +
+            ctx->gl->table.tab[XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE].adr) + opcode;
+    if (op->n == 0)
     {
         XPOST_LOG_ERR("operator has no signatures");
         return unregistered;
     }
-    for (i =0 ; i < op.n; i++)
-    { /* try each signature */
-        byte *t;
-
-        /* call signature's stack-checking proc, if available */
-        if (sp[i].checkstack)
-        {
-            if ((ret = sp[i].checkstack(ctx)))
-            {
-                err = ret;
-                continue;
-            }
+    sp = (void *)(ctx->gl->base + op->sigadr);
+
+    /* read the type columns of the top few objects */
+    s = (Xpost_Stack *)(ctx->lo->base + ctx->os);
+    ct = s->top;
+    for (j = 0; j < op->depth; j++)
+        col[j] = j < ct ?
+            _xpost_operator_column(XPOST_STACK_DATA(ctx->lo, s)[ct - 1 - j]) :
+            invalidtype;
+
+    /* select the matching signatures */
+    cand = op->n == XPOST_OPERATOR_MAXSIG ? ~0U : (1U << op->n) - 1;
+    for (j = 0; j < op->depth; j++)
+        cand &= op->match[j][col[j]];
+
+    /* the first matching signature wins,
+       after checking any arguments below the dispatch table */
+    for (i = 0; cand; i++, cand >>= 1)
+    {
+        if (!(cand & 1))
+            continue;
+        if (sp[i].in <= XPOST_OPERATOR_DISPATCH_DEPTH)
             goto call;
-        }
-
-        /* check stack size */
         if (ct < sp[i].in)
-        {
-            pass = 0;
-            err = stackunderflow;
             continue;
-        }
-
-        /* check type-pattern against stack */
-        pass = 1;
-        t = (void *)(ctx->gl->base + sp[i].t);
-        for (j=0; j < sp[i].in; j++)
-        {
-            Xpost_Object el = xpost_stack_topdown_fetch(ctx->lo, ctx->os, j);
-            if (t[j] == anytype)
-                continue;
-            if (t[j] == xpost_object_get_type(el))
-                continue;
-            if ((t[j] == numbertype) &&
-                (((xpost_object_get_type(el) == integertype) ||
-                  (xpost_object_get_type(el) == realtype))))
-                continue;
-            if (t[j] == floattype)
-            {
-                if (xpost_object_get_type(el) == integertype)
-                {
-                    if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, j, el = _promote_integer_to_real(el)))
-                        return unregistered;
-                    continue;
-                }
-                if (xpost_object_get_type(el) == realtype)
-                    continue;
-            }
-            if ((t[j] == proctype) &&
-                (xpost_object_get_type(el) == arraytype) &&
-                xpost_object_is_exe(el))
-                continue;
-            pass = 0;
-            err = typecheck;
-            break;
-        }
-
-        if (pass) goto call;
+        ret = _xpost_operator_check_deep(ctx, &sp[i]);
+        if (ret == 0)
+            goto call;
+        if (ret != typecheck)
+            return ret;
     }
-    return err;
+
+    /* report the error of the last signature */
+    if (ct < sp[op->n - 1].in)
+        return stackunderflow;
+    return typecheck;
 
   call:
     /* If we're executing the context's "currentobject",
@@ -679,8 +637,20 @@ int xpost_operator_exec(Xpost_Context *ctx,
         ctx->currentobject.tag &= ~XPOST_OBJECT_TAG_DATA_FLAG_OPARGSINHOLD;
     }
 
+    /* promote ints to reals */
+    for (j = 0; j < sp[i].in && j < XPOST_OPERATOR_DISPATCH_DEPTH; j++)
+    {
+        if ((sp[i].promote & (1U << j)) && col[j] == integertype)
+        {
+            Xpost_Object el = xpost_stack_topdown_fetch(ctx->lo, ctx->os, j);
+            if (!xpost_stack_topdown_replace(ctx->lo, ctx->os, j, _promote_integer_to_real(el)))
+                return unregistered;
+        }
+    }
+
     _xpost_operator_push_args_to_hold(ctx, ctx->lo, ctx->os, sp[i].in);
-    hold = (void *)(ctx->lo->base + ctx->hold);
+    hold = (Xpost_Stack *)(ctx->lo->base + ctx->hold);
+    args = XPOST_STACK_DATA(ctx->lo, hold);
 
     switch(sp[i].in)
     {
@@ -688,29 +658,29 @@ int xpost_operator_exec(Xpost_Context *ctx,
             ret = sp[i].fp(ctx); break;
         case 1:
             ret = ((int(*)(Xpost_Context*,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0]); break;
+                (ctx, args[0]); break;
         case 2:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1]); break;
+                (ctx, args[0], args[1]); break;
         case 3:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2]); break;
+                (ctx, args[0], args[1], args[2]); break;
         case 4:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3]); break;
+                (ctx, args[0], args[1], args[2], args[3]); break;
         case 5:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4]); break;
         case 6:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5]); break;
         case 7:
             ret = ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5], hold->data[6]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5], args[6]); break;
         case 8:
             ret =
                 ((int(*)(Xpost_Context*,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object,Xpost_Object))sp[i].fp)
-                (ctx, hold->data[0], hold->data[1], hold->data[2], hold->data[3], hold->data[4], hold->data[5], hold->data[6], hold->data[7]); break;
+                (ctx, args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]); break;
         default:
             ret = unregistered;
     }
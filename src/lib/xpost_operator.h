@@ -54,10 +54,13 @@
  *
  * ----
  * To speed-up typechecks,
- * a `int (*check)()` function pointer is added to the signature
- * which directly implements the stack-checking performed by
- * xpost_operator_exec (but without the nasty loops).
- * xpost_operator_exec would then call op.sig[i].check() if not null.
+ * each operator carries a dispatch table built by xpost_operator_cons.
+ * For each of the top XPOST_OPERATOR_DISPATCH_DEPTH stack positions
+ * and each object type, the table holds a bitmask of the signatures
+ * which accept that type in that position. xpost_operator_exec
+ * selects a signature by and-ing together the masks for the types
+ * found on the stack, and only falls back to the generic type-check
+ * loop for arguments deeper than the table.
  *
  * @{
  */
@@ -70,30 +73,54 @@ typedef int (*Xpost_Op_Func)();
 /**
  * @brief operator signature structure
  *
- * A signature contains a stack-pattern, an optional stack-checking
- * function, and an operator function.
+ * A signature contains a stack-pattern, a mask of the arguments
+ * to promote to reals, and an operator function.
  */
 typedef struct Xpost_Signature
 {
     Xpost_Op_Func fp;  /* function-pointer which implements the operator action */
     int in;       /* number of argument objects */
     unsigned t;   /* memory address of array of ints representing argument types */
-    int (*checkstack)(Xpost_Context *ctx);  /* stack-checking function to bypass generic type-check loop */
+    unsigned promote;  /* bitmask of dispatch-table positions with floattype */
     int out;      /* number of output objects */
 } Xpost_Signature;
 
+/**
+ * @brief number of stack positions covered by the dispatch table
+ */
+#define XPOST_OPERATOR_DISPATCH_DEPTH 3
+
+/**
+ * @brief number of type columns in the dispatch table
+ *
+ * One column per object type, plus one column for executable arrays
+ * so proctype can be matched without inspecting the object.
+ * The invalidtype column is used for positions beyond the bottom
+ * of the stack.
+ */
+#define XPOST_OPERATOR_DISPATCH_COLUMNS (XPOST_OBJECT_NTYPES + 1)
+
+/**
+ * @brief maximum number of signatures per operator
+ */
+#define XPOST_OPERATOR_MAXSIG 32
+
 /**
  * @brief operator structure
  *
  * An operator structure, which inhabits the operator table,
  * contains a "pointer" to an array of signatures
- * and the length of that array.
+ * and the length of that array,
+ * and the dispatch table used to select a signature.
  */
 typedef struct Xpost_Operator
 {
     unsigned name;   /* name-stack index of operator's name */
     int n;           /* number of signatures */
     unsigned sigadr; /* memory address of array of signatures */
+    int depth;       /* number of stack positions examined by the dispatch table */
+    unsigned match[XPOST_OPERATOR_DISPATCH_DEPTH][XPOST_OPERATOR_DISPATCH_COLUMNS];
+                     /* signatures accepting each type, per position */
 } Xpost_Operator;
 
 
@@ -133,6 +160,26 @@ int xpost_operator_init_optab(Xpost_Context *ctx);
  */
 void xpost_operator_dump(Xpost_Context *ctx, int opcode);
 
+/**
+ * @brief the number of operators in the optab
+ */
+int xpost_operator_count(void);
+
+/**
+ * @brief begin rebinding the operators of an image
+ *
+ * Until xpost_operator_rebind_end(), xpost_operator_cons() with
+ * a function pointer does not install a signature but checks
+ * the next signature of the named operator against its arguments
+ * and stores the function pointer in it.
+ */
+int xpost_operator_rebind_begin(int nops);
+
+/**
+ * @brief end rebinding, returning 1 if all signatures matched
+ */
+int xpost_operator_rebind_end(Xpost_Context *ctx);
+
 /**
  * @brief construct an operator object by opcode
  */
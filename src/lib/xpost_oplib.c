@@ -42,6 +42,7 @@
 #include "xpost_context.h"
 #include "xpost_name.h"
 #include "xpost_dict.h"
+#include "xpost_free.h"
 
 #include "xpost_operator.h"
 #include "xpost_oplib.h"
@@ -95,37 +96,15 @@ int xpost_op_breakhere(Xpost_Context *ctx)
     return 0;
 }
 
-/* create systemdict and call
-   all initop?* functions, installing all operators */
-int xpost_oplib_init_ops(Xpost_Context *ctx)
+/* call all initop?* functions, installing all operators in sd */
+static
+void _xpost_oplib_install_ops(Xpost_Context *ctx, Xpost_Object sd)
 {
     Xpost_Object op;
     Xpost_Object n;
-    Xpost_Object sd;
-    Xpost_Memory_Table *tab;
-    unsigned ent;
     Xpost_Operator *optab;
     unsigned int optadr;
 
-    sd = xpost_dict_cons (ctx, SDSIZE);
-    if (xpost_object_get_type(sd) == nulltype)
-    {
-        XPOST_LOG_ERR("cannot allocate systemdict");
-        return 0;
-    }
-    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "systemdict"), sd);
-    xpost_stack_push(ctx->lo, ctx->ds, sd); // push systemdict on dictstack
-    ent = xpost_object_get_ent(sd);
-    tab = &ctx->gl->table;
-    tab->tab[ent].sz = 0; // make systemdict immune to collection
-
-    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
-    //optab = (void *)(ctx->gl->base + optadr);
-#ifdef DEBUGOP
-    xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
-    puts("");
-#endif
-
     xpost_oper_init_stack_ops(ctx, sd);
 
 //#ifdef DEBUGOP
@@ -197,6 +176,69 @@ int xpost_oplib_init_ops(Xpost_Context *ctx)
     xpost_stack_dump(ctx->lo, ctx->ds);
     xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
 #endif
+}
+
+/* create systemdict and call
+   all initop?* functions, installing all operators */
+int xpost_oplib_init_ops(Xpost_Context *ctx)
+{
+    Xpost_Object sd;
+    Xpost_Memory_Table *tab;
+    unsigned ent;
+
+    sd = xpost_dict_cons (ctx, SDSIZE);
+    if (xpost_object_get_type(sd) == nulltype)
+    {
+        XPOST_LOG_ERR("cannot allocate systemdict");
+        return 0;
+    }
+    xpost_dict_put(ctx, sd, xpost_name_cons(ctx, "systemdict"), sd);
+    xpost_stack_push(ctx->lo, ctx->ds, sd); // push systemdict on dictstack
+    ent = xpost_object_get_ent(sd);
+    tab = &ctx->gl->table;
+    tab->tab[ent].sz = 0; // make systemdict immune to collection
+
+    //xpost_memory_table_get_addr(ctx->gl, XPOST_MEMORY_TABLE_SPECIAL_OPERATOR_TABLE, &optadr);
+    //optab = (void *)(ctx->gl->base + optadr);
+#ifdef DEBUGOP
+    xpost_dict_dump_memory (ctx->gl, sd); fflush(NULL);
+    puts("");
+#endif
+
+    _xpost_oplib_install_ops(ctx, sd);
 
     return 1;
 }
+
+/* bind the operators of a context loaded from an image to this process.
+   the init functions run again with the optab in rebind mode,
+   storing this process's function pointers in the signatures
+   and setting each module's cached names and opcodes.
+   their definitions go to a scratch dict as large as systemdict,
+   which is freed afterwards, so systemdict keeps what init.ps left in it. */
+int xpost_oplib_rebind_ops(Xpost_Context *ctx, int nops)
+{
+    Xpost_Object sd;
+    Xpost_Object scratch;
+    unsigned int vmmode;
+    int ret;
+
+    if (!xpost_operator_rebind_begin(nops))
+        return 0;
+    vmmode = ctx->vmmode;
+    ctx->vmmode = GLOBAL;
+    sd = xpost_stack_bottomup_fetch(ctx->lo, ctx->ds, 0);
+    scratch = xpost_dict_cons(ctx, xpost_dict_max_length_memory(ctx->gl, sd));
+    if (xpost_object_get_type(scratch) == nulltype)
+    {
+        XPOST_LOG_ERR("cannot allocate scratch dict");
+        ctx->vmmode = vmmode;
+        xpost_operator_rebind_end(ctx);
+        return 0;
+    }
+    _xpost_oplib_install_ops(ctx, scratch);
+    ctx->vmmode = vmmode;
+    ret = xpost_operator_rebind_end(ctx);
+    xpost_free_memory_ent(ctx->gl, xpost_object_get_ent(scratch));
+    return ret;
+}
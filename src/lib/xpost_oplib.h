@@ -48,6 +48,15 @@ int xpost_op_breakhere(Xpost_Context *ctx);
  */
 int xpost_oplib_init_ops(Xpost_Context *ctx);
 
+/**
+ * @brief bind the operators of a context loaded from an image
+ *
+ * Sets the function pointers in the nops operators of the image
+ * and the operator modules' cached names and opcodes.
+ * Returns 0 if the image's operators do not match this library.
+ */
+int xpost_oplib_rebind_ops(Xpost_Context *ctx, int nops);
+
 /**
  * @}
  */
@@ -41,6 +41,9 @@
 #include "xpost_object.h"  /* save/restore examines objects */
 #include "xpost_stack.h"  /* save/restore manipulates (internal) stacks */
 #include "xpost_error.h"
+#include "xpost_garbage.h"  /* restored ents are remembered */
+#include "xpost_context.h"
+#include "xpost_dict.h"  /* dict headers and pairs are saved in chunks */
 
 #include "xpost_save.h"  /* double-check prototypes */
 
@@ -105,9 +108,10 @@ Xpost_Object xpost_save_create_snapshot_object(Xpost_Memory_File *mem)
 }
 
 /* check ent's llev and tlev
-   against current save level (save-stack count)
-   returns 1 if ent is saved (or not necessary to save),
-   returns 0 if ent needs to be saved before changing.
+   against current save level (save-stack count).
+   the top save object opened this level: its lev is one less.
+   returns 1 if ent is saved whole (or not necessary to save),
+   returns 0 if ent, or some part of it, needs to be saved before changing.
  */
 unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
                                  unsigned ent)
@@ -116,8 +120,8 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
     unsigned int llev;
     unsigned int tlev;
     unsigned int vs;
+    unsigned int lev;
     int ret;
-    Xpost_Object sav;
 
     ret = xpost_memory_table_get_addr(mem,
                                       XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &vs);
@@ -127,10 +131,10 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
         return 0;
     }
 
-    if (xpost_stack_count(mem, vs) == 0)
+    lev = xpost_stack_count(mem, vs);
+    if (lev == 0)
         return 1;
 
-    sav = xpost_stack_topdown_fetch(mem, vs, 0);
     tab = &mem->table;
     if (ent >= tab->nextent)
     {
@@ -142,8 +146,8 @@ unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem,
     llev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
         >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
 
-    return llev < sav.save_.lev ?
-        tlev == sav.save_.lev : 1;
+    return llev < lev ?
+        tlev == lev && tab->tab[ent].save == 0 : 1;
 }
 
 /* make a clone of ent, return new ent */
@@ -174,6 +178,7 @@ unsigned int _copy_ent(Xpost_Memory_File *mem,
         return 0;
     }
     tab = &mem->table; //recalc
+    tab->tab[new].used = tab->tab[ent].used; /* the collector scans arrays by used */
     ret = xpost_memory_table_get_addr(mem, new, &adr);
     if (!ret)
     {
@@ -218,9 +223,10 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
         XPOST_LOG_ERR("cannot find table for ent %u", ent);
         return 0;
     }
-    tlev = sav.save_.lev;
+    tlev = sav.save_.lev + 1;
     tab->tab[ent].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK; // clear TLEV field
     tab->tab[ent].mark |= (tlev << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);  // set TLEV field
+    tab->tab[ent].save = 0;
 
     o.saverec_.tag = tag;
     o.saverec_.pad = pad;
@@ -237,10 +243,249 @@ int xpost_save_save_ent(Xpost_Memory_File *mem,
     return 1;
 }
 
+/* start saving ent a chunk at a time:
+   set tlev for ent to current save level,
+   make a chunk directory holding a copy of ent's header and no chunks,
+   push saverec relating ent to the directory */
+static
+int _xpost_save_directory(Xpost_Memory_File *mem,
+                          Xpost_Object sav,
+                          unsigned tag,
+                          unsigned pad,
+                          unsigned ent)
+{
+    Xpost_Memory_Table *tab;
+    Xpost_Object o;
+    unsigned int head;
+    unsigned int nchunks;
+    unsigned int dir;
+
+    head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    tab = &mem->table;
+    nchunks = ((tab->tab[ent].used - head) / XPOST_SAVE_ELEMENT_SIZE(tag)
+               + XPOST_SAVE_CHUNK_ELEMENTS(tag) - 1) / XPOST_SAVE_CHUNK_ELEMENTS(tag);
+    if (!xpost_memory_table_alloc(mem, head + nchunks * sizeof(unsigned int), 0, &dir))
+    {
+        XPOST_LOG_ERR("cannot allocate chunk directory");
+        return 0;
+    }
+    if (dir > XPOST_OBJECT_COMP_MAX_ENT)
+    {
+        XPOST_LOG_ERR("ent number %u exceeds object storage max %u",
+                      dir, XPOST_OBJECT_COMP_MAX_ENT);
+        return 0;
+    }
+    tab = &mem->table; //recalc
+    memcpy(mem->base + tab->tab[dir].adr,
+           mem->base + tab->tab[ent].adr,
+           head);
+    memset(mem->base + tab->tab[dir].adr + head, 0, nchunks * sizeof(unsigned int));
+
+    tab->tab[ent].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK;
+    tab->tab[ent].mark |= ((sav.save_.lev + 1) << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET);
+    tab->tab[ent].save = dir;
+
+    o.saverec_.tag = tag | XPOST_SAVE_CHUNKED;
+    o.saverec_.pad = pad;
+    o.saverec_.src = ent;
+    o.saverec_.cpy = dir;
+    if (!xpost_stack_push(mem, sav.save_.stk, o))
+    {
+        XPOST_LOG_ERR("cannot push save record");
+        return 0;
+    }
+    return 1;
+}
+
+/* copy chunk c of ent, unless the directory already has it */
+static
+int _xpost_save_chunk(Xpost_Memory_File *mem,
+                      unsigned tag,
+                      unsigned ent,
+                      unsigned int dir,
+                      unsigned int c)
+{
+    Xpost_Memory_Table *tab;
+    unsigned int head;
+    unsigned int off;
+    unsigned int len;
+    unsigned int cpy;
+
+    head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    tab = &mem->table;
+    if (((unsigned int *)(mem->base + tab->tab[dir].adr + head))[c])
+        return 1;
+    len = XPOST_SAVE_CHUNK_ELEMENTS(tag) * XPOST_SAVE_ELEMENT_SIZE(tag);
+    off = head + c * len;
+    if (off + len > tab->tab[ent].used)
+        len = tab->tab[ent].used - off;
+    if (!xpost_memory_table_alloc(mem, len, 0, &cpy))
+    {
+        XPOST_LOG_ERR("cannot allocate entity to backup chunk");
+        return 0;
+    }
+    tab = &mem->table; //recalc
+    memcpy(mem->base + tab->tab[cpy].adr,
+           mem->base + tab->tab[ent].adr + off,
+           len);
+    ((unsigned int *)(mem->base + tab->tab[dir].adr + head))[c] = cpy;
+    return 1;
+}
+
+/* make sure elements i .. i+n-1 of ent are saved before they change.
+   an ent with fewer than XPOST_SAVE_CHUNK_MIN bytes of elements is copied whole.
+   a larger one gets a chunk directory at its first change,
+   and then each chunk is copied at its own first change. */
+int xpost_save_save_range(Xpost_Memory_File *mem,
+                          unsigned tag,
+                          unsigned pad,
+                          unsigned ent,
+                          unsigned int i,
+                          unsigned int n)
+{
+    Xpost_Memory_Table *tab;
+    Xpost_Object sav;
+    unsigned int adr;
+    unsigned int tlev;
+    unsigned int head;
+    unsigned int dir;
+    unsigned int nchunks;
+    unsigned int c;
+
+    if (xpost_save_ent_is_saved(mem, ent))
+        return 1;
+    if (!xpost_memory_table_get_addr(mem,
+            XPOST_MEMORY_TABLE_SPECIAL_SAVE_STACK, &adr))
+    {
+        XPOST_LOG_ERR("cannot load save stack");
+        return 0;
+    }
+    sav = xpost_stack_topdown_fetch(mem, adr, 0);
+
+    head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    tab = &mem->table;
+    tlev = (tab->tab[ent].mark & XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK)
+        >> XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET;
+    if (tlev != (unsigned int)sav.save_.lev + 1)
+    {
+        if (tab->tab[ent].used - head < XPOST_SAVE_CHUNK_MIN)
+            return xpost_save_save_ent(mem, tag, pad, ent);
+        if (!_xpost_save_directory(mem, sav, tag, pad, ent))
+            return 0;
+    }
+
+    dir = mem->table.tab[ent].save;
+    nchunks = (mem->table.tab[dir].used - head) / sizeof(unsigned int);
+    for (c = i / XPOST_SAVE_CHUNK_ELEMENTS(tag);
+         n && c <= (i + n - 1) / XPOST_SAVE_CHUNK_ELEMENTS(tag) && c < nchunks;
+         c++)
+    {
+        if (!_xpost_save_chunk(mem, tag, ent, dir, c))
+            return 0;
+    }
+    return 1;
+}
+
+/* copy the header and the saved chunks from directory dir back into ent */
+static
+void _xpost_save_restore_chunks(Xpost_Memory_File *mem,
+                                unsigned tag,
+                                unsigned ent,
+                                unsigned int dir)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int head;
+    unsigned int len;
+    unsigned int nchunks;
+    unsigned int *chunk;
+    unsigned int c;
+
+    head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    len = XPOST_SAVE_CHUNK_ELEMENTS(tag) * XPOST_SAVE_ELEMENT_SIZE(tag);
+    memcpy(mem->base + tab->tab[ent].adr,
+           mem->base + tab->tab[dir].adr,
+           head);
+    nchunks = (tab->tab[dir].used - head) / sizeof(unsigned int);
+    chunk = (void *)(mem->base + tab->tab[dir].adr + head);
+    for (c = 0; c < nchunks; c++)
+    {
+        if (chunk[c] && chunk[c] < tab->nextent)
+            memcpy(mem->base + tab->tab[ent].adr + head + c * len,
+                   mem->base + tab->tab[chunk[c]].adr,
+                   tab->tab[chunk[c]].used);
+    }
+}
+
+/* ent holds nothing live once level lev is restored:
+   make it an untyped ent of that level, for xpost_garbage_release() */
+static
+void _xpost_save_discard(Xpost_Memory_File *mem,
+                         unsigned int ent,
+                         unsigned int lev)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+
+    if (ent < mem->start || ent >= tab->nextent)
+        return;
+    tab->tab[ent].tag = 0;
+    tab->tab[ent].mark = lev << XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET;
+    tab->tab[ent].save = 0;
+}
+
+/* discard the directory dir and the chunks it holds */
+static
+void _xpost_save_discard_chunks(Xpost_Memory_File *mem,
+                                unsigned tag,
+                                unsigned int dir,
+                                unsigned int lev)
+{
+    Xpost_Memory_Table *tab = &mem->table;
+    unsigned int head;
+    unsigned int nchunks;
+    unsigned int *chunk;
+    unsigned int c;
+
+    head = XPOST_SAVE_DIRECTORY_HEAD(tag);
+    nchunks = (tab->tab[dir].used - head) / sizeof(unsigned int);
+    chunk = (void *)(mem->base + tab->tab[dir].adr + head);
+    for (c = 0; c < nchunks; c++)
+        if (chunk[c])
+            _xpost_save_discard(mem, chunk[c], lev);
+    _xpost_save_discard(mem, dir, lev);
+}
+
+/* the saverec stack of a restored save object is raw storage:
+   its block and header become ents to discard with the level.
+   a zero-size ent never starts a collection. */
+static
+void _xpost_save_discard_stack(Xpost_Memory_File *mem,
+                               unsigned int stackadr,
+                               unsigned int lev)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    unsigned int data = s->data;
+    unsigned int max = s->max;
+    unsigned int e;
+
+    if (!xpost_memory_table_alloc(mem, 0, 0, &e))
+        return;
+    mem->table.tab[e].adr = data;
+    mem->table.tab[e].sz = max * sizeof(Xpost_Object);
+    _xpost_save_discard(mem, e, lev);
+    if (!xpost_memory_table_alloc(mem, 0, 0, &e))
+        return;
+    mem->table.tab[e].adr = stackadr;
+    mem->table.tab[e].sz = sizeof(Xpost_Stack);
+    _xpost_save_discard(mem, e, lev);
+}
+
 /* for each saverec from current save stack
-        exchange adrs between src and cpy
+        exchange adrs between src and cpy,
+          or copy back the chunks saved in the directory cpy
+        reset src's tlev so a later save copies it again
+        discard cpy, now holding the changed state
         pop saverec
-    pop save stack */
+    pop save stack, discard its saverec stack */
 void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
 {
     unsigned int v;
@@ -282,11 +527,32 @@ void xpost_save_restore_snapshot(Xpost_Memory_File *mem)
             XPOST_LOG_ERR("cannot find table for ent %u", cent);
             return;
         }
-        hold = tab->tab[sent].adr;                 // tmp = src
-        tab->tab[sent].adr = tab->tab[cent].adr;  // src = cpy
-        tab->tab[cent].adr = hold;                 // cpy = tmp
+        if (rec.saverec_.tag & XPOST_SAVE_CHUNKED)
+        {
+            _xpost_save_restore_chunks(mem, rec.saverec_.tag, sent, cent);
+            _xpost_save_discard_chunks(mem, rec.saverec_.tag, cent, sav.save_.lev + 1);
+        }
+        else
+        {
+            hold = tab->tab[sent].adr;                 // tmp = src
+            tab->tab[sent].adr = tab->tab[cent].adr;  // src = cpy
+            tab->tab[cent].adr = hold;                 // cpy = tmp
+            hold = tab->tab[sent].sz;  /* a dict may have grown since the save */
+            tab->tab[sent].sz = tab->tab[cent].sz;
+            tab->tab[cent].sz = hold;
+            hold = tab->tab[sent].used;
+            tab->tab[sent].used = tab->tab[cent].used;
+            tab->tab[cent].used = hold;
+            _xpost_save_discard(mem, cent, sav.save_.lev + 1);
+        }
+        tab->tab[sent].mark &= ~XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_MASK;
+        tab->tab[sent].mark |= ((tab->tab[sent].mark & XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_MASK)
+                                >> XPOST_MEMORY_TABLE_MARK_DATA_LOWLEVEL_OFFSET)
+                               << XPOST_MEMORY_TABLE_MARK_DATA_TOPLEVEL_OFFSET; // tlev = llev
+        tab->tab[sent].save = 0;
+        xpost_garbage_remember(mem, sent); // cpy may hold younger ents
     }
-    //xpost_stack_free(mem, sav.save_.stk);
+    _xpost_save_discard_stack(mem, sav.save_.stk, sav.save_.lev + 1);
 }
 
 #ifdef TESTMODULE_V
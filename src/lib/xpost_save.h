@@ -60,7 +60,50 @@
  *     -- saverec
  *     -- saverec = { src=foo_ent, cpy=bar_ent }
  *
+ *  Small arrays and dicts are copied whole the first time they change
+ *  after a save. Larger ones get a chunk directory instead: the saverec's
+ *  tag carries XPOST_SAVE_CHUNKED and cpy is the ent of the directory.
+ *  The directory holds a copy of the entity's header (the dichead of
+ *  a dict, nothing for an array) followed by one ent per chunk of
+ *  elements (objects, or key/value pairs), naming
+ *  a copy of the chunk as it was before its first change, or 0 if
+ *  the chunk has not changed. restore copies back only those chunks.
+ *
+ */
+
+/**
+ * @brief bytes per chunk, rounded down to whole elements.
+ *        small enough for the free list's small bins.
+ */
+#define XPOST_SAVE_CHUNK_SIZE 512
+
+/**
+ * @brief arrays and dicts with fewer bytes of elements are copied whole.
+ */
+#define XPOST_SAVE_CHUNK_MIN 4096
+
+/**
+ * @brief saverec tag flag: cpy is a chunk directory, not a whole copy.
+ */
+#define XPOST_SAVE_CHUNKED (1 << XPOST_OBJECT_TAG_DATA_EXTRA_BITS)
+
+/**
+ * @brief size of the header copied at the start of a chunk directory.
+ */
+#define XPOST_SAVE_DIRECTORY_HEAD(tag) \
+    (((tag) & XPOST_OBJECT_TAG_DATA_TYPE_MASK) == dicttype ? sizeof(dichead) : 0)
+
+/**
+ * @brief size of one element of a saved array or dict.
  */
+#define XPOST_SAVE_ELEMENT_SIZE(tag) \
+    (((tag) & XPOST_OBJECT_TAG_DATA_TYPE_MASK) == dicttype ? sizeof(dicrec) : sizeof(Xpost_Object))
+
+/**
+ * @brief elements per chunk of a saved array or dict.
+ */
+#define XPOST_SAVE_CHUNK_ELEMENTS(tag) \
+    (XPOST_SAVE_CHUNK_SIZE / XPOST_SAVE_ELEMENT_SIZE(tag))
 
 /*
  * @brief initialize the save stack for memory file.
@@ -74,17 +117,26 @@ int xpost_save_init(Xpost_Memory_File *mem);
 Xpost_Object xpost_save_create_snapshot_object(Xpost_Memory_File *mem);
 
 /*
- * @brief check whether an ent is contained in the current snapshot
+ * @brief check whether an ent is wholly contained in the current snapshot
  */
 unsigned xpost_save_ent_is_saved(Xpost_Memory_File *mem, unsigned ent);
 
 /*
- * @brief add ent to current snapshot
+ * @brief add a whole copy of ent to current snapshot
  */
 int xpost_save_save_ent(Xpost_Memory_File *mem, unsigned tag, unsigned pad, unsigned ent);
 
+/*
+ * @brief add elements i .. i+n-1 of ent, and its header, to current snapshot
+ *        before changing them. small ents are copied whole.
+ */
+int xpost_save_save_range(Xpost_Memory_File *mem, unsigned tag, unsigned pad, unsigned ent,
+                          unsigned int i, unsigned int n);
+
 /*
  * @brief rewind the stack 1 level, reverting memory to previous snapshot.
+ *        the copies and the saverec stack of the level are left as
+ *        untyped ents of that level, for xpost_garbage_release().
  */
 void xpost_save_restore_snapshot(Xpost_Memory_File *mem);
 
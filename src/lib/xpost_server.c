@@ -0,0 +1,401 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xpost.h"
+#include "xpost_log.h"
+
+#ifdef HAVE_FORK
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h> /* nanosleep */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include "xpost_compat.h"  /* XPOST_PATH_MAX */
+#include "xpost_memory.h"  /* the memory files are detached before forking */
+#include "xpost_object.h"
+#include "xpost_stack.h"
+#include "xpost_context.h"
+
+/*
+   A pool of workers forked from one initialized context.
+
+   The parent moves the context's memory files into private memory,
+   so each fork() shares the initialized vm with the parent
+   copy-on-write, and only the pages a worker writes are copied.
+
+   A job is a file NAME.ps in the spool directory. A worker claims it
+   by renaming it to NAME.ps.PID, runs it with the output file
+   NAME followed by the suffix, and renames it to NAME.done.
+   xpost_run restores the vm and clears the stacks after every job,
+   so the next job starts from the initialized state.
+
+   The parent replaces a worker that dies, renaming its job to
+   NAME.failed. On SIGTERM or SIGINT the workers finish their
+   current job and exit, and the parent returns.
+ */
+
+/* time a worker waits before looking at an empty spool again */
+#define XPOST_SERVER_IDLE_NS 10000000L
+
+static volatile sig_atomic_t _xpost_server_stop = 0;
+
+static
+void _xpost_server_signal(int sig)
+{
+    (void)sig;
+    _xpost_server_stop = 1;
+}
+
+/* only there to wake the parent from sigsuspend() */
+static
+void _xpost_server_child(int sig)
+{
+    (void)sig;
+}
+
+static
+int _xpost_server_signals(int restart)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _xpost_server_signal;
+    sigemptyset(&sa.sa_mask);
+    /* the parent must see the signal end sigsuspend() */
+    sa.sa_flags = restart ? SA_RESTART : 0;
+    if (sigaction(SIGTERM, &sa, NULL) == -1 ||
+        sigaction(SIGINT, &sa, NULL) == -1)
+    {
+        XPOST_LOG_ERR("cannot install signal handlers (error: %s)",
+                      strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/*
+   claim the first job of the spool directory.
+   fill job with the claimed file and base with the job name
+   without its .ps extension.
+   return 1 if a job was claimed, 0 if the spool holds none.
+ */
+static
+int _xpost_server_claim(const char *spool,
+                        char *job,
+                        char *base,
+                        size_t size)
+{
+    char path[XPOST_PATH_MAX];
+    DIR *dir;
+    struct dirent *de;
+    int ret = 0;
+
+    dir = opendir(spool);
+    if (!dir)
+    {
+        XPOST_LOG_ERR("cannot open spool directory %s (error: %s)",
+                      spool, strerror(errno));
+        return 0;
+    }
+
+    while (!ret && (de = readdir(dir)))
+    {
+        size_t len = strlen(de->d_name);
+
+        if (de->d_name[0] == '.' || len <= 3 ||
+            strcmp(de->d_name + len - 3, ".ps") != 0)
+            continue;
+
+        /* skip names too long to claim */
+        if (snprintf(path, sizeof(path), "%s/%s", spool, de->d_name) >= (int)sizeof(path) ||
+            snprintf(job, size, "%s.%ld", path, (long)getpid()) >= (int)size)
+            continue;
+        /* the rename fails if another worker claimed it first */
+        if (rename(path, job) == 0)
+        {
+            snprintf(base, size, "%s/%.*s", spool, (int)(len - 3), de->d_name);
+            ret = 1;
+        }
+    }
+
+    closedir(dir);
+    return ret;
+}
+
+/*
+   rename the job a dead worker claimed to NAME.failed
+ */
+static
+void _xpost_server_fail(const char *spool, pid_t pid)
+{
+    char suffix[32];
+    char path[XPOST_PATH_MAX];
+    char failed[XPOST_PATH_MAX];
+    DIR *dir;
+    struct dirent *de;
+    size_t slen;
+
+    dir = opendir(spool);
+    if (!dir)
+        return;
+
+    slen = snprintf(suffix, sizeof(suffix), ".ps.%ld", (long)pid);
+    while ((de = readdir(dir)))
+    {
+        size_t len = strlen(de->d_name);
+
+        if (len <= slen || strcmp(de->d_name + len - slen, suffix) != 0)
+            continue;
+
+        if (snprintf(path, sizeof(path), "%s/%s", spool, de->d_name) < (int)sizeof(path) &&
+            snprintf(failed, sizeof(failed), "%s/%.*s.failed",
+                     spool, (int)(len - slen), de->d_name) < (int)sizeof(failed))
+        {
+            XPOST_LOG_ERR("job %s failed", path);
+            rename(path, failed);
+        }
+        break;
+    }
+
+    closedir(dir);
+}
+
+/*
+   run the jobs of the spool directory until told to stop
+ */
+static
+void _xpost_server_work(Xpost_Context *ctx,
+                        const char *spool,
+                        const char *suffix)
+{
+    char job[XPOST_PATH_MAX];
+    char base[XPOST_PATH_MAX];
+    char path[XPOST_PATH_MAX];
+    struct timespec idle;
+
+    idle.tv_sec = 0;
+    idle.tv_nsec = XPOST_SERVER_IDLE_NS;
+
+    while (!_xpost_server_stop)
+    {
+        if (!_xpost_server_claim(spool, job, base, sizeof(job)))
+        {
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        XPOST_LOG_INFO("worker %ld runs %s", (long)getpid(), job);
+        if (snprintf(path, sizeof(path), "%s%s", base, suffix) >= (int)sizeof(path) ||
+            !xpost_output_file_set(ctx, path))
+            XPOST_LOG_ERR("cannot set output file for %s", job);
+        xpost_run(ctx, XPOST_INPUT_FILENAME, job, 0);
+        fflush(NULL);
+
+        if (snprintf(path, sizeof(path), "%s.done", base) >= (int)sizeof(path) ||
+            rename(job, path) != 0)
+            XPOST_LOG_ERR("cannot mark %s done", job);
+    }
+}
+
+XPAPI int
+xpost_serve(Xpost_Context *ctx,
+            const char *spool,
+            int workers,
+            const char *suffix)
+{
+    struct sigaction sa;
+    struct sigaction oldchld;
+    sigset_t block;
+    sigset_t oldmask;
+    pid_t *pids;
+    int stopping = 0;
+    int ret = 0;
+    int live;
+    int i;
+
+    if (!ctx || !spool || workers < 1)
+        return 0;
+    if (!suffix)
+        suffix = "";
+
+    if (!xpost_memory_file_detach(ctx->gl) ||
+        !xpost_memory_file_detach(ctx->lo))
+        return 0;
+
+    pids = calloc(workers, sizeof(*pids));
+    if (!pids)
+    {
+        XPOST_LOG_ERR("cannot allocate worker table");
+        return 0;
+    }
+
+    _xpost_server_stop = 0;
+    if (!_xpost_server_signals(0))
+    {
+        free(pids);
+        return 0;
+    }
+
+    /* keep the signals pending while the parent decides whether to
+       sleep, so one landing just before the sleep is not lost:
+       sigsuspend() lets them in and sleeps in one step */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _xpost_server_child;
+    sigemptyset(&sa.sa_mask);
+    sigemptyset(&block);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGCHLD);
+    if (sigaction(SIGCHLD, &sa, &oldchld) == -1 ||
+        sigprocmask(SIG_BLOCK, &block, &oldmask) == -1)
+    {
+        XPOST_LOG_ERR("cannot block signals (error: %s)", strerror(errno));
+        free(pids);
+        return 0;
+    }
+
+    /* the workers must not write the parent's buffered output again */
+    fflush(NULL);
+
+    for (;;)
+    {
+        int status;
+        pid_t pid;
+
+        live = 0;
+        for (i = 0; i < workers; i++)
+        {
+            if (!pids[i] && !_xpost_server_stop)
+            {
+                pid = fork();
+                if (pid == 0)
+                {
+                    free(pids);
+                    sigaction(SIGCHLD, &oldchld, NULL);
+                    /* keep a job's system calls from failing on a signal */
+                    _xpost_server_signals(1);
+                    sigprocmask(SIG_SETMASK, &oldmask, NULL);
+                    _xpost_server_work(ctx, spool, suffix);
+                    fflush(NULL);
+                    _exit(EXIT_SUCCESS);
+                }
+                if (pid < 0)
+                {
+                    XPOST_LOG_ERR("cannot fork worker (error: %s)",
+                                  strerror(errno));
+                    pid = 0;
+                }
+                pids[i] = pid;
+            }
+            if (pids[i])
+                live++;
+        }
+        if (!live)
+        {
+            /* all workers gone is only a success when asked to stop */
+            ret = _xpost_server_stop;
+            if (!ret)
+                XPOST_LOG_ERR("no worker could be started");
+            break;
+        }
+
+        if (_xpost_server_stop && !stopping)
+        {
+            for (i = 0; i < workers; i++)
+            {
+                if (pids[i])
+                    kill(pids[i], SIGTERM);
+            }
+            stopping = 1;
+        }
+
+        pid = waitpid(-1, &status, WNOHANG);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            XPOST_LOG_ERR("waitpid failed (error: %s)", strerror(errno));
+            break;
+        }
+        if (pid == 0)
+        {
+            sigsuspend(&oldmask);
+            continue;
+        }
+
+        for (i = 0; i < workers; i++)
+        {
+            if (pids[i] == pid)
+                pids[i] = 0;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            XPOST_LOG_ERR("worker %ld died", (long)pid);
+            _xpost_server_fail(spool, pid);
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &oldmask, NULL);
+    sigaction(SIGCHLD, &oldchld, NULL);
+    free(pids);
+    return ret;
+}
+
+#else /* ! HAVE_FORK */
+
+XPAPI int
+xpost_serve(Xpost_Context *ctx,
+            const char *spool,
+            int workers,
+            const char *suffix)
+{
+    (void)ctx;
+    (void)spool;
+    (void)workers;
+    (void)suffix;
+
+    XPOST_LOG_ERR("worker pools need fork()");
+    return 0;
+}
+
+#endif
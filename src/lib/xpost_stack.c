@@ -33,6 +33,7 @@
 #endif
 
 #include <stdlib.h> /* NULL */
+#include <string.h> /* memcpy memmove */
 
 #include "xpost.h"
 #include "xpost_log.h"
@@ -42,33 +43,36 @@
 #include "xpost_stack.h"
 
 /*
- * The stack type is a chain of segments.
+ * The stack type is a header with a separately allocated block.
  *
- * root->prevseg == top segment
- * tail->nextseg == 0
+ * data[0] == bottom
+ * data[top - 1] == top
  *
 
 typedef struct
 {
-    unsigned int nextseg;
-    unsigned int prevseg;
     unsigned int top;
-    Xpost_Object data[XPOST_STACK_SEGMENT_SIZE];
+    unsigned int max;
+    unsigned int data;
 } Xpost_Stack;
 */
 
-/* allocate memory for one stack segment */
+/* allocate memory for the stack header and its block */
 XPCHECKAPI int xpost_stack_init(Xpost_Memory_File *mem,
                                 unsigned int *paddr)
 {
     unsigned int adr;
+    unsigned int data;
     Xpost_Stack *s;
 
-    xpost_memory_file_alloc(mem, sizeof(Xpost_Stack), &adr);
+    if (!xpost_memory_file_alloc(mem, sizeof(Xpost_Stack), &adr))
+        return 0;
+    if (!xpost_memory_file_alloc(mem, XPOST_STACK_INITIAL_SIZE * sizeof(Xpost_Object), &data))
+        return 0;
     s = (Xpost_Stack *)(mem->base + adr);
-    s->nextseg = 0;
-    s->prevseg = adr;
     s->top = 0;
+    s->max = XPOST_STACK_INITIAL_SIZE;
+    s->data = data;
     *paddr = adr;
     return 1;
 }
@@ -78,100 +82,96 @@ void xpost_stack_clear(Xpost_Memory_File *mem,
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
     s->top = 0;
-    s->prevseg = stackadr;
 }
 
 void xpost_stack_dump(Xpost_Memory_File *mem,
                       unsigned int stackadr)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *data = XPOST_STACK_DATA(mem, s);
     unsigned int i;
-    unsigned int a;
 
-    a = 0;
-    while (1)
+    for (i = 0; i < s->top; i++)
     {
-        for (i = 0; i < s->top; i++)
-        {
-            XPOST_LOG_DUMP("%d:", a++);
-            xpost_object_dump(s->data[i]);
-        }
-        if (i != XPOST_STACK_SEGMENT_SIZE)
-            break;
-        if (s->nextseg == 0)
-            break;
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
+        XPOST_LOG_DUMP("%d:", i);
+        xpost_object_dump(data[i]);
     }
 }
 
-/* deallocate stack segment and any chained segments */
+/* deallocate stack header and block */
 XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem,
                                  unsigned int stackadr)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
     Xpost_Memory_Table *tab;
+    unsigned int data = s->data;
+    unsigned int max = s->max;
     unsigned int e;
 
-    if (s->nextseg)
-        xpost_stack_free(mem, s->nextseg);
     xpost_memory_table_alloc(mem, 0, 0, &e); /* allocate entry with 0 size */
     tab = &mem->table;
-    tab->tab[e].adr = stackadr; /* insert address */
-    tab->tab[e].sz = sizeof(Xpost_Stack); /* insert size */
+    tab->tab[e].adr = data; /* insert address */
+    tab->tab[e].sz = max * sizeof(Xpost_Object); /* insert size */
+    xpost_memory_table_alloc(mem, 0, 0, &e);
+    tab = &mem->table;
+    tab->tab[e].adr = stackadr;
+    tab->tab[e].sz = sizeof(Xpost_Stack);
     /* discard */
 }
 
 int xpost_stack_count(Xpost_Memory_File *mem,
                       unsigned int stackadr)
+{
+    return ((Xpost_Stack *)(mem->base + stackadr))->top;
+}
+
+/* re-allocate the block to hold at least n more objects.
+   the block is taken linearly from the memory file, since a
+   collection triggered here could reclaim an object on its way
+   to the stack. the old block is abandoned, as full segments were;
+   doubling bounds the waste by the final size of the stack. */
+XPCHECKAPI int xpost_stack_reserve(Xpost_Memory_File *mem,
+                                   unsigned int stackadr,
+                                   unsigned int n)
 {
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
-    unsigned int ct = 0;
-    while (s->top == XPOST_STACK_SEGMENT_SIZE)
-    {
-        ct += XPOST_STACK_SEGMENT_SIZE;
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
-    }
-    return ct + s->top;
+    unsigned int max;
+    unsigned int data;
+
+    if (s->max - s->top >= n)
+        return 1;
+    for (max = s->max ? s->max : 1; max - s->top < n; max *= 2)
+        if (max > 0x7fffffffU / sizeof(Xpost_Object) / 2)
+        {
+            XPOST_LOG_ERR("stack cannot grow beyond %u objects", max);
+            return 0;
+        }
+
+    if (!xpost_memory_file_alloc(mem, max * sizeof(Xpost_Object), &data))
+        return 0;
+    s = (Xpost_Stack *)(mem->base + stackadr); //recalc pointer
+    memcpy(mem->base + data, mem->base + s->data, s->top * sizeof(Xpost_Object));
+    s->data = data;
+    s->max = max;
+    return 1;
 }
 
 XPCHECKAPI int xpost_stack_push(Xpost_Memory_File *mem,
                                 unsigned int stackadr,
                                 Xpost_Object obj)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = (Xpost_Stack *)(mem->base + root->prevseg); /* load top segment */
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
     if (xpost_object_get_type(obj) == invalidtype)
         return 0;
 
-    s->data[s->top++] = obj; /* push value */
-
-    /* if push filled the topmost segment, link a new one. */
-    if (s->top == XPOST_STACK_SEGMENT_SIZE)
+    if (s->top == s->max)
     {
-        if (s->nextseg == 0)
-        {
-            size_t stadr;
-            unsigned int newst;
-            int ret;
-
-            stadr = (unsigned char *)s - mem->base;
-            ret = xpost_stack_init(mem, &newst);
-            if (!ret)
-                return 0;
-            s = (Xpost_Stack *)(mem->base + stadr);
-            root = (Xpost_Stack *)(mem->base + stackadr);
-            s->nextseg = newst;
-            root->prevseg = newst; //root->prev==top
-            ((Xpost_Stack *)(mem->base + newst))->prevseg = stadr;
-        }
-        else
-        {
-            root->prevseg = s->nextseg;
-            s = (Xpost_Stack *)(mem->base + s->nextseg);
-            s->top = 0;
-        }
+        if (!xpost_stack_reserve(mem, stackadr, 1))
+            return 0;
+        s = (Xpost_Stack *)(mem->base + stackadr);
     }
+    XPOST_STACK_DATA(mem, s)[s->top++] = obj; /* push value */
 
     return 1;
 }
@@ -180,29 +180,15 @@ Xpost_Object xpost_stack_topdown_fetch(Xpost_Memory_File *mem,
                                        unsigned int stackadr,
                                        int idx)
 {
-#if 0
-    int i = idx;
-    int cnt = xpost_stack_count(mem, stackadr);
-    if (idx >= cnt) return invalid;
-    return xpost_stack_bottomup_fetch(mem, stackadr, cnt - 1 - i);
-#else
-    int i = idx;
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    if (s->prevseg) s = (Xpost_Stack *)(mem->base + s->prevseg); /* find top seg */
-
-    while (i >= (signed)(s->top)){
-        i -= s->top;
-        if (s == (Xpost_Stack *)(mem->base + stackadr)){
-            XPOST_LOG_ERR("%d can't find stack segment for index -%d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return invalid;
-        }
-        s = (Xpost_Stack *)(mem->base + s->prevseg);
+    if (idx < 0 || (unsigned int)idx >= s->top)
+    {
+        XPOST_LOG_ERR("%d can't find index -%d in stack of size %u",
+                unregistered, idx, s->top);
+        return invalid;
     }
-    return s->data[s->top - 1 - i];
-#endif
+    return XPOST_STACK_DATA(mem, s)[s->top - 1 - idx];
 }
 
 int xpost_stack_topdown_replace(Xpost_Memory_File *mem,
@@ -210,56 +196,27 @@ int xpost_stack_topdown_replace(Xpost_Memory_File *mem,
                                 int idx,
                                 Xpost_Object obj)
 {
-#if 0
-    int i = idx;
-    int cnt = xpost_stack_count(mem, stackadr);
-    if (idx >= cnt) return 0;
-    return xpost_stack_bottomup_replace(mem, stackadr, cnt - 1 - i, obj);
-#else
-    int i = idx;
     Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
-    if (s->prevseg) s = (Xpost_Stack *)(mem->base + s->prevseg); /* find top seg */
-
-    while (i >= (signed)(s->top)){
-        i -= s->top;
-        if (s == (Xpost_Stack *)(mem->base + stackadr)){
-            XPOST_LOG_ERR("%d can't find stack segment for index -%d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return 0;
-        }
-        s = (Xpost_Stack *)(mem->base + s->prevseg);
+
+    if (idx < 0 || (unsigned int)idx >= s->top)
+    {
+        XPOST_LOG_ERR("%d can't find index -%d in stack of size %u",
+                unregistered, idx, s->top);
+        return 0;
     }
-    s->data[s->top - 1 - i] = obj;
+    XPOST_STACK_DATA(mem, s)[s->top - 1 - idx] = obj;
     return 1;
-#endif
 }
 
 Xpost_Object xpost_stack_bottomup_fetch(Xpost_Memory_File *mem,
                                         unsigned int stackadr,
                                         int idx)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = root;
-    int i = idx;
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    /* find desired segment */
-    while (i >= XPOST_STACK_SEGMENT_SIZE)
-    {
-        i -= XPOST_STACK_SEGMENT_SIZE;
-        if (s->nextseg == 0)
-        {
-            XPOST_LOG_ERR("%d can't find stack segment for index %d in stack of size %u",
-                    unregistered, idx,
-                    xpost_stack_count(mem, stackadr));
-            return invalid;
-        }
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
-    }
-    if (i >= (signed)s->top){
+    if (idx < 0 || (unsigned int)idx >= s->top)
         return invalid;
-    }
-    return s->data[i];
+    return XPOST_STACK_DATA(mem, s)[idx];
 }
 
 int xpost_stack_bottomup_replace(Xpost_Memory_File *mem,
@@ -267,49 +224,109 @@ int xpost_stack_bottomup_replace(Xpost_Memory_File *mem,
                                  int idx,
                                  Xpost_Object obj)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = root;
-    int i = idx;
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    /* find desired segment */
-    while (i >= XPOST_STACK_SEGMENT_SIZE)
-    {
-        i -= XPOST_STACK_SEGMENT_SIZE;
-        if (s->nextseg == 0)
-        {
-            XPOST_LOG_ERR("%d can't find stack segment for index %d in stack of size %u",
-                          unregistered, idx,
-                          xpost_stack_count(mem, stackadr));
-            return 0;
-        }
-        s = (Xpost_Stack *)(mem->base + s->nextseg);
-    }
-    if (i >= (signed)s->top){
+    if (idx < 0 || (unsigned int)idx >= s->top)
         return 0;
-    }
-    s->data[i] = obj;
+    XPOST_STACK_DATA(mem, s)[idx] = obj;
     return 1;
 }
 
 XPCHECKAPI Xpost_Object xpost_stack_pop(Xpost_Memory_File *mem,
                                         unsigned int stackadr)
 {
-    Xpost_Stack *root = (Xpost_Stack *)(mem->base + stackadr);
-    Xpost_Stack *s = (Xpost_Stack *)(mem->base + root->prevseg); /* load top seg */
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+
+    if (s->top == 0) /* can't back up if stack is empty */
+        return invalid;
+
+    return XPOST_STACK_DATA(mem, s)[--s->top]; /* pop value */
+}
+
+XPCHECKAPI int xpost_stack_pop_n(Xpost_Memory_File *mem,
+                                 unsigned int stackadr,
+                                 int n)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
 
-    if (s->top == 0) /* back up if top is empty */
+    if (n < 0 || (unsigned int)n > s->top)
+        return 0;
+    s->top -= n;
+    return 1;
+}
+
+XPCHECKAPI int xpost_stack_copy(Xpost_Memory_File *mem,
+                                unsigned int stackadr,
+                                int n)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *data;
+
+    if (n < 0 || (unsigned int)n > s->top)
+        return 0;
+    if (!xpost_stack_reserve(mem, stackadr, n))
+        return 0;
+    s = (Xpost_Stack *)(mem->base + stackadr);
+    data = XPOST_STACK_DATA(mem, s);
+    memcpy(data + s->top, data + s->top - n, n * sizeof(Xpost_Object));
+    s->top += n;
+    return 1;
+}
+
+/* reverse the objects in data[lo..hi) */
+static
+void _xpost_stack_reverse(Xpost_Object *data,
+                          unsigned int lo,
+                          unsigned int hi)
+{
+    Xpost_Object t;
+
+    while (lo + 1 < hi)
     {
-        if (s != root)
-        {
-            unsigned int soff = s->prevseg;
-            s = (Xpost_Stack *)(mem->base + soff);
-            root->prevseg = soff; // update root->top
-        }
-        else /* can't back up if stack is empty */
-        {
-            return invalid;
-        }
+        t = data[lo];
+        data[lo++] = data[--hi];
+        data[hi] = t;
     }
+}
+
+/* rotate the top n objects j places toward the top,
+   by reversing the two parts, then the whole */
+XPCHECKAPI int xpost_stack_roll(Xpost_Memory_File *mem,
+                                unsigned int stackadr,
+                                int n,
+                                int j)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *data;
+    unsigned int base;
+
+    if (n < 0 || (unsigned int)n > s->top)
+        return 0;
+    if (n == 0)
+        return 1;
+    j %= n;
+    if (j < 0)
+        j += n;
+    if (j == 0)
+        return 1;
+
+    data = XPOST_STACK_DATA(mem, s);
+    base = s->top - n;
+    _xpost_stack_reverse(data, base, s->top - j);
+    _xpost_stack_reverse(data, s->top - j, s->top);
+    _xpost_stack_reverse(data, base, s->top);
+    return 1;
+}
+
+int xpost_stack_count_to_mark(Xpost_Memory_File *mem,
+                              unsigned int stackadr)
+{
+    Xpost_Stack *s = (Xpost_Stack *)(mem->base + stackadr);
+    Xpost_Object *data = XPOST_STACK_DATA(mem, s);
+    unsigned int i;
 
-    return s->data[--s->top]; /* pop value */
+    for (i = s->top; i > 0; i--)
+        if (data[i - 1].tag == marktype)
+            return s->top - i;
+    return -1;
 }
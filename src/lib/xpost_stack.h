@@ -43,37 +43,41 @@
  * @file xpost_stack.h
  * @brief stack functions
  *
- * Stacks are built from a chain of tables, a hybrid
- * array/linked-list data structure.
+ * A stack is a small header at a fixed vm address,
+ * holding the count of objects and the address of
+ * a contiguous block of objects, bottom first.
+ * The block is re-allocated (doubling) when it fills,
+ * so every element is addressed in constant time from either end.
  * @{
  */
 
 /**
- * @brief Number of objects in one segment of the stack.
+ * @brief Number of objects in a new stack.
  *
  * This parameter may be tuned for performance.
- * Most stack operations are performed on the top few entries,
- * which are at the tail of a linked list of stack segments.
- *
- * For performance, this parameter should be set to be slightly
- * larger than expected maximum size (or the average, if the
- * maximum is very large; however, there is currently no provision
- * for shrinking the size of a stack and returning memory).
+ * The stack grows by doubling when a push finds it full.
  *
  * For testing, this parameter should be set very small,
  * but it must be large enough to hold all parameters in a
- * type-checked postscript operator. cf. xpost_operator.c:holdn()
+ * type-checked postscript operator, since HOLD is never grown
+ * by xpost_operator_exec.
  */
-#define XPOST_STACK_SEGMENT_SIZE 1000
+#define XPOST_STACK_INITIAL_SIZE 1000
 
 typedef struct
 {
-    unsigned int nextseg;
-    unsigned int prevseg;
-    unsigned int top;
-    Xpost_Object data[XPOST_STACK_SEGMENT_SIZE];
+    unsigned int top;  /* number of objects on the stack */
+    unsigned int max;  /* number of objects the block can hold */
+    unsigned int data; /* vm address of the block of objects */
 } Xpost_Stack;
 
+/**
+ * @brief Pointer to the bottom object of the stack s in mem.
+ *
+ * The pointer is invalidated by any allocation in mem.
+ */
+#define XPOST_STACK_DATA(mem, s) ((Xpost_Object *)((mem)->base + (s)->data))
+
 /**
  * @brief Create a stack data structure, returns vm address in addr.
  */
@@ -90,7 +94,7 @@ void xpost_stack_clear(Xpost_Memory_File *mem, unsigned int stackadr);
 void xpost_stack_dump(Xpost_Memory_File *mem, unsigned int stackadr);
 
 /**
- * @brief Free a stack, and all succeeding segments.
+ * @brief Free a stack, and its block of objects.
  */
 XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem, unsigned int stackadr);
 
@@ -99,6 +103,13 @@ XPCHECKAPI void xpost_stack_free(Xpost_Memory_File *mem, unsigned int stackadr);
  */
 int xpost_stack_count(Xpost_Memory_File *mem, unsigned int stackadr);
 
+/**
+ * @brief Make room for n more objects without further allocation.
+ */
+XPCHECKAPI int xpost_stack_reserve(Xpost_Memory_File *mem,
+                                   unsigned int stackadr,
+                                   unsigned int n);
+
 /**
  * @brief Put an object on top of the stack.
  */
@@ -142,6 +153,34 @@ int xpost_stack_bottomup_replace(Xpost_Memory_File *mem,
 XPCHECKAPI Xpost_Object xpost_stack_pop(Xpost_Memory_File *mem,
                                         unsigned stackadr);
 
+/**
+ * @brief Discard the top n objects.
+ */
+XPCHECKAPI int xpost_stack_pop_n(Xpost_Memory_File *mem,
+                                 unsigned stackadr,
+                                 int n);
+
+/**
+ * @brief Push copies of the top n objects, in order.
+ */
+XPCHECKAPI int xpost_stack_copy(Xpost_Memory_File *mem,
+                                unsigned stackadr,
+                                int n);
+
+/**
+ * @brief Roll the top n objects j positions (toward the top for j > 0).
+ */
+XPCHECKAPI int xpost_stack_roll(Xpost_Memory_File *mem,
+                                unsigned stackadr,
+                                int n,
+                                int j);
+
+/**
+ * @brief Index from the top down of the first mark object, or -1.
+ */
+int xpost_stack_count_to_mark(Xpost_Memory_File *mem,
+                              unsigned stackadr);
+
 /**
  * @}
  */
@@ -50,6 +50,8 @@ static const Xpost_Test_Case _tests[] = {
     { "Main", xpost_test_main },
     { "Memory", xpost_test_memory },
     { "Stack", xpost_test_stack },
+    { "File", xpost_test_file },
+    { "Free", xpost_test_free },
     { NULL, NULL }
 };
 
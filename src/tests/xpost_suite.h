@@ -33,6 +33,8 @@
 #define XPOST_SUITE_H_
 
 void xpost_test_main(TCase *tc);
+void xpost_test_file(TCase *tc);
+void xpost_test_free(TCase *tc);
 void xpost_test_memory(TCase *tc);
 void xpost_test_stack(TCase *tc);
 
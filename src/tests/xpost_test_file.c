@@ -0,0 +1,167 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * Copyright (C) 2013-2016, Vincent Torri
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <check.h>
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"
+#include "xpost_object.h"
+#include "xpost_file.h"
+
+#include "xpost_suite.h"
+
+/* the main job of xpost_run is a mapped file,
+   and `currentfile bytesavailable` asks it what is left */
+static const char _xpost_test_file_prog[] = "(job) = currentfile bytesavailable =\n";
+
+START_TEST(xpost_file_mapped_bytes_available)
+{
+    Xpost_Memory_File mem = {0};
+    Xpost_Object f;
+    int n;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    f = xpost_file_cons_mapped(&mem,
+                               (const unsigned char *)_xpost_test_file_prog,
+                               sizeof _xpost_test_file_prog - 1);
+    ck_assert_int_eq (xpost_object_get_type(f), filetype);
+    ret = xpost_file_get_bytes_available(&mem, f, &n);
+    ck_assert_int_eq (ret, 0);
+    ck_assert_int_eq (n, sizeof _xpost_test_file_prog - 1);
+
+    ck_assert_int_eq (xpost_file_getc(xpost_file_get_file_pointer(&mem, f)), '(');
+    ret = xpost_file_get_bytes_available(&mem, f, &n);
+    ck_assert_int_eq (ret, 0);
+    ck_assert_int_eq (n, sizeof _xpost_test_file_prog - 2);
+
+    ret = xpost_file_object_close(&mem, f);
+    ck_assert_int_eq (ret, 0);
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_file_open_mapped_bytes_available)
+{
+    const char *fn = "xpost_test_file.ps";
+    Xpost_Memory_File mem = {0};
+    Xpost_Object f;
+    FILE *fp;
+    int n;
+    int ret;
+
+    xpost_init();
+
+    fp = fopen(fn, "wb");
+    ck_assert(fp != NULL);
+    fputs(_xpost_test_file_prog, fp);
+    fclose(fp);
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    ret = xpost_file_open_mapped(&mem, fn, &f);
+    ck_assert_int_eq (ret, 0);
+    ret = xpost_file_get_bytes_available(&mem, f, &n);
+    ck_assert_int_eq (ret, 0);
+    ck_assert_int_eq (n, sizeof _xpost_test_file_prog - 1);
+
+    ret = xpost_file_object_close(&mem, f);
+    ck_assert_int_eq (ret, 0);
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+    remove(fn);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_file_disk_bytes_available)
+{
+    Xpost_Memory_File mem = {0};
+    Xpost_Object f;
+    FILE *fp;
+    int n;
+    int ret;
+
+    xpost_init();
+
+    fp = tmpfile();
+    ck_assert(fp != NULL);
+    fputs(_xpost_test_file_prog, fp);
+    rewind(fp);
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    f = xpost_file_cons(&mem, fp);
+    ck_assert_int_eq (xpost_object_get_type(f), filetype);
+    ck_assert_int_eq (xpost_file_getc(xpost_file_get_file_pointer(&mem, f)), '(');
+    ret = xpost_file_get_bytes_available(&mem, f, &n);
+    ck_assert_int_eq (ret, 0);
+    ck_assert_int_eq (n, sizeof _xpost_test_file_prog - 2);
+
+    ret = xpost_file_object_close(&mem, f);
+    ck_assert_int_eq (ret, 0);
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+void xpost_test_file(TCase *tc)
+{
+    tcase_add_test(tc, xpost_file_mapped_bytes_available);
+    tcase_add_test(tc, xpost_file_open_mapped_bytes_available);
+    tcase_add_test(tc, xpost_file_disk_bytes_available);
+}
@@ -0,0 +1,138 @@
+/*
+ * Xpost - a Level-2 Postscript interpreter
+ * Copyright (C) 2013-2016, Michael Joshua Ryan
+ * Copyright (C) 2013-2016, Vincent Torri
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the Xpost software product nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <check.h>
+
+#include "xpost.h"
+#include "xpost_log.h"
+#include "xpost_memory.h"
+#include "xpost_free.h"
+
+#include "xpost_suite.h"
+
+#define XPOST_TEST_FREE_ENTS 64
+#define XPOST_TEST_FREE_SIZE 1024
+
+/* the free lists ask the interpreter whether it is initializing,
+   which leaves out automatic collection */
+static int _xpost_test_free_initializing = 1;
+
+static int
+_xpost_test_free_get_initializing(void)
+{
+    return _xpost_test_free_initializing;
+}
+
+static void
+_xpost_test_free_set_initializing(int i)
+{
+    _xpost_test_free_initializing = i;
+}
+
+START_TEST(xpost_free_compact_fragmented)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned int ents[XPOST_TEST_FREE_ENTS];
+    unsigned char buf[XPOST_TEST_FREE_SIZE];
+    unsigned int used;
+    unsigned int cut;
+    unsigned int i;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL,
+                                 _xpost_test_free_get_initializing,
+                                 _xpost_test_free_set_initializing);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_memory_table_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    ret = xpost_free_init(&mem);
+    ck_assert_int_eq (ret, 1);
+    mem.start = mem.table.nextent;
+
+    /* fill ents with their own pattern */
+    for (i = 0; i < XPOST_TEST_FREE_ENTS; i++)
+    {
+        ret = xpost_memory_table_alloc(&mem, XPOST_TEST_FREE_SIZE, 0, &ents[i]);
+        ck_assert_int_eq (ret, 1);
+        memset(buf, (int)i, sizeof buf);
+        ret = xpost_memory_put(&mem, ents[i], 0, sizeof buf, buf);
+        ck_assert_int_eq (ret, 1);
+    }
+
+    /* free every other ent: the last one is live,
+       so all of the freed storage goes on the free lists */
+    for (i = 0; i < XPOST_TEST_FREE_ENTS; i += 2)
+    {
+        ret = xpost_free_memory_ent(&mem, ents[i]);
+        ck_assert_int_eq (ret, XPOST_TEST_FREE_SIZE);
+    }
+    ck_assert_int_eq (xpost_free_get_size(&mem),
+                      XPOST_TEST_FREE_ENTS / 2 * XPOST_TEST_FREE_SIZE);
+
+    used = mem.used;
+    cut = xpost_free_compact(&mem);
+    ck_assert_int_eq (cut, XPOST_TEST_FREE_ENTS / 2 * XPOST_TEST_FREE_SIZE);
+    ck_assert_int_eq (mem.used, used - cut);
+    ck_assert(mem.max >= mem.used);
+    ck_assert_int_eq (xpost_free_get_size(&mem), 0);
+
+    /* the live ents moved down with their contents */
+    for (i = 1; i < XPOST_TEST_FREE_ENTS; i += 2)
+    {
+        unsigned int j;
+
+        ck_assert(mem.table.tab[ents[i]].adr + XPOST_TEST_FREE_SIZE <= mem.used);
+        ret = xpost_memory_get(&mem, ents[i], 0, sizeof buf, buf);
+        ck_assert_int_eq (ret, 1);
+        for (j = 0; j < sizeof buf; j++)
+            ck_assert_int_eq (buf[j], i);
+    }
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+void xpost_test_free(TCase *tc)
+{
+    tcase_add_test(tc, xpost_free_compact_fragmented);
+}
@@ -33,6 +33,10 @@
 # include "config.h"
 #endif
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <check.h>
 
 #include "xpost.h"
@@ -46,7 +50,80 @@ START_TEST(xpost_init_simple)
 }
 END_TEST
 
+static void
+_xpost_test_main_write(const char *filename, const char *contents)
+{
+    FILE *f;
+
+    f = fopen(filename, "wb");
+    ck_assert(f != NULL);
+    ck_assert(fputs(contents, f) >= 0);
+    ck_assert(fclose(f) == 0);
+}
+
+/* count the pixels of a plain pgm page that are not white, or -1 */
+static int
+_xpost_test_main_inked(const char *filename, int width, int height)
+{
+    FILE *f;
+    int w, h, max, v, i;
+    int inked = 0;
+
+    f = fopen(filename, "rb");
+    if (!f)
+        return -1;
+    if (fscanf(f, "P2 %d %d %d", &w, &h, &max) != 3 || w != width || h != height)
+    {
+        fclose(f);
+        return -1;
+    }
+    for (i = 0; i < w * h; i++)
+    {
+        if (fscanf(f, "%d", &v) != 1)
+        {
+            fclose(f);
+            return -1;
+        }
+        if (v != max)
+            ++inked;
+    }
+    fclose(f);
+    return inked;
+}
+
+/* a batch through a device written in PostScript gives each job
+   its own page, named from the template */
+START_TEST(xpost_run_batch_ps_device)
+{
+    const char *files[] = { "xpost_test_batch_1.ps", "xpost_test_batch_2.ps" };
+    Xpost_Context *ctx;
+    int ret;
+
+    _xpost_test_main_write(files[0], "10 10 moveto 30 20 lineto stroke showpage\n");
+    _xpost_test_main_write(files[1], "showpage\n");
+
+    ctx = xpost_create("pgm",
+                       XPOST_OUTPUT_DEFAULT, NULL,
+                       XPOST_SHOWPAGE_NOPAUSE,
+                       XPOST_OUTPUT_MESSAGE_QUIET,
+                       XPOST_USE_SIZE, 40, 30);
+    ck_assert(ctx != NULL);
+    ret = xpost_run_batch(ctx, 2, files, "xpost_test_batch_%d.pgm");
+    xpost_destroy(ctx);
+    remove(files[0]);
+    remove(files[1]);
+    ck_assert_int_eq(ret, 1);
+
+    /* the second page is erased, not drawn over the first */
+    ck_assert(_xpost_test_main_inked("xpost_test_batch_1.pgm", 40, 30) > 0);
+    ck_assert_int_eq(_xpost_test_main_inked("xpost_test_batch_2.pgm", 40, 30), 0);
+    remove("xpost_test_batch_1.pgm");
+    remove("xpost_test_batch_2.pgm");
+}
+END_TEST
+
 void xpost_test_main(TCase *tc)
 {
     tcase_add_test(tc, xpost_init_simple);
+    tcase_add_test(tc, xpost_run_batch_ps_device);
 }
@@ -132,6 +132,162 @@ START_TEST(xpost_memory_grow)
 }
 END_TEST
 
+START_TEST(xpost_memory_grow_in_place)
+{
+    char memorypat[] = "preserve this data across grow()";
+    Xpost_Memory_File mem = {0};
+    unsigned char *base;
+    unsigned int addr;
+    unsigned int max;
+    int i;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.base != NULL);
+
+    ret = xpost_memory_file_alloc(&mem, sizeof memorypat, &addr);
+    ck_assert_int_eq (ret, 1);
+    strcpy((char *)mem.base + addr, memorypat);
+
+    base = mem.base;
+    for (i = 0; i < 8; i++)
+    {
+        max = mem.max;
+        ret = xpost_memory_file_grow(&mem, 4096);
+        ck_assert_int_eq (ret, 1);
+        ck_assert(mem.max > max);
+        /* with a reserved range, the memory does not move */
+        if (mem.reserved)
+        {
+            ck_assert(mem.base == base);
+            ck_assert(mem.max <= mem.reserved);
+        }
+        ck_assert_str_eq ((char *)mem.base + addr, memorypat);
+        /* the new pages are usable */
+        mem.base[mem.max - 1] = 1;
+    }
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_grow_reserved)
+{
+    Xpost_Memory_File mem = {0};
+    unsigned char *base;
+    unsigned int max;
+    size_t reserved;
+    size_t page;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.base != NULL);
+
+    /* without a reserved range, there is no limit to test */
+    if (mem.reserved)
+    {
+        /* pretend the range ends two pages above the memory file */
+        page = xpost_memory_page_size;
+        reserved = mem.reserved;
+        mem.reserved = mem.max + 2 * page;
+        base = mem.base;
+
+        /* the growth is cut to the range */
+        ret = xpost_memory_file_grow(&mem, 1);
+        ck_assert_int_eq (ret, 1);
+        ck_assert(mem.base == base);
+        ck_assert_int_eq (mem.max, mem.reserved);
+        mem.base[mem.max - 1] = 1;
+
+        /* at the reserved size, growth fails and leaves the memory file */
+        XPOST_LOG_ERR("you should see an error just below");
+        max = mem.max;
+        ret = xpost_memory_file_grow(&mem, 1);
+        ck_assert_int_eq (ret, 0);
+        ck_assert(mem.base == base);
+        ck_assert_int_eq (mem.max, max);
+
+        /* so does growth past it */
+        mem.reserved = mem.max + page;
+        XPOST_LOG_ERR("you should see an error just below");
+        ret = xpost_memory_file_grow(&mem, 2 * page);
+        ck_assert_int_eq (ret, 0);
+        ck_assert(mem.base == base);
+        ck_assert_int_eq (mem.max, max);
+        mem.base[mem.max - 1] = 2;
+
+        mem.reserved = reserved;
+    }
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
+START_TEST(xpost_memory_shrink_grow)
+{
+    char memorypat[] = "preserve this data across shrink()";
+    Xpost_Memory_File mem = {0};
+    unsigned char *base;
+    unsigned int addr;
+    unsigned int page;
+    unsigned int max;
+    int ret;
+
+    xpost_init();
+
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.base != NULL);
+    page = xpost_memory_page_size;
+
+    ret = xpost_memory_file_alloc(&mem, sizeof memorypat, &addr);
+    ck_assert_int_eq (ret, 1);
+    strcpy((char *)mem.base + addr, memorypat);
+
+    /* use many pages, then give up all but the first */
+    ret = xpost_memory_file_alloc(&mem, 16 * page, &addr);
+    ck_assert_int_eq (ret, 1);
+    memset(mem.base + addr, 0xff, 16 * page);
+    max = mem.max;
+    ck_assert(max > 16 * page);
+    base = mem.base;
+    mem.used = sizeof memorypat;
+
+    ret = xpost_memory_file_shrink(&mem);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.base == base);
+    ck_assert(mem.max < max);
+    ck_assert(mem.max >= mem.used);
+    ck_assert_str_eq ((char *)mem.base, memorypat);
+
+    /* and grow back over the pages given up */
+    ret = xpost_memory_file_alloc(&mem, 16 * page, &addr);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.max >= mem.used);
+    if (mem.reserved)
+        ck_assert(mem.base == base);
+    memset(mem.base + addr, 0xff, 16 * page);
+    ck_assert_str_eq ((char *)mem.base, memorypat);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
 START_TEST(xpost_memory_tab_init)
 {
     Xpost_Memory_File mem = {0};
@@ -193,6 +349,9 @@ void xpost_test_memory(TCase *tc)
     tcase_add_test(tc, xpost_memory_init_alloc);
     tcase_add_test(tc, xpost_memory_not_init);
     tcase_add_test(tc, xpost_memory_grow);
+    tcase_add_test(tc, xpost_memory_grow_in_place);
+    tcase_add_test(tc, xpost_memory_grow_reserved);
+    tcase_add_test(tc, xpost_memory_shrink_grow);
     tcase_add_test(tc, xpost_memory_tab_init);
     tcase_add_test(tc, xpost_memory_tab_alloc);
 }
@@ -73,7 +73,7 @@ START_TEST(xpost_stack_push_pop)
 {
     Xpost_Memory_File mem;
     unsigned int stack;
-    int segsize = XPOST_STACK_SEGMENT_SIZE;
+    int initsize = XPOST_STACK_INITIAL_SIZE;
     int i;
     Xpost_Object obj;
     int ret;
@@ -88,7 +88,7 @@ START_TEST(xpost_stack_push_pop)
     ret = xpost_stack_init(&mem, &stack);
     ck_assert_int_eq (ret, 1);
 
-    for (i = 0; i < 5 + segsize; i++)
+    for (i = 0; i < 5 + initsize; i++)
     {
         ret = xpost_stack_push(&mem, stack, xpost_int_cons(i));
         XPOST_LOG_INFO("test push integer %d", i);
@@ -111,8 +111,65 @@ START_TEST(xpost_stack_push_pop)
 }
 END_TEST
 
+START_TEST(xpost_stack_index_roll)
+{
+    Xpost_Memory_File mem;
+    unsigned int stack;
+    int i;
+    Xpost_Object obj;
+    int ret;
+
+    xpost_init();
+
+    memset(&mem, 0, sizeof(Xpost_Memory_File));
+    ret = xpost_memory_file_init(&mem, NULL, -1, NULL, NULL, NULL);
+    ck_assert_int_eq (ret, 1);
+    ck_assert(mem.base != NULL);
+
+    ret = xpost_stack_init(&mem, &stack);
+    ck_assert_int_eq (ret, 1);
+
+    for (i = 0; i < 10; i++)
+    {
+        ret = xpost_stack_push(&mem, stack, xpost_int_cons(i));
+        ck_assert_int_eq (ret, 1);
+    }
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 10);
+    ck_assert_int_eq (xpost_stack_bottomup_fetch(&mem, stack, 2).int_.val, 2);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 2).int_.val, 7);
+
+    /* 7 8 9  3 1 roll  9 7 8 */
+    ret = xpost_stack_roll(&mem, stack, 3, 1);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 0).int_.val, 8);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 2).int_.val, 9);
+
+    /* 9 7 8  3 -1 roll  7 8 9 */
+    ret = xpost_stack_roll(&mem, stack, 3, -1);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 0).int_.val, 9);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 2).int_.val, 7);
+
+    ret = xpost_stack_copy(&mem, stack, 2);
+    ck_assert_int_eq (ret, 1);
+    ck_assert_int_eq (xpost_stack_count(&mem, stack), 12);
+    ck_assert_int_eq (xpost_stack_topdown_fetch(&mem, stack, 1).int_.val, 8);
+
+    ret = xpost_stack_pop_n(&mem, stack, 12);
+    ck_assert_int_eq (ret, 1);
+    obj = xpost_stack_pop(&mem, stack);
+    ck_assert_int_eq (xpost_object_get_type(obj), invalidtype);
+
+    ret = xpost_memory_file_exit(&mem);
+    ck_assert_int_eq (ret, 1);
+
+    xpost_quit();
+}
+END_TEST
+
 void xpost_test_stack(TCase *tc)
 {
     tcase_add_test(tc, xpost_stack);
     tcase_add_test(tc, xpost_stack_push_pop);
+    tcase_add_test(tc, xpost_stack_index_roll);
 }